@@ -34,8 +34,13 @@ project "EZ80Assembler"
 		systemversion "latest"
 		usestdpreproc "On"
 		buildoptions "/wd5105" -- Until Microsoft updates Windows 10 to not have terrible code (aka never), this must be here to prevent a warning.
+		buildoptions "/constexpr:steps100000000" -- The platform symbols' perfect hash table is built at compile time.
 		defines "SYSTEM_WINDOWS"
 
+	-- BuildProject assembles on a thread pool.
+	filter "system:linux"
+		links "pthread"
+
 	filter "configurations:Profile"
 		runtime "Debug"
 		optimize "Off"
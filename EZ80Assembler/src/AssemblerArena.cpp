@@ -0,0 +1,40 @@
+#include "AssemblerArena.h"
+
+namespace ez80
+{
+	AssemblerArena::AssemblerArena(size_t initialSize)
+		: buffer(initialSize ? std::make_unique_for_overwrite<std::byte[]>(initialSize) : nullptr), bufferSize(initialSize)
+	{
+		if (buffer)
+			arena.emplace(buffer.get(), bufferSize, &overflow);
+		else
+			arena.emplace(&overflow);
+	}
+
+	void AssemblerArena::Reset()
+	{
+		// The same job fits again in one buffer as big as everything it used.
+		size_t neededSize = bufferSize + overflow.allocatedBytes;
+		arena.reset();
+		overflow.allocatedBytes = 0;
+
+		if (neededSize > bufferSize)
+		{
+			buffer.reset();
+			buffer = std::make_unique_for_overwrite<std::byte[]>(neededSize);
+			bufferSize = neededSize;
+		}
+		arena.emplace(buffer.get(), bufferSize, &overflow);
+	}
+
+	void* AssemblerArena::Overflow::do_allocate(size_t bytes, size_t alignment)
+	{
+		allocatedBytes += bytes;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void AssemblerArena::Overflow::do_deallocate(void* pointer, size_t bytes, size_t alignment)
+	{
+		std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+	}
+}
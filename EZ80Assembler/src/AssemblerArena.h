@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace ez80
+{
+	// An arena for AssemblerInfo::memoryResource that keeps its memory between jobs.
+	// Whatever a job needed beyond the buffer is folded into it on Reset, so once the buffer has grown to fit
+	// the largest job, assembling allocates nothing from the heap but what it returns.
+	class AssemblerArena
+	{
+	public:
+		AssemblerArena(size_t initialSize = 0);
+
+		AssemblerArena(const AssemblerArena&) = delete;
+		AssemblerArena& operator=(const AssemblerArena&) = delete;
+
+		// The same for the arena's whole life.
+		std::pmr::memory_resource* Resource() noexcept { return &*arena; }
+
+		// Frees everything allocated since the last reset. Nothing allocated from it may be used afterwards.
+		void Reset();
+	private:
+		// Counts what the arena needed beyond the buffer.
+		class Overflow : public std::pmr::memory_resource
+		{
+		public:
+			size_t allocatedBytes = 0;
+		private:
+			void* do_allocate(size_t bytes, size_t alignment) override;
+			void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		};
+
+		std::unique_ptr<std::byte[]> buffer;
+		size_t bufferSize = 0;
+		Overflow overflow;
+		std::optional<std::pmr::monotonic_buffer_resource> arena;
+	};
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string_view>
+
 namespace ez80
 {
 	template<typename Elem = char>
@@ -7,6 +9,10 @@ namespace ez80
 
 	template<typename Elem = char>
 	constexpr bool IsParameterSeparator(Elem elem) noexcept;
+
+	// Parses decimal, $ff, 0xff, 0ffh, %1010 and 1010b integer literals.
+	template<typename Elem = char, typename Traits = std::char_traits<Elem>>
+	constexpr bool ParseNumericLiteral(std::basic_string_view<Elem, Traits> literal, uint32_t& outValue) noexcept;
 }
 
 #include "AssemblerStringUtil.inl"
@@ -14,4 +14,57 @@ namespace ez80
 	{
 		return elem == static_cast<Elem>(',');
 	}
+
+	template<typename Elem, typename Traits>
+	constexpr bool ParseNumericLiteral(std::basic_string_view<Elem, Traits> literal, uint32_t& outValue) noexcept
+	{
+		uint32_t radix = 10;
+		if (literal.starts_with(static_cast<Elem>('$')))
+		{
+			radix = 16;
+			literal.remove_prefix(1);
+		}
+		else if (literal.starts_with(static_cast<Elem>('%')))
+		{
+			radix = 2;
+			literal.remove_prefix(1);
+		}
+		else if (literal.size() > 2 && literal[0] == static_cast<Elem>('0') && util::string::ToLower(literal[1]) == static_cast<Elem>('x'))
+		{
+			radix = 16;
+			literal.remove_prefix(2);
+		}
+		else if (literal.size() > 1 && util::string::ToLower(literal.back()) == static_cast<Elem>('h'))
+		{
+			radix = 16;
+			literal.remove_suffix(1);
+		}
+		else if (literal.size() > 1 && util::string::ToLower(literal.back()) == static_cast<Elem>('b'))
+		{
+			radix = 2;
+			literal.remove_suffix(1);
+		}
+
+		if (literal.empty())
+			return false;
+
+		uint64_t value = 0;
+		for (Elem elem : literal)
+		{
+			uint32_t digit = radix;
+			if (util::string::IsDecimalDigit(elem))
+				digit = static_cast<uint32_t>(elem - static_cast<Elem>('0'));
+			else if (util::string::IsHexadecimalDigit(elem))
+				digit = static_cast<uint32_t>(util::string::ToLower(elem) - static_cast<Elem>('a')) + 10;
+			if (digit >= radix)
+				return false;
+
+			value = value * radix + digit;
+			if (value > UINT32_MAX)
+				return false;
+		}
+
+		outValue = static_cast<uint32_t>(value);
+		return true;
+	}
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace ez80
+{
+	struct TokenizedLine
+	{
+		using Iterator = std::pmr::vector<std::string_view>::iterator;
+
+		constexpr TokenizedLine(std::pmr::vector<std::string_view>& tokens, size_t start, size_t tokenCount, size_t number) noexcept
+			: tokenCount(tokenCount), number(number), beginIt(tokens.begin() + start), endIt(tokens.begin() + (start + tokenCount)) {}
+
+		constexpr std::string_view operator[](size_t index) const noexcept { return *(beginIt + index); }
+		constexpr Iterator begin() noexcept { return beginIt; }
+		constexpr Iterator end() noexcept { return endIt; }
+
+		// Drops every token from count onward, for rewriting a line into a shorter form.
+		constexpr void Truncate(size_t count) noexcept { if (count < tokenCount) { tokenCount = count; endIt = beginIt + count; } }
+
+		// Every token after the first one.
+		constexpr std::span<const std::string_view> Operands() const noexcept { return { beginIt + 1, endIt }; }
+
+		size_t tokenCount = 0;
+		bool handled = false; // For deferred removal.
+		size_t number = 0;
+	private:
+		Iterator beginIt;
+		Iterator endIt;
+	};
+
+	// Where a TokenizedLine's tokens are, before the tokens vector is done growing.
+	struct TokenizedLineView
+	{
+		size_t start = 0; // Start index into tokens
+		size_t tokenCount = 0; // Number of tokens in this line
+		size_t lineNumber = 0;
+	};
+
+	struct Equate
+	{
+		std::string_view identifier;
+		std::string_view value;
+		size_t lineNumber = 0;
+		uint32_t expandedValue : 24 = 0;
+		bool expanded = false;
+	};
+}
@@ -0,0 +1,208 @@
+#include "BranchRelaxation.h"
+#include "Layout.h"
+#include "SourceScope.h"
+#include "StringUtil.h"
+#include "Profile.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace ez80
+{
+	// jr's displacement is relative to the end of the jr.
+	static constexpr int64_t s_ShortBranchMin = -128;
+	static constexpr int64_t s_ShortBranchMax = 127;
+
+	// How far, in bytes, a short branch's start can be from any line it spans, with plenty of slack.
+	static constexpr uint32_t s_ShortBranchReach = 256;
+
+	// Prefix sums of line sizes that can be updated in O(log n), so that widening a branch
+	// only touches what it moves instead of laying the whole program out again.
+	class LineOffsets
+	{
+	public:
+		LineOffsets(const std::pmr::vector<uint32_t>& sizes)
+			: tree(sizes.size() + 1, 0, sizes.get_allocator())
+		{
+			for (size_t i = 1; i < tree.size(); i++)
+			{
+				tree[i] += sizes[i - 1];
+				if (size_t parent = i + LowestBit(i); parent < tree.size())
+					tree[parent] += tree[i];
+			}
+		}
+
+		// The offset of the start of the line, i.e. the sum of the sizes of every line before it.
+		int64_t Offset(size_t lineIndex) const noexcept
+		{
+			int64_t offset = 0;
+			for (size_t i = lineIndex; i > 0; i &= i - 1)
+				offset += tree[i];
+			return offset;
+		}
+
+		void Grow(size_t lineIndex, int64_t delta) noexcept
+		{
+			for (size_t i = lineIndex + 1; i < tree.size(); i += LowestBit(i))
+				tree[i] += delta;
+		}
+	private:
+		static constexpr size_t LowestBit(size_t i) noexcept { return i & (~i + 1); }
+
+		std::pmr::vector<int64_t> tree;
+	};
+
+	struct Branch
+	{
+		size_t lineIndex = 0;
+		size_t targetLineIndex = 0;
+		InstructionCost shortCost;
+		InstructionCost longCost;
+		bool isShort = true;
+		bool queued = true;
+	};
+
+	void RelaxBranches(std::pmr::vector<TokenizedLine>& tokenizedLines, AssemblyMode mode, std::vector<AssemblerRewrite>& rewrites)
+	{
+		PROFILE_FUNCTION();
+
+		std::pmr::memory_resource* arena = tokenizedLines.get_allocator().resource();
+		std::pmr::vector<uint32_t> sizes(tokenizedLines.size(), 0, arena);
+		std::pmr::vector<uint32_t> unknownLinesBefore(tokenizedLines.size() + 1, 0, arena);
+		std::pmr::unordered_map<std::string_view, size_t> labels(arena);
+		std::pmr::vector<Branch> branches(arena);
+
+		// Size every line, find every label, and every jp that jr could stand in for.
+		{
+			SourceScope scope;
+			std::pmr::vector<std::string_view> qualifiedTargets(arena); // Parallel to branches, resolved once every label is known.
+			std::pmr::vector<std::string_view> unqualifiedTargets(arena);
+
+			for (size_t lineIndex = 0; lineIndex < tokenizedLines.size(); lineIndex++)
+			{
+				TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+				unknownLinesBefore[lineIndex + 1] = unknownLinesBefore[lineIndex];
+
+				SourceScopeEvent event = scope.Visit(tokenizedLine);
+				if (event == SourceScopeEvent_Label)
+					labels.emplace(scope.Qualify(GetLabelName(tokenizedLine), arena), lineIndex);
+				if (event != SourceScopeEvent_None)
+				{
+					if (IsUnsizedLine(tokenizedLine, event))
+						unknownLinesBefore[lineIndex + 1]++;
+					continue;
+				}
+
+				std::string_view token0 = tokenizedLine[0];
+				InstructionInfo info;
+				if (!LookupDataDirective(token0, tokenizedLine.Operands(), info) && !LookupInstruction(token0, tokenizedLine.Operands(), info))
+				{
+					unknownLinesBefore[lineIndex + 1]++;
+					continue;
+				}
+				sizes[lineIndex] = info.costs[mode].size;
+
+				InstructionInfo shortInfo;
+				if (!LookupShortBranch(tokenizedLine, shortInfo))
+					continue;
+
+				Branch& branch = branches.emplace_back();
+				branch.lineIndex = lineIndex;
+				branch.shortCost = shortInfo.costs[mode];
+				branch.longCost = info.costs[mode];
+				std::string_view target = GetBranchLabel(tokenizedLine);
+				qualifiedTargets.push_back(scope.Qualify(target, arena));
+				unqualifiedTargets.push_back(target);
+			}
+
+			// Labels in the enclosing namespace shadow global ones, the same way they are defined.
+			size_t resolvedCount = 0;
+			for (size_t i = 0; i < branches.size(); i++)
+			{
+				Branch& branch = branches[i];
+				auto it = labels.find(qualifiedTargets[i]);
+				if (it == labels.end())
+					it = labels.find(unqualifiedTargets[i]);
+				if (it == labels.end())
+					continue;
+
+				size_t first = std::min(branch.lineIndex, it->second);
+				size_t last = std::max(branch.lineIndex, it->second);
+				if (unknownLinesBefore[last + 1] != unknownLinesBefore[first])
+					continue;
+
+				branch.targetLineIndex = it->second;
+				branches[resolvedCount++] = branch;
+			}
+			branches.resize(resolvedCount);
+		}
+
+		// Optimistically start with every branch short.
+		for (Branch& branch : branches)
+			sizes[branch.lineIndex] = branch.shortCost.size;
+		LineOffsets offsets(sizes);
+
+		auto IsInRange = [&offsets](const Branch& branch)
+		{
+			int64_t displacement = offsets.Offset(branch.targetLineIndex) - (offsets.Offset(branch.lineIndex) + branch.shortCost.size);
+			return displacement >= s_ShortBranchMin && displacement <= s_ShortBranchMax;
+		};
+
+		// Whether a line growing changes the distance the branch covers.
+		auto Spans = [](const Branch& branch, size_t lineIndex)
+		{
+			if (branch.targetLineIndex > branch.lineIndex)
+				return lineIndex > branch.lineIndex && lineIndex < branch.targetLineIndex;
+			return lineIndex >= branch.targetLineIndex && lineIndex < branch.lineIndex;
+		};
+
+		// Branches are in line order, so their offsets are sorted too.
+		auto FirstBranchFrom = [&branches, &offsets](int64_t offset)
+		{
+			auto it = std::partition_point(branches.begin(), branches.end(),
+				[&offsets, offset](const Branch& branch) { return offsets.Offset(branch.lineIndex) < offset; });
+			return static_cast<size_t>(it - branches.begin());
+		};
+
+		std::pmr::vector<size_t> worklist(branches.size(), arena);
+		for (size_t i = 0; i < branches.size(); i++)
+			worklist[i] = branches.size() - 1 - i;
+
+		// A branch that was in range can only leave it when something it spans grows, so only those are looked at again.
+		// Every short branch not in the worklist spans less than s_ShortBranchReach, so they're all found near the one that grew.
+		while (!worklist.empty())
+		{
+			Branch& branch = branches[worklist.back()];
+			worklist.pop_back();
+			branch.queued = false;
+
+			if (IsInRange(branch))
+				continue;
+
+			int64_t offset = offsets.Offset(branch.lineIndex);
+			for (size_t i = FirstBranchFrom(offset - s_ShortBranchReach); i < branches.size(); i++)
+			{
+				Branch& other = branches[i];
+				if (offsets.Offset(other.lineIndex) > offset + s_ShortBranchReach)
+					break;
+				if (other.isShort && !other.queued && Spans(other, branch.lineIndex))
+				{
+					other.queued = true;
+					worklist.push_back(i);
+				}
+			}
+
+			branch.isShort = false;
+			offsets.Grow(branch.lineIndex, static_cast<int64_t>(branch.longCost.size) - branch.shortCost.size);
+		}
+
+		for (const Branch& branch : branches)
+		{
+			if (!branch.isShort)
+				continue;
+
+			*tokenizedLines[branch.lineIndex].begin() = "jr";
+			rewrites.emplace_back(AssemblerRewrite_ShortBranch, tokenizedLines[branch.lineIndex].number,
+				branch.longCost.size - branch.shortCost.size, branch.longCost.takenCycles - branch.shortCost.takenCycles);
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "EZ80Assembler.h"
+#include "Instructions.h"
+
+namespace ez80
+{
+	// Turns every jp to a label into a jr whenever the label ends up in range.
+	// All candidates start out short, and only those pushed out of range by other branches growing are widened again,
+	// until nothing changes. Branches across lines that can't be sized, like macro invocations, #includes and .orgs,
+	// are left alone, see IsUnsizedLine.
+	// djnz isn't relaxed in either direction. Expanding one that's out of range into dec b / jp nz would add a line,
+	// and lines can't be added once the tokens are laid out, see MakeTokenizedLines. Shortening dec b / jp nz into djnz
+	// would also need the flags dec b sets to be dead at the target.
+	void RelaxBranches(std::pmr::vector<TokenizedLine>& tokenizedLines, AssemblyMode mode, std::vector<AssemblerRewrite>& rewrites);
+}
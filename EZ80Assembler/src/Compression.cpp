@@ -0,0 +1,239 @@
+#include "Compression.h"
+#include "Simulator.h"
+#include "Profile.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ez80
+{
+	static constexpr uint32_t s_MinMatch = 4; // Shorter copies aren't smaller than their literals.
+	static constexpr uint32_t s_MaxMatch = 0x7F + s_MinMatch;
+	static constexpr uint32_t s_MaxLiterals = 0x7F;
+	static constexpr uint32_t s_MaxOffset = 0xFFFF;
+	static constexpr uint32_t s_HashBits = 14;
+
+	// From ti84pce.inc.
+	static constexpr uint32_t s_MemChk = 0x0204FC;      // _MemChk, returns the free RAM in hl.
+	static constexpr uint32_t s_InsertMem = 0x020514;   // _InsertMem, inserts hl bytes at de.
+	static constexpr uint32_t s_AsmProgramSize = 0xD0118C; // asm_prgm_size, freed from UserMem when the program returns.
+	static constexpr uint32_t s_PixelShadow = 0xD031F6; // pixelShadow, free for programs to use.
+
+	static uint32_t Load32(const uint8_t* data) noexcept
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static constexpr uint32_t Hash(uint32_t value) noexcept
+	{
+		return (value * 2654435761u) >> (32 - s_HashBits);
+	}
+
+	uint32_t CompressLZ(std::span<const uint8_t> input, std::vector<uint8_t>& output)
+	{
+		// Written through a pointer into space for the worst case, every byte a literal, then trimmed.
+		size_t outputStart = output.size();
+		output.resize(outputStart + input.size() + input.size() / s_MaxLiterals + 2);
+		uint8_t* const outBegin = output.data() + outputStart;
+		uint8_t* out = outBegin;
+
+		// How far the unpacked output gets ahead of the stream, checked after every token.
+		int64_t margin = 0;
+		auto UpdateMargin = [&margin, &out, outBegin](size_t unpacked) noexcept
+		{
+			margin = std::max(margin, static_cast<int64_t>(unpacked) - (out - outBegin));
+		};
+
+		const uint8_t* data = input.data();
+		size_t literalStart = 0;
+		auto EmitLiterals = [&](size_t end) noexcept
+		{
+			while (literalStart < end)
+			{
+				size_t count = std::min<size_t>(end - literalStart, s_MaxLiterals);
+				*out++ = static_cast<uint8_t>(count);
+				std::memcpy(out, data + literalStart, count);
+				out += count;
+				literalStart += count;
+				UpdateMargin(literalStart);
+			}
+		};
+
+		// Greedy matching against the last position with the same hash, which is what keeps this fast.
+		std::vector<uint32_t> table(1 << s_HashBits, 0);
+		size_t i = 0;
+		while (i + s_MinMatch <= input.size())
+		{
+			uint32_t sequence = Load32(data + i);
+			uint32_t& entry = table[Hash(sequence)];
+			size_t candidate = entry;
+			entry = static_cast<uint32_t>(i);
+
+			size_t offset = i - candidate;
+			if (offset == 0 || offset > s_MaxOffset || Load32(data + candidate) != sequence)
+			{
+				// Skip faster through data that doesn't compress.
+				i += 1 + ((i - literalStart) >> 6);
+				continue;
+			}
+
+			size_t length = s_MinMatch;
+			size_t maxLength = std::min<size_t>(s_MaxMatch, input.size() - i);
+			while (length < maxLength && data[candidate + length] == data[i + length])
+				length++;
+
+			EmitLiterals(i);
+			*out++ = static_cast<uint8_t>(0x80 | (length - s_MinMatch));
+			*out++ = static_cast<uint8_t>(offset);
+			*out++ = static_cast<uint8_t>(offset >> 8);
+			i += length;
+			literalStart = i;
+			UpdateMargin(i);
+
+			// Let the next search find the end of this match too.
+			if (i + s_MinMatch <= input.size())
+				table[Hash(Load32(data + i - 1))] = static_cast<uint32_t>(i - 1);
+		}
+
+		EmitLiterals(input.size());
+		*out++ = 0x00;
+		output.resize(outputStart + (out - outBegin));
+		return static_cast<uint32_t>(margin);
+	}
+
+	bool DecompressLZ(std::span<const uint8_t> input, std::vector<uint8_t>& output)
+	{
+		size_t outputStart = output.size();
+		size_t i = 0;
+		while (i < input.size())
+		{
+			uint8_t token = input[i++];
+			if (token == 0x00)
+				return i == input.size();
+
+			if (token < 0x80)
+			{
+				if (token > input.size() - i)
+					return false;
+				output.insert(output.end(), input.begin() + i, input.begin() + (i + token));
+				i += token;
+			}
+			else
+			{
+				if (input.size() - i < 2)
+					return false;
+				size_t offset = input[i] | (input[i + 1] << 8);
+				i += 2;
+				if (offset == 0 || offset > output.size() - outputStart)
+					return false;
+
+				// Byte by byte, like ldir, so overlapping copies repeat.
+				size_t length = (token & 0x7F) + s_MinMatch;
+				for (size_t j = 0; j < length; j++)
+					output.push_back(output[output.size() - offset]);
+			}
+		}
+		return false;
+	}
+
+	bool CompressProgramImage(std::vector<uint8_t>& image)
+	{
+		PROFILE_FUNCTION();
+
+		if (image.size() < 2 || image[0] != 0xEF || image[1] != 0x7B)
+			return false;
+
+		// Only what comes after EF 7B is unpacked, to UserMem.
+		std::span<const uint8_t> program(image.begin() + 2, image.end());
+		std::vector<uint8_t> compressed;
+		uint32_t margin = CompressLZ(program, compressed);
+
+		// The unpacking loop, position independent since it's copied out of the way before it runs.
+		// It's 48 bytes, unpacking from hl to de, and jumps to the program once it's done.
+		static constexpr uint8_t s_Loop[] = {
+			0x7E,                   // Loop:   ld a, (hl)
+			0x23,                   //         inc hl
+			0xFE, 0x80,             //         cp a, $80
+			0x30, 0x0E,             //         jr nc, Copy
+			0xB7,                   //         or a, a
+			0xCA, 0x81, 0xA8, 0xD1, //         jp z, UserMem
+			0x01, 0x00, 0x00, 0x00, //         ld bc, 0
+			0x4F,                   //         ld c, a
+			0xED, 0xB0,             //         ldir
+			0x18, 0xEC,             //         jr Loop
+			0xE6, 0x7F,             // Copy:   and a, $7F
+			0xC6, s_MinMatch,       //         add a, 4
+			0x01, 0x00, 0x00, 0x00, //         ld bc, 0
+			0x4E,                   //         ld c, (hl)
+			0x23,                   //         inc hl
+			0x46,                   //         ld b, (hl)
+			0x23,                   //         inc hl
+			0xE5,                   //         push hl
+			0xD5,                   //         push de
+			0xE1,                   //         pop hl
+			0xB7,                   //         or a, a
+			0xED, 0x42,             //         sbc hl, bc
+			0x01, 0x00, 0x00, 0x00, //         ld bc, 0
+			0x4F,                   //         ld c, a
+			0xED, 0xB0,             //         ldir
+			0xE1,                   //         pop hl
+			0x18, 0xD0,             //         jr Loop
+		};
+		static_assert(sizeof(s_Loop) == 48);
+		static_assert(UserMem == 0xD1A881, "The jp z, UserMem above needs updating.");
+
+		constexpr uint32_t prologueSize = 77;
+		constexpr uint32_t stubSize = prologueSize + sizeof(s_Loop);
+		uint32_t compressedSize = static_cast<uint32_t>(compressed.size());
+		uint32_t programSize = static_cast<uint32_t>(program.size());
+
+		// The stream is moved up to where it can be unpacked in place, past the stub so that moving it can't overwrite it.
+		uint32_t streamOffset = std::max(stubSize, margin);
+		uint32_t loadedSize = stubSize + compressedSize;
+		uint32_t neededSize = std::max(programSize, streamOffset + compressedSize);
+		if (loadedSize >= programSize)
+			return false;
+		uint32_t insertSize = neededSize - loadedSize;
+
+		std::vector<uint8_t> stub;
+		stub.reserve(2 + stubSize + compressedSize);
+		auto Emit = [&stub](std::initializer_list<uint8_t> bytes) { stub.insert(stub.end(), bytes); };
+		auto Emit24 = [&stub](uint8_t opcode, uint32_t value)
+		{
+			stub.push_back(opcode);
+			stub.push_back(static_cast<uint8_t>(value));
+			stub.push_back(static_cast<uint8_t>(value >> 8));
+			stub.push_back(static_cast<uint8_t>(value >> 16));
+		};
+
+		Emit({ 0xEF, 0x7B });
+		Emit24(0xCD, s_MemChk);                                        // call _MemChk
+		Emit24(0x11, insertSize);                                      // ld de, insertSize
+		Emit({ 0xB7, 0xED, 0x52 });                                    // or a, a \ sbc hl, de
+		Emit({ 0xD8 });                                                // ret c ; Not enough free RAM to unpack into.
+		Emit24(0x21, insertSize);                                      // ld hl, insertSize
+		Emit24(0x11, UserMem + loadedSize);                            // ld de, UserMem + loadedSize
+		Emit24(0xCD, s_InsertMem);                                     // call _InsertMem
+		Emit24(0x2A, s_AsmProgramSize);                                // ld hl, (asm_prgm_size)
+		Emit24(0x11, insertSize);                                      // ld de, insertSize
+		Emit({ 0x19 });                                                // add hl, de
+		Emit24(0x22, s_AsmProgramSize);                                // ld (asm_prgm_size), hl ; So the OS frees all of it on exit.
+		Emit24(0x21, UserMem + stubSize + compressedSize - 1);         // ld hl, end of the stream
+		Emit24(0x11, UserMem + streamOffset + compressedSize - 1);     // ld de, where it needs to end
+		Emit24(0x01, compressedSize);                                  // ld bc, compressedSize
+		Emit({ 0xED, 0xB8 });                                          // lddr
+		Emit24(0x21, UserMem + prologueSize);                          // ld hl, Loop
+		Emit24(0x11, s_PixelShadow);                                   // ld de, pixelShadow
+		Emit24(0x01, sizeof(s_Loop));                                  // ld bc, sizeof(Loop)
+		Emit({ 0xED, 0xB0 });                                          // ldir
+		Emit24(0x21, UserMem + streamOffset);                          // ld hl, UserMem + streamOffset
+		Emit24(0x11, UserMem);                                         // ld de, UserMem
+		Emit24(0xC3, s_PixelShadow);                                   // jp pixelShadow
+		stub.insert(stub.end(), std::begin(s_Loop), std::end(s_Loop));
+		stub.insert(stub.end(), compressed.begin(), compressed.end());
+
+		image = std::move(stub);
+		return true;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ez80
+{
+	// Compresses into a byte oriented LZ stream that the eZ80 can unpack with little more than ldir:
+	//	0x00              End of the stream.
+	//	0x01-0x7F         That many literal bytes follow.
+	//	0x80-0xFF lo hi   Copy (token & 0x7F) + 4 bytes from hi:lo bytes back in the output.
+	//	                  A copy may overlap what it writes, so runs of one byte are just a copy from 1 back.
+	// Returns how far ahead of the output the stream must start to be unpacked in place without overwriting itself.
+	uint32_t CompressLZ(std::span<const uint8_t> input, std::vector<uint8_t>& output);
+
+	// Returns false if the stream is malformed.
+	bool DecompressLZ(std::span<const uint8_t> input, std::vector<uint8_t>& output);
+
+	// Replaces a program image starting with EF 7B by a stub followed by the compressed image.
+	// When run, the stub makes room for the whole program, unpacks it in place at UserMem and jumps to it.
+	// Returns false, leaving image unchanged, if it isn't a program or wouldn't get smaller.
+	bool CompressProgramImage(std::vector<uint8_t>& image);
+}
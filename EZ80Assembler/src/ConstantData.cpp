@@ -0,0 +1,285 @@
+#include "ConstantData.h"
+#include "Expression.h"
+#include "Instructions.h"
+#include "Layout.h"
+#include "PlatformSymbols.h"
+#include "SourceScope.h"
+#include "StringUtil.h"
+#include "Profile.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ez80
+{
+	static constexpr size_t s_NoBlock = static_cast<size_t>(-1);
+
+	// Odd, so that multiplying by it modulo 2^64 loses nothing.
+	static constexpr uint64_t s_HashBase = 0x100000001B3;
+
+	// Lines from one label up to the next.
+	struct DataBlock
+	{
+		size_t labelLineIndex = 0;
+		size_t endLineIndex = 0; // One past its last line.
+		std::string_view name; // Fully qualified.
+		size_t firstByte = 0; // Into the bytes of every block.
+		size_t size = 0;
+		uint64_t hash = 0; // Of all of its bytes, see HashTailStep.
+		bool constant = true; // Nothing but data, all with values known before layout.
+		bool empty = true; // Nothing that emits bytes, i.e. a start or end marker.
+		bool fixed = false; // Can't be folded away, because code falls into it or it's exported.
+		size_t target = s_NoBlock; // The block it's folded into, if any.
+		size_t offset = 0; // Into target.
+		bool tail = false; // Folded into the end of a longer block, rather than onto an identical one.
+	};
+
+	// Hashes a block's bytes from its end, so that the hash of every tail is one step from the next shorter one's.
+	static constexpr uint64_t HashTailStep(uint64_t hash, uint8_t byte) noexcept
+	{
+		return hash * s_HashBase + byte + 1;
+	}
+
+	// Tails of different lengths can hash the same, so the length is mixed into the key.
+	static constexpr uint64_t TailKey(uint64_t hash, size_t size) noexcept
+	{
+		return hash ^ (static_cast<uint64_t>(size) * 0x9E3779B97F4A7C15);
+	}
+
+	// Escapes other than \\, \" and \' aren't given values yet, so strings with them are never treated as constant.
+	static bool AppendStringLiteral(std::string_view literal, std::pmr::vector<uint8_t>& bytes)
+	{
+		for (size_t i = 1; i < literal.size(); i++)
+		{
+			char c = literal[i];
+			if (c == '"')
+				return i + 1 == literal.size();
+			if (c == '\\')
+			{
+				if (++i == literal.size() || (literal[i] != '\\' && literal[i] != '"' && literal[i] != '\''))
+					return false;
+				c = literal[i];
+			}
+			bytes.push_back(static_cast<uint8_t>(c));
+		}
+		return false;
+	}
+
+	// Returns false if any of the line's values aren't known before layout.
+	static bool AppendData(const TokenizedLine& tokenizedLine, const ExpressionResolver& resolve, std::pmr::vector<uint8_t>& bytes)
+	{
+		std::string_view directive = tokenizedLine[0];
+		uint32_t elementSize = directive == ".db" ? 1 : directive == ".dw" ? 2 : directive == ".dl" ? 3 : 0;
+		if (elementSize == 0)
+			return false;
+
+		for (std::string_view operand : tokenizedLine.Operands())
+		{
+			operand = util::string::TrimBlanks(operand);
+			if (elementSize == 1 && operand.starts_with('"'))
+			{
+				if (!AppendStringLiteral(operand, bytes))
+					return false;
+				continue;
+			}
+
+			int64_t value = 0;
+			if (!EvaluateExpression(operand, resolve, value))
+				return false;
+			for (uint32_t i = 0; i < elementSize; i++)
+				bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+		return true;
+	}
+
+	static std::string_view CopyToArena(std::string_view string, std::pmr::memory_resource* arena)
+	{
+		char* copy = static_cast<char*>(arena->allocate(string.size(), alignof(char)));
+		std::copy(string.begin(), string.end(), copy);
+		return { copy, string.size() };
+	}
+
+	void MergeConstantData(std::pmr::vector<TokenizedLine>& tokenizedLines, std::pmr::vector<Equate>& equates,
+		const std::vector<std::string>& exportedSymbols, bool platformSymbols, std::vector<AssemblerRewrite>& rewrites)
+	{
+		PROFILE_FUNCTION();
+
+		std::pmr::memory_resource* arena = tokenizedLines.get_allocator().resource();
+		std::pmr::vector<DataBlock> blocks(arena);
+		std::pmr::vector<uint8_t> bytes(arena);
+
+		// Split the lines into blocks, and work out the bytes of every one that's constant.
+		// Data can only use equates before layout, and each is evaluated once however many lines use it.
+		{
+			EquateResolver resolver(equates, [platformSymbols](std::string_view identifier, int64_t& outValue)
+			{
+				return platformSymbols && FindPlatformSymbol(identifier, outValue);
+			});
+			ExpressionResolver resolve = resolver.Resolver();
+			FlowScan flow;
+			auto EndBlock = [&](size_t endLineIndex, bool empty)
+			{
+				if (blocks.empty())
+					return;
+				DataBlock& block = blocks.back();
+				block.endLineIndex = endLineIndex;
+				block.empty = empty;
+				if (!block.constant)
+					bytes.resize(block.firstByte);
+				block.size = bytes.size() - block.firstByte;
+			};
+
+			for (size_t lineIndex = 0; lineIndex < tokenizedLines.size(); lineIndex++)
+			{
+				const TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+				bool fallenInto = flow.FallsThrough();
+				bool empty = flow.AfterEmptyLabel();
+				LineKind kind = flow.Visit(tokenizedLine);
+				if (kind == LineKind_Label)
+				{
+					EndBlock(lineIndex, empty);
+					DataBlock& block = blocks.emplace_back();
+					block.labelLineIndex = lineIndex;
+					block.name = flow.Scope().Qualify(GetLabelName(tokenizedLine), arena);
+					block.firstByte = bytes.size();
+					block.fixed = fallenInto;
+					continue;
+				}
+
+				if (blocks.empty() || kind == LineKind_NamespaceBegin || kind == LineKind_NamespaceEnd)
+					continue;
+				DataBlock& block = blocks.back();
+				if (kind == LineKind_Data)
+				{
+					if (block.constant && !AppendData(tokenizedLine, resolve, bytes))
+						block.constant = false;
+				}
+				else // Conditionals and macros could change what the block holds, and code or other directives aren't constant.
+					block.constant = false;
+			}
+			EndBlock(tokenizedLines.size(), flow.AfterEmptyLabel());
+		}
+
+		std::pmr::unordered_set<std::string_view> exported(exportedSymbols.begin(), exportedSymbols.end(), 0, arena);
+		for (size_t i = 0; i < blocks.size(); i++)
+		{
+			DataBlock& block = blocks[i];
+			block.fixed = block.fixed || exported.contains(block.name);
+
+			// See FlowScan::AfterEmptyLabel.
+			if ((i > 0 && blocks[i - 1].empty) || (i + 1 < blocks.size() && blocks[i + 1].empty))
+				block.fixed = true;
+
+			if (block.size == 0)
+				block.constant = false;
+			if (block.constant)
+				for (size_t j = block.size; j-- > 0;)
+					block.hash = HashTailStep(block.hash, bytes[block.firstByte + j]);
+		}
+
+		auto BlockBytes = [&bytes](const DataBlock& block)
+		{
+			return std::span<const uint8_t>(bytes).subspan(block.firstByte, block.size);
+		};
+
+		// Fold identical blocks onto the first of them.
+		std::pmr::unordered_multimap<uint64_t, size_t> roots(arena);
+		for (size_t i = 0; i < blocks.size(); i++)
+		{
+			DataBlock& block = blocks[i];
+			if (!block.constant)
+				continue;
+
+			uint64_t key = TailKey(block.hash, block.size);
+			if (!block.fixed)
+			{
+				auto [first, last] = roots.equal_range(key);
+				for (auto it = first; it != last; ++it)
+				{
+					if (std::ranges::equal(BlockBytes(blocks[it->second]), BlockBytes(block)))
+					{
+						block.target = it->second;
+						break;
+					}
+				}
+			}
+			if (block.target == s_NoBlock)
+				roots.emplace(key, i);
+		}
+
+		// Index the proper tails of every block left, by the same hash each block's whole is keyed by,
+		// so that finding whether a block is the tail of any other is one lookup.
+		std::pmr::vector<size_t> rootIndices(arena);
+		std::pmr::unordered_multimap<uint64_t, size_t> tails(arena);
+		tails.reserve(bytes.size());
+		for (size_t i = 0; i < blocks.size(); i++)
+		{
+			const DataBlock& block = blocks[i];
+			if (!block.constant || block.target != s_NoBlock)
+				continue;
+
+			rootIndices.push_back(i);
+			uint64_t hash = 0;
+			for (size_t size = 1; size < block.size; size++)
+			{
+				hash = HashTailStep(hash, bytes[block.firstByte + block.size - size]);
+				tails.emplace(TailKey(hash, size), i);
+			}
+		}
+
+		// Longest first, so that whatever a block is folded into has already been folded as far as it goes.
+		std::sort(rootIndices.begin(), rootIndices.end(), [&blocks](size_t left, size_t right)
+		{
+			return blocks[left].size != blocks[right].size ? blocks[left].size > blocks[right].size : left < right;
+		});
+		for (size_t i : rootIndices)
+		{
+			DataBlock& block = blocks[i];
+			if (block.fixed)
+				continue;
+
+			auto [first, last] = tails.equal_range(TailKey(block.hash, block.size));
+			for (auto it = first; it != last; ++it)
+			{
+				const DataBlock& longer = blocks[it->second];
+				if (longer.size <= block.size || !std::ranges::equal(BlockBytes(longer).last(block.size), BlockBytes(block)))
+					continue;
+
+				block.target = longer.target == s_NoBlock ? it->second : longer.target;
+				block.offset = (longer.target == s_NoBlock ? 0 : longer.offset) + longer.size - block.size;
+				block.tail = true;
+				break;
+			}
+		}
+
+		// Rewrite every folded label as an equate of where its copy now is, and remove its data.
+		std::string value;
+		for (DataBlock& block : blocks)
+		{
+			if (block.target == s_NoBlock)
+				continue;
+
+			// An identical block's first copy may have been folded into the tail of another since.
+			if (const DataBlock& target = blocks[block.target]; target.target != s_NoBlock)
+			{
+				block.offset += target.offset;
+				block.target = target.target;
+			}
+
+			value = blocks[block.target].name;
+			if (block.offset)
+			{
+				value += " + ";
+				value += std::to_string(block.offset);
+			}
+			equates.emplace_back(block.name, CopyToArena(value, arena), tokenizedLines[block.labelLineIndex].number);
+
+			for (size_t lineIndex = block.labelLineIndex; lineIndex < block.endLineIndex; lineIndex++)
+				if (!tokenizedLines[lineIndex][0].starts_with('#'))
+					tokenizedLines[lineIndex].handled = true;
+
+			rewrites.emplace_back(block.tail ? AssemblerRewrite_TailMergedData : AssemblerRewrite_DuplicateData,
+				tokenizedLines[block.labelLineIndex].number, static_cast<uint32_t>(block.size), 0);
+		}
+	}
+}
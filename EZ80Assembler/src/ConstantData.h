@@ -0,0 +1,16 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "EZ80Assembler.h"
+
+namespace ez80
+{
+	// Folds labelled blocks of constant .db, .dw and .dl data that are byte for byte identical onto the first of them,
+	// and blocks that are the tail of a longer one, like "thing", 0 and "test; thing", 0, into the end of it.
+	// The folded labels become equates of the copy they now point into, and their lines are marked as handled.
+	// Only blocks of nothing but data with a value known before layout are folded, and never one that code falls into,
+	// one that ends at a label of its own (i.e. String: ... StringEnd:), or one that's exported.
+	// With platformSymbols, names that aren't equates are looked up with FindPlatformSymbol.
+	void MergeConstantData(std::pmr::vector<TokenizedLine>& tokenizedLines, std::pmr::vector<Equate>& equates,
+		const std::vector<std::string>& exportedSymbols, bool platformSymbols, std::vector<AssemblerRewrite>& rewrites);
+}
@@ -0,0 +1,237 @@
+#include "CycleReport.h"
+#include "SourceScope.h"
+#include "Profile.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace ez80
+{
+	static constexpr const char* s_ModeNames[AssemblyMode_Count] = { "adl", "z80" };
+
+	void BuildCycleReport(const std::pmr::vector<TokenizedLine>& tokenizedLines, std::vector<CycleReportEntry>& entries)
+	{
+		PROFILE_FUNCTION();
+
+		constexpr size_t noEntry = static_cast<size_t>(-1);
+
+		SourceScope scope;
+		std::vector<size_t> namespaceEntries;
+		size_t labelEntry = noEntry;
+
+		auto AddCost = [&entries](size_t entryIndex, const InstructionInfo& info)
+		{
+			CycleReportEntry& entry = entries[entryIndex];
+			for (AssemblyMode mode = 0; mode < AssemblyMode_Count; mode++)
+			{
+				const InstructionCost& cost = info.costs[mode];
+				entry.size[mode] += cost.size;
+				entry.bestCycles[mode] += std::min(cost.cycles, cost.takenCycles);
+				entry.worstCycles[mode] += std::max(cost.cycles, cost.takenCycles);
+			}
+		};
+
+		for (const auto& tokenizedLine : tokenizedLines)
+		{
+			std::string_view token0 = tokenizedLine[0];
+
+			switch (scope.Visit(tokenizedLine))
+			{
+				case SourceScopeEvent_NamespaceBegin:
+				{
+					namespaceEntries.push_back(entries.size());
+					labelEntry = noEntry;
+
+					auto& entry = entries.emplace_back();
+					entry.name = scope.CurrentNamespace();
+					entry.lineNumber = tokenizedLine.number;
+					entry.isNamespace = true;
+					continue;
+				}
+				case SourceScopeEvent_NamespaceEnd:
+				{
+					namespaceEntries.pop_back();
+					labelEntry = noEntry;
+					continue;
+				}
+				case SourceScopeEvent_Label:
+				{
+					labelEntry = entries.size();
+					auto& entry = entries.emplace_back();
+					entry.name = scope.Qualify(GetLabelName(tokenizedLine));
+					entry.lineNumber = tokenizedLine.number;
+					continue;
+				}
+				case SourceScopeEvent_Preprocessor:
+				case SourceScopeEvent_MacroBody: // Macro bodies are costed where they are expanded, not where they are defined.
+					continue;
+			}
+
+			InstructionInfo info;
+			bool known = LookupDataDirective(token0, tokenizedLine.Operands(), info) ||
+				LookupInstruction(token0, tokenizedLine.Operands(), info);
+
+			// Other dot directives, like .org, don't emit anything.
+			if (!known && token0.starts_with('.'))
+				continue;
+
+			auto Attribute = [&](size_t entryIndex)
+			{
+				if (!known)
+				{
+					entries[entryIndex].unknownLineCount++;
+					return;
+				}
+
+				AddCost(entryIndex, info);
+				if (info.flags & InstructionFlags_Branch)
+				{
+					auto& branch = entries[entryIndex].branches.emplace_back();
+					branch.lineNumber = tokenizedLine.number;
+					branch.mnemonic = token0;
+					if ((info.flags & InstructionFlags_Conditional) && tokenizedLine.tokenCount > 1 && IsCondition(tokenizedLine[1]))
+						branch.condition = tokenizedLine[1];
+					for (AssemblyMode mode = 0; mode < AssemblyMode_Count; mode++)
+					{
+						branch.takenCycles[mode] = info.costs[mode].takenCycles;
+						branch.untakenCycles[mode] = info.costs[mode].cycles;
+					}
+				}
+			};
+
+			if (labelEntry != noEntry)
+				Attribute(labelEntry);
+			for (size_t namespaceEntry : namespaceEntries)
+				Attribute(namespaceEntry);
+		}
+	}
+
+	// Writes text as a JSON string, escaping quotes, backslashes and control characters.
+	static void WriteJsonString(std::ostream& stream, std::string_view text)
+	{
+		static constexpr const char* s_HexDigits = "0123456789abcdef";
+
+		stream << '"';
+		for (char c : text)
+		{
+			unsigned char byte = static_cast<unsigned char>(c);
+			if (c == '"' || c == '\\')
+				stream << '\\' << c;
+			else if (byte < 0x20)
+				stream << "\\u00" << s_HexDigits[byte >> 4] << s_HexDigits[byte & 0xF];
+			else
+				stream << c;
+		}
+		stream << '"';
+	}
+
+	bool WriteCycleReport(const std::filesystem::path& filepath, const std::vector<CycleReportEntry>& entries)
+	{
+		PROFILE_FUNCTION();
+
+		std::filesystem::path jsonFilepath = filepath;
+		std::filesystem::path textFilepath = filepath;
+		jsonFilepath.replace_extension(".json");
+		textFilepath.replace_extension(".txt");
+
+		// Machine readable report, in source order.
+		{
+			std::ofstream file(jsonFilepath);
+			if (!file.is_open())
+				return false;
+
+			file << "{\n\t\"entries\": [";
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				const auto& entry = entries[i];
+				file << (i ? ",\n" : "\n");
+				file << "\t\t{\n";
+				file << "\t\t\t\"name\": ";
+				WriteJsonString(file, entry.name);
+				file << ",\n";
+				file << "\t\t\t\"kind\": \"" << (entry.isNamespace ? "namespace" : "label") << "\",\n";
+				file << "\t\t\t\"line\": " << entry.lineNumber + 1 << ",\n";
+				for (AssemblyMode mode = 0; mode < AssemblyMode_Count; mode++)
+				{
+					file << "\t\t\t\"" << s_ModeNames[mode] << "\": { \"size\": " << entry.size[mode]
+						<< ", \"bestCycles\": " << entry.bestCycles[mode]
+						<< ", \"worstCycles\": " << entry.worstCycles[mode] << " },\n";
+				}
+				file << "\t\t\t\"unknownLines\": " << entry.unknownLineCount << ",\n";
+				file << "\t\t\t\"branches\": [";
+				for (size_t j = 0; j < entry.branches.size(); j++)
+				{
+					const auto& branch = entry.branches[j];
+					file << (j ? ",\n" : "\n");
+					file << "\t\t\t\t{ \"line\": " << branch.lineNumber + 1
+						<< ", \"mnemonic\": ";
+					WriteJsonString(file, branch.mnemonic);
+					file << ", \"condition\": ";
+					WriteJsonString(file, branch.condition);
+					for (AssemblyMode mode = 0; mode < AssemblyMode_Count; mode++)
+					{
+						file << ", \"" << s_ModeNames[mode] << "\": { \"taken\": " << static_cast<uint32_t>(branch.takenCycles[mode])
+							<< ", \"untaken\": " << static_cast<uint32_t>(branch.untakenCycles[mode]) << " }";
+					}
+					file << " }";
+				}
+				file << (entry.branches.empty() ? "]\n" : "\n\t\t\t]\n");
+				file << "\t\t}";
+			}
+			file << "\n\t]\n}\n";
+
+			if (!file.good())
+				return false;
+		}
+
+		// Human readable summary, sorted by name so that it diffs cleanly between commits.
+		{
+			std::ofstream file(textFilepath);
+			if (!file.is_open())
+				return false;
+
+			std::vector<const CycleReportEntry*> sortedEntries;
+			sortedEntries.reserve(entries.size());
+			size_t nameWidth = 4;
+			for (const auto& entry : entries)
+			{
+				sortedEntries.push_back(&entry);
+				nameWidth = std::max(nameWidth, entry.name.size());
+			}
+			std::stable_sort(sortedEntries.begin(), sortedEntries.end(), [](const CycleReportEntry* left, const CycleReportEntry* right) { return left->name < right->name; });
+
+			file << std::left << std::setw(nameWidth) << "name" << std::right
+				<< std::setw(8) << "line"
+				<< std::setw(12) << "adl size" << std::setw(12) << "adl best" << std::setw(12) << "adl worst"
+				<< std::setw(12) << "z80 size" << std::setw(12) << "z80 best" << std::setw(12) << "z80 worst"
+				<< std::setw(10) << "unknown" << '\n';
+
+			for (const CycleReportEntry* entry : sortedEntries)
+			{
+				file << std::left << std::setw(nameWidth) << entry->name << std::right
+					<< std::setw(8) << entry->lineNumber + 1;
+				for (AssemblyMode mode = 0; mode < AssemblyMode_Count; mode++)
+					file << std::setw(12) << entry->size[mode] << std::setw(12) << entry->bestCycles[mode] << std::setw(12) << entry->worstCycles[mode];
+				file << std::setw(10) << entry->unknownLineCount << '\n';
+
+				for (const auto& branch : entry->branches)
+				{
+					file << "    line " << branch.lineNumber + 1 << ": " << branch.mnemonic;
+					if (!branch.condition.empty())
+						file << ' ' << branch.condition;
+					for (AssemblyMode mode = 0; mode < AssemblyMode_Count; mode++)
+					{
+						file << ", " << s_ModeNames[mode] << " taken " << static_cast<uint32_t>(branch.takenCycles[mode])
+							<< " untaken " << static_cast<uint32_t>(branch.untakenCycles[mode]);
+					}
+					file << '\n';
+				}
+			}
+
+			if (!file.good())
+				return false;
+		}
+
+		return true;
+	}
+}
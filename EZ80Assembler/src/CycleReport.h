@@ -0,0 +1,38 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "Instructions.h"
+#include <filesystem>
+#include <string>
+
+namespace ez80
+{
+	struct BranchCost
+	{
+		size_t lineNumber = 0;
+		std::string_view mnemonic;
+		std::string_view condition; // Empty if the branch is unconditional.
+		uint8_t takenCycles[AssemblyMode_Count]{};
+		uint8_t untakenCycles[AssemblyMode_Count]{};
+	};
+
+	// Best and worst cases assume every line attributed to the entry executes exactly once.
+	// Repeating instructions (ldir, etc.) are counted as a single iteration.
+	struct CycleReportEntry
+	{
+		std::string name; // Fully qualified, e.g. name_space.String
+		size_t lineNumber = 0;
+		bool isNamespace = false;
+		uint32_t size[AssemblyMode_Count]{};
+		uint32_t bestCycles[AssemblyMode_Count]{};
+		uint32_t worstCycles[AssemblyMode_Count]{};
+		uint32_t unknownLineCount = 0; // Lines that couldn't be costed, such as macro invocations.
+		std::vector<BranchCost> branches;
+	};
+
+	// Attributes every instruction and data line to its enclosing label and namespaces.
+	void BuildCycleReport(const std::pmr::vector<TokenizedLine>& tokenizedLines, std::vector<CycleReportEntry>& entries);
+
+	// Writes filepath with a .json extension and a text summary, sorted by name, with a .txt extension.
+	bool WriteCycleReport(const std::filesystem::path& filepath, const std::vector<CycleReportEntry>& entries);
+}
@@ -0,0 +1,192 @@
+#include "DeadCode.h"
+#include "AssemblerStringUtil.h"
+#include "Expression.h"
+#include "Instructions.h"
+#include "Layout.h"
+#include "SourceScope.h"
+#include "StringUtil.h"
+#include "Profile.h"
+#include <unordered_map>
+
+namespace ez80
+{
+	static constexpr size_t s_NoBlock = static_cast<size_t>(-1);
+
+	// Lines from one label up to the next, or from the start of the file up to the first label.
+	struct Block
+	{
+		size_t labelLineIndex = 0;
+		std::string_view name; // Fully qualified, empty for the first block.
+		size_t firstReference = 0; // References from this block are the ones up to the next block's first.
+		bool reachable = false;
+	};
+
+	// One block referencing another, including the one it falls into.
+	struct Reference
+	{
+		size_t from = 0;
+		size_t to = 0;
+	};
+
+	void EliminateDeadCode(std::pmr::vector<TokenizedLine>& tokenizedLines, const std::pmr::vector<Equate>& equates,
+		const std::vector<std::string>& exportedSymbols, std::vector<AssemblerRemoval>& removals, std::vector<AssemblerWarning>& warnings)
+	{
+		PROFILE_FUNCTION();
+
+		std::pmr::memory_resource* arena = tokenizedLines.get_allocator().resource();
+		std::pmr::vector<Block> blocks(1, arena);
+		std::pmr::vector<size_t> lineBlocks(tokenizedLines.size(), 0, arena);
+		std::pmr::unordered_map<std::string_view, size_t> labelBlocks(arena);
+		std::pmr::vector<Reference> references(arena);
+
+		// Split the lines into blocks, and find what every label is called.
+		{
+			FlowScan flow;
+			for (size_t lineIndex = 0; lineIndex < tokenizedLines.size(); lineIndex++)
+			{
+				const TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+				LineKind kind = flow.Visit(tokenizedLine);
+				if (kind == LineKind_Label)
+				{
+					Block& block = blocks.emplace_back();
+					block.labelLineIndex = lineIndex;
+					block.name = flow.Scope().Qualify(GetLabelName(tokenizedLine), arena);
+					labelBlocks.emplace(block.name, blocks.size() - 1);
+				}
+				else if (kind == LineKind_MacroInvocation || (kind == LineKind_UnsizedPreprocessor && tokenizedLine[0] == "#include"))
+				{
+					// What they reference isn't known until they're expanded.
+					warnings.emplace_back(AssemblerWarning_DeadCodeKept, tokenizedLine.number);
+					return;
+				}
+				lineBlocks[lineIndex] = blocks.size() - 1;
+			}
+		}
+
+		std::pmr::vector<size_t> worklist(arena);
+		auto Reach = [&blocks, &worklist](size_t blockIndex)
+		{
+			if (!blocks[blockIndex].reachable)
+			{
+				blocks[blockIndex].reachable = true;
+				worklist.push_back(blockIndex);
+			}
+		};
+
+		// Labels in the enclosing namespace shadow global ones, the same way they are defined.
+		std::string qualified;
+		auto Resolve = [&labelBlocks, &qualified](const SourceScope& lookupScope, std::string_view identifier)
+		{
+			auto it = labelBlocks.find(lookupScope.Qualify(identifier, qualified));
+			if (it == labelBlocks.end())
+				it = labelBlocks.find(identifier);
+			return it == labelBlocks.end() ? s_NoBlock : it->second;
+		};
+
+		// Build the reference graph, once over every token.
+		{
+			FlowScan flow;
+			SourceScope globalScope;
+
+			auto ReachAll = [&](const SourceScope& lookupScope, std::string_view operand)
+			{
+				ForEachIdentifier(operand, [&](std::string_view identifier)
+				{
+					if (size_t target = Resolve(lookupScope, identifier); target != s_NoBlock)
+						Reach(target);
+				});
+			};
+
+			for (size_t lineIndex = 0; lineIndex < tokenizedLines.size(); lineIndex++)
+			{
+				const TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+				size_t blockIndex = lineBlocks[lineIndex];
+
+				bool fallenInto = flow.FallsThrough();
+				switch (flow.Visit(tokenizedLine))
+				{
+					case LineKind_Label:
+					{
+						// The previous block runs straight into this one.
+						if (fallenInto)
+							references.push_back({ blockIndex - 1, blockIndex });
+						continue;
+					}
+					case LineKind_NamespaceBegin:
+					case LineKind_NamespaceEnd:
+						continue;
+					case LineKind_Preprocessor:
+					case LineKind_UnsizedPreprocessor:
+					case LineKind_MacroBody:
+					{
+						// These can be expanded or evaluated anywhere.
+						for (std::string_view operand : tokenizedLine.Operands())
+							ReachAll(flow.Scope(), operand);
+						continue;
+					}
+				}
+
+				for (std::string_view operand : tokenizedLine.Operands())
+				{
+					ForEachIdentifier(operand, [&](std::string_view identifier)
+					{
+						if (size_t target = Resolve(flow.Scope(), identifier); target != s_NoBlock)
+							references.push_back({ blockIndex, target });
+					});
+				}
+			}
+
+			for (const auto& equate : equates)
+				ReachAll(globalScope, equate.value);
+			for (const auto& symbol : exportedSymbols)
+				ReachAll(globalScope, symbol);
+		}
+
+		// References are found in line order, so they're already grouped by the block they're from.
+		// The extra block at the end marks where the last one's stop.
+		blocks.emplace_back();
+		for (size_t blockIndex = 0, i = 0; blockIndex < blocks.size(); blockIndex++)
+		{
+			blocks[blockIndex].firstReference = i;
+			while (i < references.size() && references[i].from == blockIndex)
+				i++;
+		}
+
+		Reach(0);
+		while (!worklist.empty())
+		{
+			size_t blockIndex = worklist.back();
+			worklist.pop_back();
+			for (size_t i = blocks[blockIndex].firstReference; i < blocks[blockIndex + 1].firstReference; i++)
+				Reach(references[i].to);
+		}
+
+		// Remove everything that emits bytes from unreachable blocks, keeping preprocessor statements and other directives.
+		SourceScope scope;
+		for (size_t lineIndex = 0; lineIndex < tokenizedLines.size(); lineIndex++)
+		{
+			TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+			SourceScopeEvent event = scope.Visit(tokenizedLine);
+
+			const Block& block = blocks[lineBlocks[lineIndex]];
+			if (block.reachable)
+				continue;
+
+			if (event == SourceScopeEvent_Label)
+			{
+				removals.emplace_back(block.name, tokenizedLine.number);
+				tokenizedLine.handled = true;
+			}
+			else if (event == SourceScopeEvent_None)
+			{
+				InstructionInfo info;
+				bool isData = LookupDataDirective(tokenizedLine[0], tokenizedLine.Operands(), info);
+				if (!isData && tokenizedLine[0].starts_with('.'))
+					continue;
+				if (isData || LookupInstruction(tokenizedLine[0], tokenizedLine.Operands(), info))
+					removals.back().bytesSaved += info.costs[AssemblyMode_ADL].size;
+				tokenizedLine.handled = true;
+			}
+		}
+	}
+}
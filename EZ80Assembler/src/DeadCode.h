@@ -0,0 +1,16 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "EZ80Assembler.h"
+
+namespace ez80
+{
+	// Removes every label, and the code or data after it, that can't be reached from the program's entry point,
+	// marking its lines as handled. Everything before the first label, including the header, is the entry point.
+	// Labels are reached by being referenced from a reachable line, by being fallen into, or by being in exportedSymbols.
+	// References from macro bodies, preprocessor statements and equates are always treated as reachable.
+	// Either branch of a conditional can fall into what follows it. What an #include or a macro invocation references
+	// isn't known, so if there are any, nothing is removed and AssemblerWarning_DeadCodeKept is added for the first.
+	void EliminateDeadCode(std::pmr::vector<TokenizedLine>& tokenizedLines, const std::pmr::vector<Equate>& equates,
+		const std::vector<std::string>& exportedSymbols, std::vector<AssemblerRemoval>& removals, std::vector<AssemblerWarning>& warnings);
+}
@@ -11,3 +11,9 @@
 	#define stdcerr(x)
 	#define stdcin(x)
 #endif
+
+#if SYSTEM_WINDOWS
+	#define DEBUG_BREAK() __debugbreak()
+#else
+	#define DEBUG_BREAK() __builtin_trap()
+#endif
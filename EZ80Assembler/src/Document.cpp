@@ -0,0 +1,743 @@
+#include "Document.h"
+#include "AssemblerTypes.h"
+#include "Expression.h"
+#include "Profile.h"
+#include <algorithm>
+
+namespace ez80
+{
+	AssemblerError::ID StripLine(std::string_view& line);
+	AssemblerError TokenizeLine(std::string_view line, size_t lineNumber, std::pmr::vector<std::string_view>& tokens, std::pmr::vector<TokenizedLineView>& tokenizedLineViews, std::vector<AssemblerWarning>& warnings);
+
+	// The same as AssemblerLimits::maxEquateDepth, so a document evaluates whatever would assemble.
+	static constexpr uint32_t s_MaxEvaluationDepth = 1024;
+
+	// Lines per block, give or take. An edit renumbers about two blocks' lines, and moves the start of every block.
+	static constexpr size_t s_BlockSize = 256;
+
+	enum DocumentLineKind_ : uint8_t
+	{
+		DocumentLineKind_Other = 0,
+		DocumentLineKind_Namespace,
+		DocumentLineKind_EndNamespace,
+		DocumentLineKind_Macro,
+		DocumentLineKind_EndMacro,
+		DocumentLineKind_If,
+		DocumentLineKind_Elif,
+		DocumentLineKind_Else,
+		DocumentLineKind_EndIf,
+	};
+	using DocumentLineKind = std::underlying_type_t<DocumentLineKind_>;
+
+	struct DocumentLine
+	{
+		std::string text;
+		std::pmr::vector<std::string_view> tokens; // Into text, which never changes, since an edit replaces the whole line.
+		std::pmr::vector<TokenizedLineView> statements; // Into tokens.
+		AssemblerError::ID error = AssemblerError_None; // From stripping or tokenizing.
+		AssemblerError::ID structureError = AssemblerError_None; // From unbalanced #if, #macro or #namespace lines.
+		std::vector<AssemblerWarning::ID> warnings;
+
+		DocumentBlock* block = nullptr;
+		size_t offset = 0; // From the start of block.
+		DocumentLineKind kind = DocumentLineKind_Other;
+		uint32_t scope = 0; // Into Document::scopes, the namespace in effect after this line.
+		uint32_t macroDepth = 0; // After this line.
+		bool macroBody = false; // Nothing in a macro body is defined until it's expanded.
+		bool registered = false;
+		bool conditionStale = false;
+		int8_t condition = -1; // Of #if and #elif, 1 if true, 0 if false, -1 if it can't be evaluated.
+
+		std::vector<std::string> definedNames;
+		std::vector<std::string> usedNames; // The last part of each, as keys into Document::dependents.
+
+		std::string_view Token(const TokenizedLineView& statement, size_t index) const noexcept { return tokens[statement.start + index]; }
+	};
+
+	struct DocumentBlock
+	{
+		size_t firstLineIndex = 0;
+	};
+
+	static size_t Index(const DocumentLine& line) noexcept
+	{
+		return line.block->firstLineIndex + line.offset;
+	}
+
+	bool Document::LineOrder::operator()(const DocumentLine* left, const DocumentLine* right) const noexcept
+	{
+		return Index(*left) < Index(*right);
+	}
+
+	static constexpr bool IsScope(DocumentLineKind kind) noexcept
+	{
+		return kind >= DocumentLineKind_Namespace && kind <= DocumentLineKind_EndMacro;
+	}
+
+	static constexpr bool IsConditional(DocumentLineKind kind) noexcept
+	{
+		return kind >= DocumentLineKind_If;
+	}
+
+	// The part after the last dot, so that name_space.String and String depend on each other.
+	static std::string_view LastPart(std::string_view name) noexcept
+	{
+		size_t dot = name.find_last_of('.');
+		return dot == std::string_view::npos ? name : name.substr(dot + 1);
+	}
+
+	static DocumentLineKind Classify(const DocumentLine& line) noexcept
+	{
+		if (line.statements.empty())
+			return DocumentLineKind_Other;
+
+		std::string_view token0 = line.Token(line.statements.back(), 0);
+		if (!token0.starts_with('#'))
+			return DocumentLineKind_Other;
+
+		std::string_view directive = token0.substr(1);
+		if (directive == "namespace") return DocumentLineKind_Namespace;
+		if (directive == "endnamespace") return DocumentLineKind_EndNamespace;
+		if (directive == "macro") return DocumentLineKind_Macro;
+		if (directive == "endmacro") return DocumentLineKind_EndMacro;
+		if (directive == "if") return DocumentLineKind_If;
+		if (directive == "elif") return DocumentLineKind_Elif;
+		if (directive == "else") return DocumentLineKind_Else;
+		if (directive == "endif") return DocumentLineKind_EndIf;
+		return DocumentLineKind_Other;
+	}
+
+	Document::Document()
+	{
+		InternScope({});
+	}
+
+	Document::~Document() = default;
+
+	void Document::Edit(size_t firstLineIndex, size_t removedLineCount, std::string_view text)
+	{
+		PROFILE_FUNCTION();
+
+		firstLineIndex = std::min(firstLineIndex, lines.size());
+		removedLineCount = std::min(removedLineCount, lines.size() - firstLineIndex);
+		size_t removedEndIndex = firstLineIndex + removedLineCount;
+
+		// Split the same way ReadFile does, so that \r\n line endings don't end up in the last token.
+		std::vector<std::unique_ptr<DocumentLine>> newLines;
+		for (size_t start = 0; !text.empty(); )
+		{
+			size_t end = text.find('\n', start);
+			std::string_view piece = text.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+			if (piece.ends_with('\r'))
+				piece.remove_suffix(1);
+
+			auto& line = newLines.emplace_back(std::make_unique<DocumentLine>());
+			line->text = piece;
+			Lex(*line);
+
+			if (end == std::string_view::npos)
+				break;
+			start = end + 1;
+		}
+
+		// Lines inherit the namespace and macro they're in from the line before, so unless #namespace or #macro
+		// lines were edited, nothing else has to be looked at. Conditionals are spliced into the ones outside the
+		// edit, and only have to be balanced against them again if #if, #elif, #else or #endif were added or removed.
+		bool scopesChanged = false;
+		bool conditionalsChanged = false;
+		bool conditionalsEdited = false;
+		{
+			std::vector<DocumentLineKind> removedKinds;
+			std::vector<DocumentLineKind> newKinds;
+			for (size_t i = firstLineIndex; i < removedEndIndex; i++)
+			{
+				const DocumentLine& line = *lines[i];
+				scopesChanged |= IsScope(line.kind);
+				if (IsConditional(line.kind))
+				{
+					removedKinds.push_back(line.kind);
+					conditionalsChanged |= line.structureError != AssemblerError_None;
+				}
+			}
+			for (const auto& line : newLines)
+			{
+				scopesChanged |= IsScope(line->kind);
+				if (IsConditional(line->kind))
+					newKinds.push_back(line->kind);
+			}
+			conditionalsChanged |= removedKinds != newKinds;
+			conditionalsEdited = !removedKinds.empty() || !newKinds.empty();
+		}
+
+		const DocumentLine* previous = firstLineIndex ? lines[firstLineIndex - 1].get() : nullptr;
+		for (auto& line : newLines)
+		{
+			line->scope = previous ? previous->scope : 0;
+			line->macroDepth = previous ? previous->macroDepth : 0;
+			line->macroBody = line->macroDepth > 0;
+		}
+
+		if (!scopesChanged)
+		{
+			auto ByIndex = [](const DocumentLine* line, size_t index) { return Index(*line) < index; };
+			auto first = std::lower_bound(conditionals.begin(), conditionals.end(), firstLineIndex, ByIndex);
+			auto last = std::lower_bound(first, conditionals.end(), removedEndIndex, ByIndex);
+			first = conditionals.erase(first, last);
+
+			std::vector<DocumentLine*> newConditionals;
+			for (auto& line : newLines)
+				if (IsConditional(line->kind) && !line->macroBody)
+					newConditionals.push_back(line.get());
+			conditionals.insert(first, newConditionals.begin(), newConditionals.end());
+		}
+
+		for (size_t i = firstLineIndex; i < removedEndIndex; i++)
+		{
+			DocumentLine& line = *lines[i];
+			if (line.registered)
+				Unregister(line);
+			diagnosticLines.erase(&line);
+		}
+
+		// Lines that replace as many others take their places in their blocks. Otherwise the blocks with the line
+		// before the edit, the lines it removes and the line after it are split up again.
+		size_t newLineCount = newLines.size();
+		size_t firstBlock = 0;
+		size_t endBlock = 0;
+		if (newLineCount == removedLineCount)
+		{
+			for (size_t i = 0; i < newLineCount; i++)
+			{
+				newLines[i]->block = lines[firstLineIndex + i]->block;
+				newLines[i]->offset = lines[firstLineIndex + i]->offset;
+			}
+		}
+		else
+		{
+			firstBlock = blocks.empty() ? 0 : FindBlock(firstLineIndex ? firstLineIndex - 1 : 0);
+			endBlock = removedEndIndex < lines.size() ? FindBlock(removedEndIndex) + 1 : blocks.size();
+		}
+
+		lines.erase(lines.begin() + firstLineIndex, lines.begin() + removedEndIndex);
+		lines.insert(lines.begin() + firstLineIndex, std::make_move_iterator(newLines.begin()), std::make_move_iterator(newLines.end()));
+		if (newLineCount != removedLineCount)
+			Renumber(firstBlock, endBlock, removedLineCount, newLineCount);
+
+		if (scopesChanged)
+			UpdateStructure();
+		else if (conditionalsChanged)
+			BalanceConditionals();
+		for (size_t i = firstLineIndex; i < firstLineIndex + newLineCount; i++)
+		{
+			DocumentLine& line = *lines[i];
+			if (!line.registered)
+				Register(line);
+			UpdateDiagnostics(line);
+		}
+
+		Invalidate();
+
+		bool conditionsChanged = scopesChanged || conditionalsEdited;
+		for (DocumentLine* line : staleConditions)
+		{
+			if (!line->conditionStale)
+				continue;
+			line->conditionStale = false;
+			int8_t condition = EvaluateCondition(*line);
+			conditionsChanged |= condition != line->condition;
+			line->condition = condition;
+		}
+		staleConditions.clear();
+
+		if (conditionsChanged)
+			UpdateInactiveRanges();
+		else if (newLineCount != removedLineCount)
+			ShiftInactiveRanges(firstLineIndex, removedLineCount, newLineCount);
+	}
+
+	void Document::GetDiagnostics(std::vector<AssemblerError>& errors, std::vector<AssemblerWarning>& warnings) const
+	{
+		PROFILE_FUNCTION();
+
+		for (const DocumentLine* line : diagnosticLines)
+		{
+			size_t lineIndex = Index(*line);
+			if (line->error)
+				errors.emplace_back(line->error, lineIndex);
+			else if (line->structureError)
+				errors.emplace_back(line->structureError, lineIndex);
+			for (AssemblerWarning::ID warning : line->warnings)
+				warnings.emplace_back(warning, lineIndex);
+		}
+	}
+
+	bool Document::FindSymbol(std::string_view name, size_t lineIndex, DocumentSymbol& outSymbol)
+	{
+		const std::string* definitionName = nullptr;
+		Definition* definition = Lookup(name, lineIndex < lines.size() ? lines[lineIndex]->scope : 0, &definitionName);
+		if (!definition)
+			return false;
+
+		outSymbol = MakeSymbol(*definitionName, *definition);
+		return true;
+	}
+
+	void Document::GetSymbols(std::vector<DocumentSymbol>& symbols)
+	{
+		PROFILE_FUNCTION();
+
+		for (auto& [name, nameDefinitions] : definitions)
+			for (Definition& definition : nameDefinitions)
+				symbols.push_back(MakeSymbol(name, definition));
+		std::sort(symbols.begin(), symbols.end(), [](const DocumentSymbol& left, const DocumentSymbol& right) { return left.lineIndex < right.lineIndex; });
+	}
+
+	void Document::Lex(DocumentLine& line)
+	{
+		std::string_view stripped = line.text;
+		if (AssemblerError::ID error = StripLine(stripped))
+			line.error = error;
+		else
+		{
+			std::vector<AssemblerWarning> warnings;
+			if (AssemblerError error = TokenizeLine(stripped, 0, line.tokens, line.statements, warnings))
+			{
+				line.error = error.id;
+				line.statements.clear();
+			}
+			for (const AssemblerWarning& warning : warnings)
+				line.warnings.push_back(warning.id);
+		}
+		line.kind = Classify(line);
+	}
+
+	size_t Document::FindBlock(size_t lineIndex) const noexcept
+	{
+		auto after = std::upper_bound(blocks.begin(), blocks.end(), lineIndex,
+			[](size_t index, const std::unique_ptr<DocumentBlock>& block) { return index < block->firstLineIndex; });
+		return static_cast<size_t>(after - blocks.begin()) - 1;
+	}
+
+	// Splits the lines that blocks [firstBlock, endBlock) held before the edit, which are all that moved within
+	// their block, into new blocks, and moves the blocks after them by how many lines were added or removed.
+	void Document::Renumber(size_t firstBlock, size_t endBlock, size_t removedLineCount, size_t newLineCount)
+	{
+		size_t startIndex = firstBlock < blocks.size() ? blocks[firstBlock]->firstLineIndex : 0;
+		size_t endIndex = endBlock < blocks.size() ? blocks[endBlock]->firstLineIndex + newLineCount - removedLineCount : lines.size();
+		size_t lineCount = endIndex - startIndex;
+		size_t blockCount = lineCount ? std::max<size_t>(lineCount / s_BlockSize, 1) : 0;
+
+		// Evenly, so that every block holds between s_BlockSize and twice that, unless there's only one.
+		std::vector<std::unique_ptr<DocumentBlock>> newBlocks(blockCount);
+		for (size_t blockIndex = 0; blockIndex < blockCount; blockIndex++)
+		{
+			DocumentBlock& block = *(newBlocks[blockIndex] = std::make_unique<DocumentBlock>());
+			block.firstLineIndex = startIndex + lineCount * blockIndex / blockCount;
+			size_t blockEndIndex = startIndex + lineCount * (blockIndex + 1) / blockCount;
+			for (size_t i = block.firstLineIndex; i < blockEndIndex; i++)
+			{
+				lines[i]->block = &block;
+				lines[i]->offset = i - block.firstLineIndex;
+			}
+		}
+
+		for (size_t blockIndex = endBlock; blockIndex < blocks.size(); blockIndex++)
+			blocks[blockIndex]->firstLineIndex += newLineCount - removedLineCount;
+
+		blocks.erase(blocks.begin() + firstBlock, blocks.begin() + endBlock);
+		blocks.insert(blocks.begin() + firstBlock, std::make_move_iterator(newBlocks.begin()), std::make_move_iterator(newBlocks.end()));
+	}
+
+	// Walks the structure the same way SourceScope does, and flags whatever doesn't balance.
+	void Document::UpdateStructure()
+	{
+		PROFILE_FUNCTION();
+
+		conditionals.clear();
+		std::vector<DocumentLine*> openNamespaces;
+		std::vector<DocumentLine*> openMacros;
+		std::vector<DocumentLine*> changedLines;
+		uint32_t scope = 0;
+
+		for (auto& linePointer : lines)
+		{
+			DocumentLine& line = *linePointer;
+			bool macroBody = !openMacros.empty();
+			AssemblerError::ID structureError = AssemblerError_None;
+
+			if (line.kind == DocumentLineKind_Macro)
+			{
+				macroBody = false;
+				openMacros.push_back(&line);
+			}
+			else if (line.kind == DocumentLineKind_EndMacro)
+			{
+				macroBody = false;
+				if (openMacros.empty())
+					structureError = AssemblerError_InvalidPreprocessorStatement;
+				else
+					openMacros.pop_back();
+			}
+			else if (!macroBody)
+			{
+				if (line.kind == DocumentLineKind_Namespace)
+				{
+					openNamespaces.push_back(&line);
+					scope = InternScope(scopes[scope] + std::string(line.Token(line.statements.back(), 1)) + '.');
+				}
+				else if (line.kind == DocumentLineKind_EndNamespace)
+				{
+					if (openNamespaces.empty())
+						structureError = AssemblerError_InvalidPreprocessorStatement;
+					else
+					{
+						openNamespaces.pop_back();
+						scope = openNamespaces.empty() ? 0 : openNamespaces.back()->scope;
+					}
+				}
+				else if (IsConditional(line.kind))
+				{
+					// Balanced by BalanceConditionals.
+					conditionals.push_back(&line);
+					structureError = line.structureError;
+				}
+			}
+
+			if (line.registered && (line.scope != scope || line.macroBody != macroBody))
+				Unregister(line);
+			line.scope = scope;
+			line.macroDepth = static_cast<uint32_t>(openMacros.size());
+			line.macroBody = macroBody;
+			if (!line.registered)
+				Register(line);
+
+			if (line.structureError != structureError)
+			{
+				line.structureError = structureError;
+				changedLines.push_back(&line);
+			}
+		}
+
+		// Whatever is still open at the end is missing its closing line.
+		for (const auto& openLines : { openNamespaces, openMacros })
+		{
+			for (DocumentLine* line : openLines)
+			{
+				line->structureError = AssemblerError_InvalidPreprocessorStatement;
+				changedLines.push_back(line);
+			}
+		}
+
+		for (DocumentLine* line : changedLines)
+			UpdateDiagnostics(*line);
+		BalanceConditionals();
+	}
+
+	// Flags #elif, #else and #endif lines without an #if, and #if lines without an #endif.
+	void Document::BalanceConditionals()
+	{
+		PROFILE_FUNCTION();
+
+		auto SetStructureError = [this](DocumentLine& line, AssemblerError::ID structureError)
+		{
+			if (line.structureError == structureError)
+				return;
+			line.structureError = structureError;
+			UpdateDiagnostics(line);
+		};
+
+		std::vector<DocumentLine*> openConditionals;
+		for (DocumentLine* line : conditionals)
+		{
+			if (line->kind == DocumentLineKind_If)
+				openConditionals.push_back(line);
+			else if (openConditionals.empty())
+				SetStructureError(*line, AssemblerError_InvalidPreprocessorStatement);
+			else
+			{
+				SetStructureError(*line, AssemblerError_None);
+				if (line->kind == DocumentLineKind_EndIf)
+				{
+					SetStructureError(*openConditionals.back(), AssemblerError_None);
+					openConditionals.pop_back();
+				}
+			}
+		}
+
+		for (DocumentLine* line : openConditionals)
+			SetStructureError(*line, AssemblerError_InvalidPreprocessorStatement);
+	}
+
+	uint32_t Document::InternScope(const std::string& prefix)
+	{
+		auto [it, inserted] = scopeIndices.try_emplace(prefix, static_cast<uint32_t>(scopes.size()));
+		if (inserted)
+			scopes.push_back(prefix);
+		return it->second;
+	}
+
+	void Document::Register(DocumentLine& line)
+	{
+		line.registered = true;
+		if (line.macroBody)
+			return;
+
+		auto Define = [&](std::string name, DocumentSymbolKind kind, std::string_view expression)
+		{
+			// Kept in line order, so that lookups find the first definition however the lines were edited.
+			std::vector<Definition>& nameDefinitions = definitions[name];
+			auto position = std::upper_bound(nameDefinitions.begin(), nameDefinitions.end(), Index(line),
+				[](size_t index, const Definition& definition) { return index < Index(*definition.line); });
+			nameDefinitions.insert(position, { &line, kind, expression });
+			changedNames.push_back(name);
+			line.definedNames.push_back(std::move(name));
+		};
+
+		auto Use = [&](std::string_view expression)
+		{
+			ForEachIdentifier(expression, [&](std::string_view identifier)
+			{
+				std::string_view key = LastPart(identifier);
+				if (std::find(line.usedNames.begin(), line.usedNames.end(), key) != line.usedNames.end())
+					return;
+				line.usedNames.emplace_back(key);
+				dependents[line.usedNames.back()].push_back(&line);
+			});
+		};
+
+		for (const TokenizedLineView& statement : line.statements)
+		{
+			std::string_view token0 = line.Token(statement, 0);
+			if (statement.tokenCount == 1 && token0.size() > 1 && token0.back() == ':')
+				Define(scopes[line.scope] + std::string(token0.substr(0, token0.size() - 1)), DocumentSymbolKind_Label, {});
+			else if (token0 == ".equ" && statement.tokenCount >= 3)
+			{
+				Define(std::string(line.Token(statement, 1)), DocumentSymbolKind_Equate, line.Token(statement, 2));
+				Use(line.Token(statement, 2));
+			}
+			else if (token0 == "#define" && statement.tokenCount >= 3)
+			{
+				Define(std::string(line.Token(statement, 1)), DocumentSymbolKind_Define, line.Token(statement, 2));
+				Use(line.Token(statement, 2));
+			}
+			else if (token0 == "#macro" && statement.tokenCount >= 2)
+				Define(std::string(line.Token(statement, 1)), DocumentSymbolKind_Macro, {});
+			else if ((token0 == "#if" || token0 == "#elif") && statement.tokenCount >= 2)
+			{
+				Use(line.Token(statement, 1));
+				line.conditionStale = true;
+				staleConditions.push_back(&line);
+			}
+		}
+	}
+
+	void Document::Unregister(DocumentLine& line)
+	{
+		for (std::string& name : line.definedNames)
+		{
+			auto found = definitions.find(name);
+			std::erase_if(found->second, [&line](const Definition& definition) { return definition.line == &line; });
+			if (found->second.empty())
+				definitions.erase(found);
+			changedNames.push_back(std::move(name));
+		}
+		line.definedNames.clear();
+
+		for (const std::string& name : line.usedNames)
+		{
+			auto found = dependents.find(name);
+			std::erase(found->second, &line);
+			if (found->second.empty())
+				dependents.erase(found);
+		}
+		line.usedNames.clear();
+
+		line.conditionStale = false;
+		line.registered = false;
+	}
+
+	void Document::UpdateDiagnostics(DocumentLine& line)
+	{
+		if (line.error || line.structureError || !line.warnings.empty())
+			diagnosticLines.insert(&line);
+		else
+			diagnosticLines.erase(&line);
+	}
+
+	// Forgets the values of everything that depends on a changed name, directly or through other equates,
+	// and queues the conditionals among them to be evaluated again.
+	void Document::Invalidate()
+	{
+		std::vector<std::string> worklist = std::move(changedNames);
+		changedNames.clear();
+		std::unordered_set<std::string> visitedKeys;
+
+		while (!worklist.empty())
+		{
+			std::string name = std::move(worklist.back());
+			worklist.pop_back();
+
+			auto found = dependents.find(std::string(LastPart(name)));
+			if (found == dependents.end() || !visitedKeys.insert(found->first).second)
+				continue;
+
+			for (DocumentLine* line : found->second)
+			{
+				if ((line->kind == DocumentLineKind_If || line->kind == DocumentLineKind_Elif) && !line->conditionStale)
+				{
+					line->conditionStale = true;
+					staleConditions.push_back(line);
+				}
+
+				for (const std::string& definedName : line->definedNames)
+				{
+					for (Definition& definition : definitions[definedName])
+					{
+						if (definition.line == line && definition.state != EquateState_Unevaluated)
+						{
+							definition.state = EquateState_Unevaluated;
+							worklist.push_back(definedName);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Conditions that can't be evaluated, like ones using symbols from includes, keep every branch active.
+	void Document::UpdateInactiveRanges()
+	{
+		PROFILE_FUNCTION();
+
+		struct Branch
+		{
+			bool parentActive = true;
+			bool taken = false;
+		};
+		std::vector<Branch> branches;
+
+		inactiveRanges.clear();
+		bool active = true;
+		size_t inactiveStart = 0;
+		auto SetActive = [&](bool nowActive, const DocumentLine& line)
+		{
+			if (active && !nowActive)
+				inactiveStart = Index(line) + 1;
+			else if (!active && nowActive)
+				inactiveRanges.push_back({ inactiveStart, Index(line) - inactiveStart });
+			active = nowActive;
+		};
+
+		for (const DocumentLine* line : conditionals)
+		{
+			// Unclosed #if lines still start a branch, but lines that close nothing don't.
+			if (line->structureError && line->kind != DocumentLineKind_If)
+				continue;
+
+			switch (line->kind)
+			{
+				case DocumentLineKind_If:
+				{
+					branches.push_back({ active, line->condition == 1 });
+					SetActive(active && line->condition != 0, *line);
+					break;
+				}
+				case DocumentLineKind_Elif:
+				{
+					Branch& branch = branches.back();
+					SetActive(branch.parentActive && !branch.taken && line->condition != 0, *line);
+					branch.taken |= line->condition == 1;
+					break;
+				}
+				case DocumentLineKind_Else:
+				{
+					Branch& branch = branches.back();
+					SetActive(branch.parentActive && !branch.taken, *line);
+					branch.taken = true;
+					break;
+				}
+				case DocumentLineKind_EndIf:
+				{
+					SetActive(branches.back().parentActive, *line);
+					branches.pop_back();
+					break;
+				}
+			}
+		}
+
+		if (!active)
+			inactiveRanges.push_back({ inactiveStart, lines.size() - inactiveStart });
+	}
+
+	// For edits that add or remove no conditionals, and so lie within a single range or between two.
+	void Document::ShiftInactiveRanges(size_t firstLineIndex, size_t removedLineCount, size_t newLineCount)
+	{
+		for (DocumentLineRange& range : inactiveRanges)
+		{
+			if (firstLineIndex < range.firstLineIndex)
+				range.firstLineIndex += newLineCount - removedLineCount;
+			else if (firstLineIndex <= range.firstLineIndex + range.lineCount)
+				range.lineCount += newLineCount - removedLineCount;
+		}
+	}
+
+	// Like the rest of the assembler, names are looked up in the enclosing namespace first, then globally.
+	Document::Definition* Document::Lookup(std::string_view name, uint32_t scope, const std::string** outName)
+	{
+		auto found = definitions.end();
+		if (scope != 0)
+			found = definitions.find(scopes[scope] + std::string(name));
+		if (found == definitions.end())
+			found = definitions.find(std::string(name));
+		if (found == definitions.end())
+			return nullptr;
+
+		if (outName)
+			*outName = &found->first;
+		return &found->second.front();
+	}
+
+	bool Document::Evaluate(Definition& definition, int64_t& outValue)
+	{
+		// Left unevaluated, so that it can still be evaluated from closer to it.
+		if (definition.state == EquateState_Unevaluated && evaluationDepth == s_MaxEvaluationDepth)
+			return false;
+
+		evaluationDepth++;
+		uint32_t scope = definition.line->scope;
+		bool known = EvaluateEquate(definition.expression, [this, scope](std::string_view identifier, int64_t& identifierValue)
+		{
+			Definition* found = Lookup(identifier, scope);
+			return found && Evaluate(*found, identifierValue);
+		}, definition.state, definition.value);
+		evaluationDepth--;
+
+		outValue = definition.value;
+		return known;
+	}
+
+	int8_t Document::EvaluateCondition(const DocumentLine& line)
+	{
+		const TokenizedLineView& statement = line.statements.back();
+		if (statement.tokenCount < 2)
+			return -1;
+
+		int64_t value = 0;
+		bool known = EvaluateExpression(line.Token(statement, 1), [this, scope = line.scope](std::string_view identifier, int64_t& outValue)
+		{
+			Definition* found = Lookup(identifier, scope);
+			return found && Evaluate(*found, outValue);
+		}, value);
+		return known ? value != 0 : -1;
+	}
+
+	DocumentSymbol Document::MakeSymbol(const std::string& name, Definition& definition)
+	{
+		DocumentSymbol symbol;
+		symbol.name = name;
+		symbol.kind = definition.kind;
+		symbol.lineIndex = Index(*definition.line);
+		symbol.hasValue = Evaluate(definition, symbol.value);
+		return symbol;
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "EZ80Assembler.h"
+#include "Expression.h"
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ez80
+{
+	enum DocumentSymbolKind_ : uint8_t
+	{
+		DocumentSymbolKind_Label = 0,
+		DocumentSymbolKind_Equate,
+		DocumentSymbolKind_Define,
+		DocumentSymbolKind_Macro,
+	};
+	using DocumentSymbolKind = std::underlying_type_t<DocumentSymbolKind_>;
+
+	struct DocumentSymbol
+	{
+		std::string_view name; // Labels are fully qualified. Only valid until the next edit.
+		DocumentSymbolKind kind = DocumentSymbolKind_Label;
+		size_t lineIndex = 0;
+		bool hasValue = false; // Equates and defines whose value could be evaluated.
+		int64_t value = 0;
+	};
+
+	// Lines inside an #if, #elif or #else branch that isn't taken.
+	struct DocumentLineRange
+	{
+		size_t firstLineIndex = 0;
+		size_t lineCount = 0;
+	};
+
+	struct DocumentLine;
+	struct DocumentBlock;
+
+	// An editor's view of one source file, kept stripped and tokenized line by line between edits.
+	// An edit re-lexes only the lines it replaces, and re-evaluates only the equates and conditionals
+	// that depend on the symbols it defined or removed. Lines are numbered through blocks of a few hundred,
+	// so inserting or removing lines renumbers a block or two and moves every block after them.
+	// Adding or removing #namespace or #macro lines walks every line, and adding or removing #if structure,
+	// or changing what a condition evaluates to, walks every conditional.
+	class Document
+	{
+	public:
+		Document();
+		~Document();
+
+		Document(const Document&) = delete;
+		Document& operator=(const Document&) = delete;
+
+		// Replaces removedLineCount lines, starting at firstLineIndex, with text split at its newlines.
+		// Empty text only removes lines.
+		void Edit(size_t firstLineIndex, size_t removedLineCount, std::string_view text);
+		void SetText(std::string_view text) { Edit(0, lines.size(), text); }
+
+		size_t LineCount() const noexcept { return lines.size(); }
+
+		// Every line's first error and its warnings, in line order. Unlike Assemble, errors don't stop the lines after them.
+		void GetDiagnostics(std::vector<AssemblerError>& errors, std::vector<AssemblerWarning>& warnings) const;
+		const std::vector<DocumentLineRange>& InactiveRanges() const noexcept { return inactiveRanges; }
+
+		// Looks name up as it would be resolved on the given line, so names inside a namespace find its own labels first.
+		bool FindSymbol(std::string_view name, size_t lineIndex, DocumentSymbol& outSymbol);
+		void GetSymbols(std::vector<DocumentSymbol>& symbols);
+	private:
+		// Orders lines by their current index, which edits to other lines never reorder.
+		struct LineOrder
+		{
+			bool operator()(const DocumentLine* left, const DocumentLine* right) const noexcept;
+		};
+
+		struct Definition
+		{
+			DocumentLine* line = nullptr;
+			DocumentSymbolKind kind = DocumentSymbolKind_Label;
+			std::string_view expression; // Of equates and defines.
+			EquateState state = EquateState_Unevaluated;
+			int64_t value = 0;
+		};
+
+		void Lex(DocumentLine& line);
+		size_t FindBlock(size_t lineIndex) const noexcept;
+		void Renumber(size_t firstBlock, size_t endBlock, size_t removedLineCount, size_t newLineCount);
+		void ShiftInactiveRanges(size_t firstLineIndex, size_t removedLineCount, size_t newLineCount);
+		void UpdateStructure();
+		void BalanceConditionals();
+		uint32_t InternScope(const std::string& prefix);
+		void Register(DocumentLine& line);
+		void Unregister(DocumentLine& line);
+		void UpdateDiagnostics(DocumentLine& line);
+		void Invalidate();
+		void UpdateInactiveRanges();
+
+		Definition* Lookup(std::string_view name, uint32_t scope, const std::string** outName = nullptr);
+		bool Evaluate(Definition& definition, int64_t& outValue);
+		int8_t EvaluateCondition(const DocumentLine& line);
+		DocumentSymbol MakeSymbol(const std::string& name, Definition& definition);
+
+		std::vector<std::unique_ptr<DocumentLine>> lines;
+		std::vector<std::unique_ptr<DocumentBlock>> blocks; // In line order, each covering the lines up to the next one's.
+		std::vector<std::string> scopes; // Namespace prefixes, each followed by a dot. The first is the global one.
+		std::unordered_map<std::string, uint32_t> scopeIndices;
+
+		std::unordered_map<std::string, std::vector<Definition>> definitions; // By name, several if it's defined more than once.
+		std::unordered_map<std::string, std::vector<DocumentLine*>> dependents; // Equates, defines and conditionals, by the last part of each name they use.
+		std::vector<std::string> changedNames; // Definitions added or removed since the last Invalidate.
+
+		std::vector<DocumentLine*> conditionals; // #if, #elif, #else and #endif outside macros, in line order, balanced or not.
+		std::vector<DocumentLine*> staleConditions; // #if and #elif lines to evaluate again.
+		std::set<DocumentLine*, LineOrder> diagnosticLines;
+		std::vector<DocumentLineRange> inactiveRanges;
+		uint32_t evaluationDepth = 0; // Of Evaluate recursing through equates defined in terms of others.
+	};
+}
@@ -1,56 +1,59 @@
 #include "EZ80Assembler.h"
+#include "AssemblerTypes.h"
 #include "AssemblerStringUtil.h"
+#include "BranchRelaxation.h"
+#include "Compression.h"
+#include "ConstantData.h"
+#include "CycleReport.h"
+#include "DeadCode.h"
+#include "Expression.h"
+#include "Listing.h"
+#include "PhaseStats.h"
+#include "ObjectFile.h"
+#include "Peephole.h"
+#include "PlatformSymbols.h"
+#include "ProfileLayout.h"
+#include "Simulator.h"
+#include "SourceScope.h"
 #include "Debug.h"
+#include "Profile.h"
 #include <sstream>
 #include <fstream>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace ez80
 {
-	struct TokenizedLine
-	{
-		using Iterator = std::vector<std::string_view>::iterator;
-
-		constexpr TokenizedLine(std::vector<std::string_view>& tokens, size_t start, size_t tokenCount, size_t number) noexcept
-			: tokenCount(tokenCount), number(number), beginIt(tokens.begin() + start), endIt(tokens.begin() + (start + tokenCount)) {}
-
-		constexpr std::string_view operator[](size_t index) const noexcept { return *(beginIt + index); }
-		constexpr Iterator begin() noexcept { return beginIt; }
-		constexpr Iterator end() noexcept { return endIt; }
-
-		size_t tokenCount = 0;
-		bool handled = false; // For deferred removal.
-		size_t number = 0;
-	private:
-		Iterator beginIt;
-		Iterator endIt;
-	};
-
-	struct Equate
-	{
-		std::string_view identifier;
-		std::string_view value;
-		uint32_t expandedValue : 24 = 0;
-		bool expanded = false;
-	};
-
-	bool IsOutputFilepathValid(const std::filesystem::path& filepath, std::string_view& outputName);
+	// Checks for a .8x? extension ending in extensionLetter.
+	bool IsOutputFilepathValid(const std::filesystem::path& filepath, wchar_t extensionLetter, std::string_view& outputName);
 	// NOTE: required that all of validExtension is lowercase.
 	bool IsExtensionValid(const std::filesystem::path& filepath, std::wstring_view validExtension);
 	bool IsASMFile(const std::filesystem::path& filepath);
 	bool IsINCFile(const std::filesystem::path& filepath);
 
-	bool ReadFile(const std::filesystem::path& filepath, std::string& fileContents, std::vector<std::string_view>& lines);
-	AssemblerError::ID WriteFile(const std::filesystem::path& filepath, std::string_view outputName, const std::vector<uint8_t>& assembly);
-
-	AssemblerError StripWhitespace(std::vector<std::string_view>& lines);
-	AssemblerError Tokenize(AssemblerResult& result, const std::vector<std::string_view>& lines, std::vector<std::string_view>& tokens, std::vector<TokenizedLine>& tokenizedLines);
-	void CullHandledTokenizedLines(std::vector<TokenizedLine>& tokenizedLines);
-	void FindEquates(const std::vector<std::string_view>& tokens, std::vector<TokenizedLine>& tokenizedLines, std::vector<Equate>& equates);
-
-	AssemblerResult Assemble(const AssemblerInfo& info)
+	bool ReadFile(const std::filesystem::path& filepath, std::pmr::string& fileContents, std::pmr::vector<std::string_view>& lines);
+	AssemblerError::ID WriteFile(const std::filesystem::path& filepath, std::string_view outputName, uint8_t variableType, const std::vector<uint8_t>& assembly);
+
+	AssemblerError StripWhitespace(std::pmr::vector<std::string_view>& lines, size_t maxLineLength);
+	AssemblerError::ID StripLine(std::string_view& line);
+	AssemblerError Tokenize(const std::pmr::vector<std::string_view>& lines, std::pmr::vector<std::string_view>& tokens, std::pmr::vector<TokenizedLineView>& tokenizedLineViews, std::vector<AssemblerWarning>& warnings);
+	// Once the tokens are done growing, their iterators stay valid.
+	void MakeTokenizedLines(std::pmr::vector<std::string_view>& tokens, const std::pmr::vector<TokenizedLineView>& tokenizedLineViews, std::pmr::vector<TokenizedLine>& tokenizedLines);
+	// Appends one stripped line's tokens, and a view of them for each statement on it, since labels are statements of their own.
+	AssemblerError TokenizeLine(std::string_view line, size_t lineNumber, std::pmr::vector<std::string_view>& tokens, std::pmr::vector<TokenizedLineView>& tokenizedLineViews, std::vector<AssemblerWarning>& warnings);
+	void CullHandledTokenizedLines(std::pmr::vector<TokenizedLine>& tokenizedLines);
+	void FindEquates(const std::pmr::vector<std::string_view>& tokens, std::pmr::vector<TokenizedLine>& tokenizedLines, std::pmr::vector<Equate>& equates);
+	// Marks every #include of the platform include as handled, and returns whether there were any.
+	bool FindPlatformIncludes(std::pmr::vector<TokenizedLine>& tokenizedLines);
+	// Evaluating an equate recurses through the ones it uses, so chains deeper than maxDepth are an error.
+	AssemblerError CheckEquateDepth(const std::pmr::vector<Equate>& equates, uint32_t maxDepth);
+	// Warns once about each name an equate uses that isn't an equate, a label or in the built-in platform table,
+	// since the table is only part of the platform include and evaluating with such a name fails without saying why.
+	void CheckPlatformSymbols(const std::pmr::vector<TokenizedLine>& tokenizedLines, const std::pmr::vector<Equate>& equates, std::vector<AssemblerWarning>& warnings);
+
+	// Everything Assemble does, split out so that the phases end before the result is returned.
+	static AssemblerResult& RunPipeline(const AssemblerInfo& info, AssemblerResult& result, PhaseRecorder& phases)
 	{
-		AssemblerResult result;
-
 		if (std::error_code error; !std::filesystem::exists(info.inputFilepath, error) || error)
 			return result.Error(AssemblerError_MissingInputFile);
 
@@ -58,27 +61,117 @@ namespace ez80
 			return result.Error(AssemblerError_InvalidInputFileExtension);
 
 		std::string_view outputName;
-		if (!IsOutputFilepathValid(info.outputFilepath, outputName))
+		if (info.objectFilepath.empty() && !IsOutputFilepathValid(info.outputFilepath, L'p', outputName))
 			return result.Error(AssemblerError_OutputFileNameInvalid);
 
-		std::string contents;
-		std::vector<std::string_view> lines;
-		if (!ReadFile(info.inputFilepath, contents, lines))
-			return result.Error(AssemblerError_FailedToReadInputFile);
+		// Everything from here on only lives until Assemble returns. Without an arena from the host, it's pooled over the
+		// default resource, which reuses what's freed as the vectors grow, and frees the names that never are on return.
+		std::pmr::unsynchronized_pool_resource localPool(std::pmr::get_default_resource());
+		std::pmr::memory_resource* arena = info.memoryResource ? info.memoryResource : &localPool;
+
+		std::pmr::string contents(arena);
+		std::pmr::vector<std::string_view> lines(arena);
+		std::pmr::vector<std::string_view> sourceLines(arena); // Stripping loses the comments, which the listing shows.
+		std::pmr::vector<std::string_view> tokens(arena);
+		std::pmr::vector<TokenizedLine> tokenizedLines(arena);
+		size_t lineCount = 0;
+		if (const ParsedSource* parsedInput = info.parsedInput)
+		{
+			// The later phases rewrite tokens, so only they are copied, and the contents they point into are shared.
+			phases.Begin("CopyParsedInput");
+			result.warnings = parsedInput->warnings;
+			if (parsedInput->error)
+				return result.Error(parsedInput->error);
+
+			lineCount = parsedInput->sourceLines.size();
+			if (!info.listingFilepath.empty())
+				sourceLines = parsedInput->sourceLines;
+			tokens = parsedInput->tokens;
+			MakeTokenizedLines(tokens, parsedInput->tokenizedLineViews, tokenizedLines);
+		}
+		else
+		{
+			phases.Begin("ReadFile");
+			if (!ReadFile(info.inputFilepath, contents, lines))
+				return result.Error(AssemblerError_FailedToReadInputFile);
+
+			lineCount = lines.size();
+			if (!info.listingFilepath.empty())
+				sourceLines = lines;
+
+			phases.Begin("StripWhitespace");
+			if (auto error = StripWhitespace(lines, info.limits.maxLineLength))
+				return result.Error(error);
+
+			// Tokenize
+			phases.Begin("Tokenize");
+			std::pmr::vector<TokenizedLineView> tokenizedLineViews(arena);
+			if (auto error = Tokenize(lines, tokens, tokenizedLineViews, result.warnings))
+				return result.Error(error);
+			MakeTokenizedLines(tokens, tokenizedLineViews, tokenizedLines);
+		}
 
-		if (auto error = StripWhitespace(lines))
+		// Find equates, after the defines, which come before every line.
+		phases.Begin("FindEquates");
+		std::pmr::vector<Equate> equates(arena);
+		for (const AssemblerDefine& define : info.defines)
+			equates.emplace_back(define.name, define.value);
+		FindEquates(tokens, tokenizedLines, equates);
+		bool platformSymbols = info.builtinPlatformInclude && FindPlatformIncludes(tokenizedLines);
+		CullHandledTokenizedLines(tokenizedLines);
+		if (auto error = CheckEquateDepth(equates, info.limits.maxEquateDepth))
 			return result.Error(error);
+		if (platformSymbols)
+			CheckPlatformSymbols(tokenizedLines, equates, result.warnings);
 
-		// Tokenize
-		std::vector<std::string_view> tokens;
-		std::vector<TokenizedLine> tokenizedLines;
-		if (auto error = Tokenize(result, lines, tokens, tokenizedLines))
-			return result.Error(error);
+		if (info.eliminateDeadCode)
+		{
+			phases.Begin("EliminateDeadCode");
+			EliminateDeadCode(tokenizedLines, equates, info.exportedSymbols, result.removals, result.warnings);
+			CullHandledTokenizedLines(tokenizedLines);
+		}
 
-		// Find equates.
-		std::vector<Equate> equates;
-		FindEquates(tokens, tokenizedLines, equates);
-		CullHandledTokenizedLines(tokenizedLines);
+		if (info.mergeConstantData)
+		{
+			phases.Begin("MergeConstantData");
+			MergeConstantData(tokenizedLines, equates, info.exportedSymbols, platformSymbols, result.rewrites);
+			CullHandledTokenizedLines(tokenizedLines);
+		}
+
+		if (info.optimizePeephole)
+		{
+			phases.Begin("OptimizePeephole");
+			OptimizePeephole(tokenizedLines, result.rewrites);
+			CullHandledTokenizedLines(tokenizedLines);
+		}
+
+		if (!info.layoutProfileFilepath.empty())
+		{
+			phases.Begin("OrderRoutinesByProfile");
+			std::vector<ExecutionCount> executionCounts;
+			if (!ReadExecutionProfile(info.layoutProfileFilepath, executionCounts))
+				return result.Error(AssemblerError_FailedToReadLayoutProfile);
+			EquateResolver resolver(equates, [platformSymbols](std::string_view identifier, int64_t& outValue)
+			{
+				return platformSymbols && FindPlatformSymbol(identifier, outValue);
+			});
+			result.layoutCyclesSaved = OrderRoutinesByProfile(tokenizedLines, executionCounts, ProgramOrigin, resolver.Resolver(), info.relaxBranches);
+		}
+
+		if (info.relaxBranches)
+		{
+			phases.Begin("RelaxBranches");
+			RelaxBranches(tokenizedLines, AssemblyMode_ADL, result.rewrites);
+		}
+
+		if (!info.cycleReportFilepath.empty())
+		{
+			phases.Begin("CycleReport");
+			std::vector<CycleReportEntry> cycleReportEntries;
+			BuildCycleReport(tokenizedLines, cycleReportEntries);
+			if (!WriteCycleReport(info.cycleReportFilepath, cycleReportEntries))
+				return result.Error(AssemblerError_FailedToWriteCycleReport);
+		}
 
 		// This is where the split is from inc and asm files.
 		// TODO:
@@ -103,23 +196,111 @@ namespace ez80
 		//	5) #assert's
 		//	6) $ meaning address of current byte
 
+		phases.Begin("Encode");
 		std::vector<uint8_t> assembly;
 
-		// TODO: generate byte code.
+		{
+			PROFILE_SCOPE("Encode");
+
+			// TODO: generate byte code.
+		}
+
+		if (assembly.size() > info.limits.maxOutputSize)
+			return result.Error(AssemblerError_AssemblyTooLarge);
+
+		// Where every line and label ends up, for the listing and the profile. Until encoding is implemented,
+		// that's worked out from instruction sizes rather than taken from the encoder.
+		Layout layout;
+		if (!info.listingFilepath.empty() || (!info.profileFilepath.empty() && !assembly.empty()))
+		{
+			phases.Begin("BuildLayout");
+			EquateResolver resolver(equates, [platformSymbols](std::string_view identifier, int64_t& outValue)
+			{
+				return platformSymbols && FindPlatformSymbol(identifier, outValue);
+			});
+			BuildLayout(tokenizedLines, AssemblyMode_ADL, ProgramOrigin, resolver.Resolver(), layout);
+			for (size_t lineNumber : layout.unresolvedOrigins)
+				result.warnings.emplace_back(AssemblerWarning_OriginNotEvaluated, lineNumber);
+		}
+
+		if (!info.listingFilepath.empty())
+		{
+			phases.Begin("WriteListing");
+			std::filesystem::path listingFilepath = info.listingFilepath;
+			std::filesystem::path symbolMapFilepath = info.listingFilepath;
+			listingFilepath.replace_extension(".lst");
+			symbolMapFilepath.replace_extension(".map");
+			if (!WriteListing(listingFilepath, sourceLines, layout, assembly) || !WriteSymbolMap(symbolMapFilepath, layout, equates, platformSymbols))
+				return result.Error(AssemblerError_FailedToWriteListing);
+		}
+
+		if (!info.objectFilepath.empty())
+		{
+			// Only the first object of a program needs to start with EF 7B, and only Link can tell which that is.
+			// Without byte code the object would have neither bytes nor relocations, so don't pretend it was written.
+			if (assembly.empty())
+				return result.Error(AssemblerError_AssemblyEmpty);
+
+			phases.Begin("WriteObjectFile");
+			ObjectFile objectFile;
+			std::vector<size_t> unresolvedOrigins;
+			EquateResolver resolver(equates, [platformSymbols](std::string_view identifier, int64_t& outValue)
+			{
+				return platformSymbols && FindPlatformSymbol(identifier, outValue);
+			});
+			BuildObjectFile(tokenizedLines, assembly, resolver.Resolver(), objectFile, unresolvedOrigins);
+			if (layout.lines.empty() && layout.unresolvedOrigins.empty()) // Otherwise BuildLayout already warned about them.
+				for (size_t lineNumber : unresolvedOrigins)
+					result.warnings.emplace_back(AssemblerWarning_OriginNotEvaluated, lineNumber);
+			if (!WriteObjectFile(info.objectFilepath, objectFile))
+				return result.Error(AssemblerError_FailedToWriteObjectFile);
+			return result;
+		}
 
 		if (assembly.size() < 2 || (assembly.front() != 0xEF && assembly[1] != 0x7B))
 			result.warnings.emplace_back(AssemblerWarning_AssemblyDoesntStartWithEF_7B);
 
-		if (auto error = WriteFile(info.outputFilepath, outputName, assembly))
-			return result.Error({ error, lines.size() });
+		if (!info.profileFilepath.empty() && !assembly.empty())
+		{
+			phases.Begin("Simulate");
+			SimulatorInfo simulatorInfo;
+			simulatorInfo.maxCycles = info.profileMaxCycles;
+			SimulatorProfile profile;
+			Simulate(assembly, simulatorInfo, profile);
+			if (!WriteSimulatorProfile(info.profileFilepath, profile, simulatorInfo, layout))
+				return result.Error(AssemblerError_FailedToWriteProfile);
+		}
+
+		if (info.compressOutput)
+		{
+			phases.Begin("CompressProgramImage");
+			CompressProgramImage(assembly);
+		}
+
+		phases.Begin("WriteFile");
+		if (auto error = WriteFile(info.outputFilepath, outputName, ProtectedProgramType, assembly))
+			return result.Error({ error, lineCount });
 
 		return result;
 	}
 
-	bool IsOutputFilepathValid(const std::filesystem::path& filepath, std::string_view& outputName)
+	AssemblerResult Assemble(const AssemblerInfo& info)
+	{
+		PROFILE_FUNCTION();
+
+		AssemblerResult result;
+		{
+			PhaseRecorder phases(info.collectStats ? &result.stats : nullptr, "Assemble");
+			RunPipeline(info, result, phases);
+		}
+		return result;
+	}
+
+	bool IsOutputFilepathValid(const std::filesystem::path& filepath, wchar_t extensionLetter, std::string_view& outputName)
 	{
 		// Get the filename.
-		std::wstring_view filename = std::filesystem::_Parse_filename(filepath.native());
+		std::wstring filenameString = filepath.filename().wstring();
+		std::wstring_view filename = filenameString;
 
 		// Find the dot.
 		size_t dotIndex = filename.find(L'.');
@@ -132,7 +313,7 @@ namespace ez80
 		std::wstring_view extension = filename.substr(dotIndex + 1, 3);
 
 		// If the extension is invalid, so too is the filepath.
-		if (extension.front() != L'8' || util::string::ToLower(extension[1]) != L'x' || util::string::ToLower(extension.back()) != L'p')
+		if (extension.front() != L'8' || util::string::ToLower(extension[1]) != L'x' || util::string::ToLower(extension.back()) != extensionLetter)
 			return false;
 
 		// Get the name.
@@ -149,8 +330,8 @@ namespace ez80
 			if (!util::string::IsAlphanumeric(name[i]))
 				return false;
 
-		// Filepath is valid, so convert the name.
-		static char outputNameBuffer[8];
+		// Filepath is valid, so convert the name. Programs may be linked and assembled on many threads at once.
+		thread_local char outputNameBuffer[8];
 		for (uint8_t i = 0; i < 8; i++)
 			outputNameBuffer[i] = i < static_cast<uint8_t>(name.size()) ? static_cast<char>(name[i]) : '\0';
 		outputName = std::string_view(outputNameBuffer, 8);
@@ -160,7 +341,8 @@ namespace ez80
 	bool IsExtensionValid(const std::filesystem::path& filepath, std::wstring_view validExtension)
 	{
 		// Get the filename.
-		std::wstring_view filename = std::filesystem::_Parse_filename(filepath.native());
+		std::wstring filenameString = filepath.filename().wstring();
+		std::wstring_view filename = filenameString;
 
 		// Find the dot.
 		size_t dotIndex = filename.find(L'.');
@@ -189,8 +371,10 @@ namespace ez80
 		return IsExtensionValid(filepath, L"inc");
 	}
 
-	bool ReadFile(const std::filesystem::path& filepath, std::string& contents, std::vector<std::string_view>& lines)
+	bool ReadFile(const std::filesystem::path& filepath, std::pmr::string& contents, std::pmr::vector<std::string_view>& lines)
 	{
+		PROFILE_FUNCTION();
+
 		std::ifstream file(filepath, std::ios::ate | std::ios::binary);
 		if (!file.is_open())
 			return false;
@@ -245,8 +429,10 @@ namespace ez80
 		return true;
 	}
 
-	AssemblerError::ID WriteFile(const std::filesystem::path& filepath, std::string_view outputName, const std::vector<uint8_t>& assembly)
+	AssemblerError::ID WriteFile(const std::filesystem::path& filepath, std::string_view outputName, uint8_t variableType, const std::vector<uint8_t>& assembly)
 	{
+		PROFILE_FUNCTION();
+
 		// This function would not be possible without https://www.ticalc.org/archives/files/fileinfo/247/24750.html.
 
 		constexpr uint16_t dataSectionHeaderSize = (2 + 2 + 1 + 8 + 1 + 1 + 2) + 2;
@@ -290,7 +476,7 @@ namespace ez80
 		Write(0x000D, true);
 		uint16_t variable0Size = static_cast<uint16_t>(assembly.size()) + 2;
 		Write(variable0Size, true);
-		WriteData(0x06);
+		WriteData(variableType);
 		file.write(outputName.data(), 8);
 		file.write("\0", 2);
 		Write(variable0Size, true);
@@ -307,291 +493,322 @@ namespace ez80
 		return AssemblerError_None;
 	}
 
-	AssemblerError StripWhitespace(std::vector<std::string_view>& lines)
+	AssemblerError StripWhitespace(std::pmr::vector<std::string_view>& lines, size_t maxLineLength)
 	{
+		PROFILE_FUNCTION();
+
 		for (size_t lineNumber = 0; lineNumber < lines.size(); lineNumber++)
 		{
-			std::string_view& line = lines[lineNumber];
+			if (lines[lineNumber].size() > maxLineLength)
+				return { AssemblerError_LineTooLong, lineNumber };
+			if (auto error = StripLine(lines[lineNumber]))
+				return { error, lineNumber };
+		}
 
-			if (!line.empty())
-			{
-				size_t lineEnd = 0;
-				if (char c = line.front(); !util::string::FindFirstOfPastQuote(line, lineEnd, c, [](char c) noexcept { return c == ';'; }))
-					return { AssemblerError_InvalidStringLiteral, lineNumber };
+		return AssemblerError_None;
+	}
 
-				size_t lineStart = line.find_first_not_of(" \t\f\v");
-				if (lineStart != lineEnd && lineEnd <= line.size())
+	AssemblerError::ID StripLine(std::string_view& line)
+	{
+		if (!line.empty())
+		{
+			size_t lineEnd = 0;
+			if (char c = line.front(); !util::string::FindFirstOfPastQuote(line, lineEnd, c, [](char c) noexcept { return c == ';'; }))
+				return AssemblerError_InvalidStringLiteral;
+
+			size_t lineStart = line.find_first_not_of(" \t\f\v");
+			if (lineStart < lineEnd && lineEnd <= line.size())
+			{
+				line = line.substr(lineStart, lineEnd - lineStart);
+				if (!line.empty())
 				{
-					line = line.substr(lineStart, lineEnd - lineStart);
-					if (!line.empty())
-					{
-						lineEnd = line.size();
-						while (lineEnd > 0 && util::string::IsSpace(line[--lineEnd]));
-						line = line.substr(0, lineEnd + 1);
-					}
+					lineEnd = line.size();
+					while (lineEnd > 0 && util::string::IsSpace(line[--lineEnd]));
+					line = line.substr(0, lineEnd + 1);
 				}
-				else if (!line.empty())
-					line = {};
 			}
+			else if (!line.empty())
+				line = {};
 		}
 
 		return AssemblerError_None;
 	}
 
-	AssemblerError Tokenize(AssemblerResult& result, const std::vector<std::string_view>& lines, std::vector<std::string_view>& tokens, std::vector<TokenizedLine>& tokenizedLines)
+	AssemblerError TokenizeLine(std::string_view line, size_t lineNumber, std::pmr::vector<std::string_view>& tokens, std::pmr::vector<TokenizedLineView>& tokenizedLineViews, std::vector<AssemblerWarning>& warnings)
 	{
-		struct TokenizedLineView
-		{
-			size_t start = 0; // Start index into tokens
-			size_t tokenCount = 0; // Number of tokens in this line
-			size_t lineNumber = 0;
-		};
-		std::vector<TokenizedLineView> tokenizedLineViews;
+		size_t tokenStartIndex = tokens.size();
 
-		for (size_t lineNumber = 0; lineNumber < lines.size(); lineNumber++)
+		if (!line.empty())
 		{
-			std::string_view line = lines[lineNumber];
-			size_t tokenStartIndex = tokens.size();
+			size_t i = 0;
+			char c = line.front();
 
-			if (!line.empty())
+			util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
+			std::string_view token0 = line.substr(0, i);
+			tokens.push_back(token0);
+
+			while (i < line.size() && token0.back() == ':')
 			{
-				size_t i = 0;
-				char c = line.front();
+				tokenizedLineViews.emplace_back(tokenStartIndex++, 1, lineNumber);
+				util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
 
-				util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-				std::string_view token0 = line.substr(0, i);
-				tokens.push_back(token0);
+				if (i < line.size())
+				{
+					size_t tokenStart = i;
+					util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
+					token0 = line.substr(tokenStart, i - tokenStart);
+					tokens.push_back(token0);
+				}
+			}
 
-				while (i < line.size() && token0.back() == ':')
+			if (i < line.size())
+			{
+				if (token0.starts_with('#'))
 				{
-					tokenizedLineViews.emplace_back(tokenStartIndex++, 1, lineNumber);
-					util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+					std::string_view directive = token0.substr(1);
+					if (directive == "include")
+					{
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
 
-					if (i < line.size())
+						// Defer string literal expansion.
+						tokens.push_back(line.substr(i, line.size()));
+					}
+					else if (directive == "define")
 					{
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+
+						// Get identifier.
 						size_t tokenStart = i;
 						util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-						token0 = line.substr(tokenStart, i - tokenStart);
-						tokens.push_back(token0);
-					}
-				}
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						tokens.push_back(line.substr(tokenStart, i - tokenStart));
 
-				if (i < line.size())
-				{
-					if (token0.starts_with('#'))
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+
+						// Get value, either a string literal expansion or a numeric expansion.
+						tokenStart = i;
+						util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
+						if (i < line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						tokens.push_back(line.substr(tokenStart, i - tokenStart));
+					}
+					else if (directive == "if" || directive == "elif")
 					{
-						std::string_view directive = token0.substr(1);
-						if (directive == "include")
-						{
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
 
-							// Defer string literal expansion.
-							tokens.push_back(line.substr(i, line.size()));
-						}
-						else if (directive == "define")
-						{
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						// TODO: handle this stuff.
+						// Defer the tokenization because it has operator precedence.
+						// Operators in this case are: & ^ | ~ + -(binary) * / % << >> >>> -(unary),
+						//	as well as: &&, ||, !, !=, ==, >, <, >=, <=
+						tokens.push_back(line.substr(i, line.size()));
+					}
+					else if (directive == "macro")
+					{
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
 
-							// Get identifier.
-							size_t tokenStart = i;
-							util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-							tokens.push_back(line.substr(tokenStart, i - tokenStart));
+						// Get identifier.
+						size_t tokenStart = i;
+						util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						tokens.push_back(line.substr(tokenStart, i - tokenStart));
 
+						// Get parameters, identifiers that start with a $.
+						do
+						{
 							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
 							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+							if (c != '$') return { AssemblerError_MacroArgsMustStartWithDollarSign, lineNumber };
 
-							// Get value, either a string literal expansion or a numeric expansion.
 							tokenStart = i;
 							util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-							if (i < line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
 							tokens.push_back(line.substr(tokenStart, i - tokenStart));
 						}
-						else if (directive == "if" || directive == "elif")
-						{
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-
-							// TODO: handle this stuff.
-							// Defer the tokenization because it has operator precedence.
-							// Operators in this case are: & ^ | ~ + -(binary) * / % << >> >>> -(unary),
-							//	as well as: &&, ||, !, !=, ==, >, <, >=, <=
-							tokens.push_back(line.substr(i, line.size()));
-						}
-						else if (directive == "macro")
-						{
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						while (i < line.size());
+					}
+					else if (directive == "namespace")
+					{
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
 
-							// Get identifier.
-							size_t tokenStart = i;
-							util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-							tokens.push_back(line.substr(tokenStart, i - tokenStart));
+						// Get identifier.
+						size_t tokenStart = i;
+						util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
+						if (i < line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						tokens.push_back(line.substr(tokenStart, i - tokenStart));
+					}
+					else if (directive == "assert")
+					{
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
 
-							// Get parameters, identifiers that start with a $.
-							do
-							{
-								util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-								if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-								if (c != '$') return { AssemblerError_MacroArgsMustStartWithDollarSign, lineNumber };
+						// Get the assertion condition, only a numeric expansion.
+						size_t tokenStart = i;
+						util::string::FindFirstOf(line, i, c, IsParameterSeparator<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						tokens.push_back(line.substr(tokenStart, i - tokenStart));
 
-								tokenStart = i;
-								util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-								tokens.push_back(line.substr(tokenStart, i - tokenStart));
-							}
-							while (i < line.size());
-						}
-						else if (directive == "namespace")
-						{
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
 
-							// Get identifier.
-							size_t tokenStart = i;
-							util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-							if (i < line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-							tokens.push_back(line.substr(tokenStart, i - tokenStart));
-						}
-						else if (directive == "assert")
-						{
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						// Defer string literal expansion.
+						tokens.push_back(line.substr(i, line.size()));
+					}
+				}
+				else // .directives or instructions, with parameters.
+				{
+					util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+					if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveOrInstructionParameters, lineNumber };
 
-							// Get the assertion condition, only a numeric expansion.
-							size_t tokenStart = i;
-							util::string::FindFirstOf(line, i, c, IsParameterSeparator<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-							tokens.push_back(line.substr(tokenStart, i - tokenStart));
+					if (token0 == ".equ")
+					{
+						// Get identifier.
+						size_t tokenStart = i;
+						util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
+						tokens.push_back(line.substr(tokenStart, i - tokenStart));
 
-							util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+						if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
 
-							// Defer string literal expansion.
-							tokens.push_back(line.substr(i, line.size()));
-						}
+						tokens.push_back(line.substr(i, line.size()));
 					}
-					else // .directives or instructions, with parameters.
+					else
 					{
-						util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-						if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveOrInstructionParameters, lineNumber };
-
-						if (token0 == ".equ")
-						{
-							// Get identifier.
-							size_t tokenStart = i;
-							util::string::FindFirstOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
-							tokens.push_back(line.substr(tokenStart, i - tokenStart));
-
-							util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-							if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
+						// Get operand 0.
+						size_t tokenStart = i;
+						util::string::FindFirstOf(line, i, c, IsParameterSeparator<char>);
+						tokens.push_back(line.substr(tokenStart, i - tokenStart));
 
-							tokens.push_back(line.substr(i, line.size()));
-						}
-						else
+						if (token0 == ".db" || token0 == ".dw" || token0 == ".dl")
 						{
-							// Get operand 0.
-							size_t tokenStart = i;
-							util::string::FindFirstOf(line, i, c, IsParameterSeparator<char>);
-							tokens.push_back(line.substr(tokenStart, i - tokenStart));
-
-							if (token0 == ".db" || token0 == ".dw" || token0 == ".dl")
+							while (i < line.size())
 							{
-								while (i < line.size())
+								if (i < line.size() - 2)
 								{
-									if (i < line.size() - 2)
+									c = line[++i];
+									if (util::string::IsBlank(c))
 									{
-										c = line[++i];
-										if (util::string::IsBlank(c))
-										{
-											util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-											if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
-										}
-
-										tokenStart = i;
-										util::string::FindFirstOfPastQuote(line, i, c, IsParameterSeparator<char>);
-										tokens.push_back(line.substr(tokenStart, i - tokenStart));
-									}
-									else // operands end with a comma
-									{
-										result.warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
-										break;
+										util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+										if (i >= line.size()) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
 									}
+
+									tokenStart = i;
+									util::string::FindFirstOfPastQuote(line, i, c, IsParameterSeparator<char>);
+									tokens.push_back(line.substr(tokenStart, i - tokenStart));
+								}
+								else // operands end with a comma
+								{
+									warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
+									break;
 								}
 							}
-							else
+						}
+						else
+						{
+							// Optionally get operand 1.
+							if (i < line.size())
 							{
-								// Optionally get operand 1.
-								if (i < line.size())
+								if (i < line.size() - 2)
 								{
-									if (i < line.size() - 2)
+									c = line[++i];
+									if (util::string::IsBlank(c))
+									{
+										util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
+										if (i >= line.size()) return { AssemblerError_InvalidInstructionOpcodes, lineNumber };
+									}
+
+									tokenStart = i;
+									util::string::FindFirstOf(line, i, c, IsParameterSeparator<char>);
+									if (i < line.size())
 									{
-										c = line[++i];
-										if (util::string::IsBlank(c))
-										{
-											util::string::FindFirstNotOf(line, i, c, util::string::IsBlank<char>);
-											if (i >= line.size()) return { AssemblerError_InvalidInstructionOpcodes, lineNumber };
-										}
-
-										tokenStart = i;
-										util::string::FindFirstOf(line, i, c, IsParameterSeparator<char>);
-										if (i < line.size())
-										{
-											if (i < line.size() - 2)
-												return { AssemblerError_InvalidInstructionOpcodes, lineNumber };
-											else // operands end with a comma
-												result.warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
-										}
-										tokens.push_back(line.substr(tokenStart, i - tokenStart));
+										if (i < line.size() - 2)
+											return { AssemblerError_InvalidInstructionOpcodes, lineNumber };
+										else // operands end with a comma
+											warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
 									}
-									else // operands end with a comma
-										result.warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
+									tokens.push_back(line.substr(tokenStart, i - tokenStart));
 								}
+								else // operands end with a comma
+									warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
 							}
 						}
 					}
 				}
-				else // Only operandless instructions, parameterless preprocessor statements, label definitions, or syntax errors.
+			}
+			else // Only operandless instructions, parameterless preprocessor statements, label definitions, or syntax errors.
+			{
+				// TODO: if .directives with no parameters exist, replace the immediate return with their implementations.
+				if (token0.starts_with('.')) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
+				if (token0.starts_with('#'))
 				{
-					// TODO: if .directives with no parameters exist, replace the immediate return with their implementations.
-					if (token0.starts_with('.')) return { AssemblerError_InvalidDotDirectiveParameters, lineNumber };
-					if (token0.starts_with('#'))
-					{
-						std::string_view directive = token0.substr(1);
-						if (directive != "else" && directive != "endif" && directive != "endmacro" && directive != "endnamespace")
-							return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
-					}
-					else if (token0.ends_with(','))
-					{
-						result.warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
-						tokens.back() = tokens.back().substr(0, tokens.back().size() - 1);
-					}
+					std::string_view directive = token0.substr(1);
+					if (directive != "else" && directive != "endif" && directive != "endmacro" && directive != "endnamespace")
+						return { AssemblerError_InvalidPreprocessorStatement, lineNumber };
+				}
+				else if (token0.ends_with(','))
+				{
+					warnings.emplace_back(AssemblerWarning_OpcodeTrailingComma, lineNumber);
+					tokens.back() = tokens.back().substr(0, tokens.back().size() - 1);
 				}
 			}
-
-			if (size_t tokenCount = tokens.size() - tokenStartIndex)
-				tokenizedLineViews.emplace_back(tokenStartIndex, tokenCount, lineNumber);
 		}
 
+		if (size_t tokenCount = tokens.size() - tokenStartIndex)
+			tokenizedLineViews.emplace_back(tokenStartIndex, tokenCount, lineNumber);
+
+		return AssemblerError_None;
+	}
+
+	AssemblerError Tokenize(const std::pmr::vector<std::string_view>& lines, std::pmr::vector<std::string_view>& tokens, std::pmr::vector<TokenizedLineView>& tokenizedLineViews, std::vector<AssemblerWarning>& warnings)
+	{
+		PROFILE_FUNCTION();
+
+		tokenizedLineViews.reserve(lines.size());
+		for (size_t lineNumber = 0; lineNumber < lines.size(); lineNumber++)
+			if (auto error = TokenizeLine(lines[lineNumber], lineNumber, tokens, tokenizedLineViews, warnings))
+				return error;
+
+		return AssemblerError_None;
+	}
+
+	void MakeTokenizedLines(std::pmr::vector<std::string_view>& tokens, const std::pmr::vector<TokenizedLineView>& tokenizedLineViews, std::pmr::vector<TokenizedLine>& tokenizedLines)
+	{
 		tokenizedLines.reserve(tokenizedLineViews.size());
 		for (auto& tokenizedLineView : tokenizedLineViews)
 			tokenizedLines.emplace_back(tokens, tokenizedLineView.start, tokenizedLineView.tokenCount, tokenizedLineView.lineNumber);
+	}
 
-		return AssemblerError_None;
+	AssemblerError ParseSource(const std::filesystem::path& filepath, const AssemblerLimits& limits, ParsedSource& source)
+	{
+		PROFILE_FUNCTION();
+
+		if (!ReadFile(filepath, source.contents, source.sourceLines))
+			return source.error = AssemblerError_FailedToReadInputFile;
+
+		std::pmr::vector<std::string_view> lines = source.sourceLines;
+		if ((source.error = StripWhitespace(lines, limits.maxLineLength)))
+			return source.error;
+
+		return source.error = Tokenize(lines, source.tokens, source.tokenizedLineViews, source.warnings);
 	}
 
-	void CullHandledTokenizedLines(std::vector<TokenizedLine>& tokenizedLines)
+	void CullHandledTokenizedLines(std::pmr::vector<TokenizedLine>& tokenizedLines)
 	{
+		PROFILE_FUNCTION();
+
 		std::erase_if(tokenizedLines, [](const TokenizedLine& tokenizedLine) noexcept { return tokenizedLine.handled; });
 	}
 
-	void FindEquates(const std::vector<std::string_view>& tokens, std::vector<TokenizedLine>& tokenizedLines, std::vector<Equate>& equates)
+	void FindEquates(const std::pmr::vector<std::string_view>& tokens, std::pmr::vector<TokenizedLine>& tokenizedLines, std::pmr::vector<Equate>& equates)
 	{
+		PROFILE_FUNCTION();
+
 		size_t equateCount = 0;
 
 		for (auto& tokenizedLine : tokenizedLines)
@@ -604,9 +821,128 @@ namespace ez80
 		{
 			if (tokenizedLine[0] == ".equ")
 			{
-				equates.emplace_back(tokenizedLine[1], tokenizedLine[2]);
+				equates.emplace_back(tokenizedLine[1], tokenizedLine[2], tokenizedLine.number);
+				tokenizedLine.handled = true;
+			}
+		}
+	}
+
+	bool FindPlatformIncludes(std::pmr::vector<TokenizedLine>& tokenizedLines)
+	{
+		PROFILE_FUNCTION();
+
+		bool found = false;
+		for (auto& tokenizedLine : tokenizedLines)
+		{
+			if (tokenizedLine.tokenCount == 2 && tokenizedLine[0] == "#include" && IsPlatformInclude(tokenizedLine[1]))
+			{
 				tokenizedLine.handled = true;
+				found = true;
 			}
 		}
+		return found;
+	}
+
+	AssemblerError CheckEquateDepth(const std::pmr::vector<Equate>& equates, uint32_t maxDepth)
+	{
+		PROFILE_FUNCTION();
+
+		std::pmr::memory_resource* arena = equates.get_allocator().resource();
+		std::pmr::unordered_map<std::string_view, size_t> equateIndices(arena);
+		equateIndices.reserve(equates.size());
+		for (size_t i = 0; i < equates.size(); i++)
+			equateIndices.emplace(equates[i].identifier, i);
+
+		// The equates each one uses are the ones from its first reference up to the next one's.
+		std::pmr::vector<size_t> firstReferences(equates.size() + 1, 0, arena);
+		std::pmr::vector<size_t> references(arena);
+		for (size_t i = 0; i < equates.size(); i++)
+		{
+			firstReferences[i] = references.size();
+			ForEachIdentifier(equates[i].value, [&](std::string_view identifier)
+			{
+				if (auto it = equateIndices.find(identifier); it != equateIndices.end())
+					references.push_back(it->second);
+			});
+		}
+		firstReferences.back() = references.size();
+
+		// Depth first with a stack of its own, since the chains being looked for are the ones that would run out the real one.
+		// Cycles are left to evaluation, which already treats them as unknown.
+		struct Frame
+		{
+			size_t equate = 0;
+			size_t nextReference = 0;
+		};
+		std::pmr::vector<uint32_t> depths(equates.size(), 0, arena); // 0 until known.
+		std::pmr::vector<bool> visiting(equates.size(), false, arena);
+		std::pmr::vector<Frame> stack(arena);
+		for (size_t root = 0; root < equates.size(); root++)
+		{
+			if (depths[root] != 0)
+				continue;
+
+			stack.push_back({ root, firstReferences[root] });
+			visiting[root] = true;
+			while (!stack.empty())
+			{
+				Frame& frame = stack.back();
+				if (frame.nextReference < firstReferences[frame.equate + 1])
+				{
+					size_t reference = references[frame.nextReference++];
+					if (depths[reference] == 0 && !visiting[reference])
+					{
+						visiting[reference] = true;
+						stack.push_back({ reference, firstReferences[reference] });
+					}
+					continue;
+				}
+
+				uint32_t depth = 1;
+				for (size_t i = firstReferences[frame.equate]; i < firstReferences[frame.equate + 1]; i++)
+					depth = std::max(depth, depths[references[i]] + 1);
+				if (depth > maxDepth)
+					return { AssemblerError_EquateTooDeep, equates[frame.equate].lineNumber };
+
+				depths[frame.equate] = depth;
+				visiting[frame.equate] = false;
+				stack.pop_back();
+			}
+		}
+
+		return AssemblerError_None;
+	}
+
+	void CheckPlatformSymbols(const std::pmr::vector<TokenizedLine>& tokenizedLines, const std::pmr::vector<Equate>& equates, std::vector<AssemblerWarning>& warnings)
+	{
+		PROFILE_FUNCTION();
+
+		// Labels under both names, since an equate in a namespace can use either.
+		std::pmr::memory_resource* arena = equates.get_allocator().resource();
+		std::pmr::unordered_set<std::string_view> knownNames(arena);
+		knownNames.reserve(equates.size());
+		for (const Equate& equate : equates)
+			knownNames.insert(equate.identifier);
+		SourceScope scope;
+		for (const TokenizedLine& tokenizedLine : tokenizedLines)
+		{
+			if (scope.Visit(tokenizedLine) == SourceScopeEvent_Label)
+			{
+				std::string_view name = GetLabelName(tokenizedLine);
+				knownNames.insert(name);
+				knownNames.insert(scope.Qualify(name, arena));
+			}
+		}
+
+		for (const Equate& equate : equates)
+		{
+			ForEachIdentifier(equate.value, [&](std::string_view identifier)
+			{
+				if (int64_t value = 0; knownNames.contains(identifier) || FindPlatformSymbol(identifier, value))
+					return;
+				warnings.emplace_back(AssemblerWarning_UnknownPlatformSymbol, equate.lineNumber, identifier);
+				knownNames.insert(identifier); // Once per name.
+			});
+		}
 	}
 }
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "AssemblerTypes.h"
+#include "PhaseStats.h"
 #include <filesystem>
+#include <memory_resource>
+#include <string>
 #include <vector>
 
 namespace ez80
@@ -13,13 +17,19 @@ namespace ez80
 		AssemblerError_InvalidInputFileExtension,
 		AssemblerError_OutputFileNameInvalid,
 		AssemblerError_FailedToReadInputFile,
+		AssemblerError_LineTooLong,
 		AssemblerError_InvalidStringLiteral,
 		AssemblerError_InvalidPreprocessorStatement,
 		AssemblerError_MacroArgsMustStartWithDollarSign,
 		AssemblerError_InvalidDotDirectiveOrInstructionParameters,
 		AssemblerError_InvalidDotDirectiveParameters,
 		AssemblerError_InvalidInstructionOpcodes,
-
+		AssemblerError_EquateTooDeep,
+		AssemblerError_FailedToReadLayoutProfile,
+		AssemblerError_FailedToWriteCycleReport,
+		AssemblerError_FailedToWriteProfile,
+		AssemblerError_FailedToWriteObjectFile,
+		AssemblerError_FailedToWriteListing,
 
 		// At the very end of the error list. (approximately ordered in the order they can happen in)
 		AssemblerError_AssemblyEmpty,
@@ -43,19 +53,60 @@ namespace ez80
 	{
 		AssemblerWarning_AssemblyDoesntStartWithEF_7B,
 		AssemblerWarning_NoAssemblyProduced,
-		AssemblerWarning_OpcodeTrailingComma
+		AssemblerWarning_OpcodeTrailingComma,
+		AssemblerWarning_IncludeNotFound, // Only found by BuildProject, which looks for every program's includes.
+		AssemblerWarning_OriginNotEvaluated, // A .org that couldn't be evaluated, so the listing and object file ignore it.
+		AssemblerWarning_UnknownPlatformSymbol, // With builtinPlatformInclude, an equate uses a name the built-in table doesn't have.
+		AssemblerWarning_DeadCodeKept, // An #include or macro invocation, which eliminateDeadCode can't see into, so it removed nothing.
 	};
 	struct AssemblerWarning
 	{
 		using ID = std::underlying_type_t<AssemblerWarning_>;
 
-		constexpr AssemblerWarning(ID id = 0, size_t lineNumber = 0) noexcept
-			: id(id), lineNumber(lineNumber + 1) {}
+		AssemblerWarning(ID id = 0, size_t lineNumber = 0, std::string_view identifier = {})
+			: id(id), lineNumber(lineNumber + 1), identifier(identifier) {}
 
 		constexpr operator ID() const noexcept { return id; }
 
 		ID id = 0;
 		size_t lineNumber = 0;
+		std::string identifier; // The name it's about, if any.
+	};
+
+	enum AssemblerRewrite_ : uint32_t
+	{
+		AssemblerRewrite_LoadZeroToXor,      // ld a, 0 -> xor a, when the flags are dead.
+		AssemblerRewrite_TailCall,           // call x / ret -> jp x
+		AssemblerRewrite_RedundantExchange,  // ex de, hl / ex de, hl -> nothing
+		AssemblerRewrite_StackAdjust,        // ld hl, n / add hl, sp / ld sp, hl -> inc sp or dec sp, when hl and the flags are dead.
+		AssemblerRewrite_ShortBranch,        // jp x -> jr x, when x is in range. Only jp, never djnz.
+		AssemblerRewrite_DuplicateData,      // A: .db "hi", 0 / B: .db "hi", 0 -> .equ B, A
+		AssemblerRewrite_TailMergedData,     // A: .db "test; thing", 0 / B: .db "thing", 0 -> .equ B, A + 6
+	};
+	struct AssemblerRewrite
+	{
+		using ID = std::underlying_type_t<AssemblerRewrite_>;
+
+		constexpr AssemblerRewrite(ID id = 0, size_t lineNumber = 0, uint32_t bytesSaved = 0, uint32_t cyclesSaved = 0) noexcept
+			: id(id), lineNumber(lineNumber + 1), bytesSaved(bytesSaved), cyclesSaved(cyclesSaved) {}
+
+		constexpr operator ID() const noexcept { return id; }
+
+		ID id = 0;
+		size_t lineNumber = 0;
+		uint32_t bytesSaved = 0; // In ADL mode.
+		uint32_t cyclesSaved = 0; // In ADL mode, when any branch involved is taken.
+	};
+
+	// A label, and the code or data after it, that was removed because nothing could reach it.
+	struct AssemblerRemoval
+	{
+		AssemblerRemoval(std::string_view label = {}, size_t lineNumber = 0, uint32_t bytesSaved = 0)
+			: label(label), lineNumber(lineNumber + 1), bytesSaved(bytesSaved) {}
+
+		std::string label; // Fully qualified.
+		size_t lineNumber = 0;
+		uint32_t bytesSaved = 0; // In ADL mode.
 	};
 
 	struct AssemblerResult
@@ -67,15 +118,122 @@ namespace ez80
 		// Only the first error is reported.
 		AssemblerError error = AssemblerError_None;
 		std::vector<AssemblerWarning> warnings;
+		std::vector<AssemblerRewrite> rewrites; // See AssemblerInfo::optimizePeephole, mergeConstantData and relaxBranches.
+		std::vector<AssemblerRemoval> removals; // Only filled if AssemblerInfo::eliminateDeadCode is set.
+		AssemblerStats stats; // Only filled if AssemblerInfo::collectStats is set, see WriteAssemblerStats.
+		uint64_t layoutCyclesSaved = 0; // Estimated over the profiled run, see AssemblerInfo::layoutProfileFilepath.
+	};
+
+	// A symbol defined before the first line, the same as an .equ there.
+	struct AssemblerDefine
+	{
+		std::string name;
+		std::string value;
+	};
+
+	// A source file read, stripped and tokenized, which is everything assembling does that only depends on the file itself.
+	// Programs that share a file can parse it once and each pass it as AssemblerInfo::parsedInput.
+	// Everything points into contents, so it can't be copied or moved once parsed.
+	struct ParsedSource
+	{
+		ParsedSource() = default;
+		ParsedSource(const ParsedSource&) = delete;
+		ParsedSource& operator=(const ParsedSource&) = delete;
+
+		std::pmr::string contents; // Every line ending is \n.
+		std::pmr::vector<std::string_view> sourceLines; // As written, comments included.
+		std::pmr::vector<std::string_view> tokens;
+		std::pmr::vector<TokenizedLineView> tokenizedLineViews;
+		std::vector<AssemblerWarning> warnings;
+		AssemblerError error = AssemblerError_None;
+	};
+
+	// Hard limits, so that hostile or generated input fails with an error instead of stalling a shared build worker.
+	// Everything the assembler does is close to linear in these and the size of the input.
+	struct AssemblerLimits
+	{
+		size_t maxLineLength = 64 * 1024; // In bytes, without the line ending.
+		uint32_t maxEquateDepth = 1024; // How many equates deep an equate may be defined in terms of others.
+		size_t maxOutputSize = 16 * 1024 * 1024; // Of the program image before compression, in bytes.
 	};
 
 	struct AssemblerInfo
 	{
 		std::filesystem::path inputFilepath;
 		std::filesystem::path outputFilepath;
+
+		// Compresses the program behind a stub that unpacks it in place when run, if that makes it smaller.
+		// This lets programs larger than the .8xp size limit still be sent, as long as they compress below it.
+		bool compressOutput = false;
+
+		// Optional, if not empty, a relocatable object is written here instead of a program to outputFilepath,
+		// for Link to combine with other objects later.
+		std::filesystem::path objectFilepath;
+
 		std::vector<std::filesystem::path> includeDirectories;
+		std::vector<AssemblerDefine> defines;
+
+		// #include "ti84pce.inc" is resolved to a copy of its equates built into the assembler, without reading any file,
+		// and they're looked up as they're used. See PlatformSymbols.h. The copy checked in is partial, only 81 of the
+		// equates, until Scripts/GeneratePlatformSymbols.sh is run on a full ti84pce.inc, so an equate using one that's
+		// missing gets AssemblerWarning_UnknownPlatformSymbol naming it rather than quietly having no value.
+		bool builtinPlatformInclude = false;
+
+		// Optional, if set, inputFilepath is already parsed into this and isn't read again. See ParseSource.
+		const ParsedSource* parsedInput = nullptr;
+
+		// Removes labels, and the code or data after them, that can't be reached from the entry point after the header.
+		// Labels in exportedSymbols, and those referenced from equates, macros or preprocessor statements, are always kept.
+		// Only references written in the file itself are seen, so a program with an #include other than the built-in
+		// platform include, or a macro invocation, is left as is with AssemblerWarning_DeadCodeKept. See EliminateDeadCode.
+		bool eliminateDeadCode = false;
+		std::vector<std::string> exportedSymbols; // Fully qualified.
+
+		// Folds identical blocks of constant data, and strings that end others, onto one copy, see MergeConstantData.
+		// Labels are assumed not to be used to reach past the end of their own data into the next label's.
+		bool mergeConstantData = false;
+
+		// Rewrites known slow or large instruction sequences into cheaper equivalents, see AssemblerRewrite_.
+		bool optimizePeephole = false;
+
+		// Shortens jp to jr wherever the target is close enough, see RelaxBranches. djnz is left as written either way,
+		// so one whose target is out of range isn't expanded to dec b / jp nz, and dec b / jp nz isn't shortened to djnz.
+		bool relaxBranches = true;
+
+		// Optional, if not empty, routines are reordered by how many times each instruction ran in this execution profile
+		// of the program, so that more branches fit in jr, see ReadExecutionProfile and OrderRoutinesByProfile.
+		std::filesystem::path layoutProfileFilepath;
+
+		// Optional, if set, everything that only lives for the call to Assemble is allocated from here instead of the heap.
+		// Some of it is never deallocated, so this is meant to be an arena, like a std::pmr::monotonic_buffer_resource.
+		// A host assembling many programs can pass one AssemblerArena and reset it between them, so that once it has grown
+		// to fit it does almost no allocations and doesn't fragment its heap. An arena keeps every buffer a vector outgrew
+		// though, so it peaks at about twice the memory. Otherwise each call pools over std::pmr::get_default_resource().
+		std::pmr::memory_resource* memoryResource = nullptr;
+
+		AssemblerLimits limits;
+
+		// Times every phase and counts its allocations, bytes allocated and peak memory use into AssemblerResult::stats.
+		// Allocations are only counted when built with EZ80_COUNT_ALLOCATIONS, see PhaseRecorder.
+		bool collectStats = false;
+
+		// Optional, if not empty, a per-label and per-namespace size and cycle report is written here,
+		// as both .json and .txt files.
+		std::filesystem::path cycleReportFilepath;
+
+		// Optional, if not empty, a listing of every source line with its address, size and bytes is written here
+		// with a .lst extension, and a symbol map of every label's address and equate's value with a .map extension.
+		std::filesystem::path listingFilepath;
+
+		// Optional, if not empty, the assembled program is run in the built-in eZ80 simulator from UserMem,
+		// and its per-instruction and per-label cycle profile is written here as json.
+		std::filesystem::path profileFilepath;
+		uint64_t profileMaxCycles = 1'000'000'000;
 	};
 
 	// Returns 0 on success, non-zero otherwise.
 	AssemblerResult Assemble(const AssemblerInfo& info);
+
+	// Sets and returns source.error, which Assemble reports when given the source.
+	AssemblerError ParseSource(const std::filesystem::path& filepath, const AssemblerLimits& limits, ParsedSource& source);
 }
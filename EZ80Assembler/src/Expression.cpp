@@ -0,0 +1,218 @@
+#include "Expression.h"
+#include "AssemblerStringUtil.h"
+#include "StringUtil.h"
+#include <algorithm>
+
+namespace ez80
+{
+	struct BinaryOperator
+	{
+		std::string_view symbol;
+		uint8_t precedence;
+	};
+
+	// Longer symbols come before their prefixes, so that << isn't read as <.
+	static constexpr BinaryOperator s_BinaryOperators[] = {
+		{ ">>>", 8 },
+		{ "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 }, { ">=", 7 }, { "<<", 8 }, { ">>", 8 },
+		{ "|", 3 }, { "^", 4 }, { "&", 5 }, { "<", 7 }, { ">", 7 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 },
+	};
+
+	// Values are 24-bit, but are kept signed and wide while evaluating so that comparisons and shifts behave.
+	static constexpr int64_t s_ValueMask = 0xFFFFFF;
+
+	// Arithmetic wraps around through uint64_t, since signed overflow is undefined, and 1 << 63 is easy enough to write.
+	static constexpr int64_t WrappingAdd(int64_t left, int64_t right) noexcept { return static_cast<int64_t>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right)); }
+	static constexpr int64_t WrappingSubtract(int64_t left, int64_t right) noexcept { return static_cast<int64_t>(static_cast<uint64_t>(left) - static_cast<uint64_t>(right)); }
+	static constexpr int64_t WrappingMultiply(int64_t left, int64_t right) noexcept { return static_cast<int64_t>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right)); }
+
+	// Every unary operator and parenthesis recurses, so anything nested deeper than this is rejected rather than running the stack out.
+	static constexpr uint32_t s_MaxNesting = 256;
+
+	class ExpressionParser
+	{
+	public:
+		ExpressionParser(std::string_view expression, const ExpressionResolver& resolve) noexcept
+			: expression(expression), resolve(resolve) {}
+
+		bool Parse(int64_t& outValue)
+		{
+			if (!ParseBinary(0, outValue))
+				return false;
+			SkipBlanks();
+			return i == expression.size();
+		}
+	private:
+		void SkipBlanks() noexcept
+		{
+			while (i < expression.size() && util::string::IsBlank(expression[i]))
+				i++;
+		}
+
+		bool ParseBinary(uint8_t minPrecedence, int64_t& value)
+		{
+			if (!ParseUnary(value))
+				return false;
+
+			while (true)
+			{
+				SkipBlanks();
+				const BinaryOperator* found = nullptr;
+				for (const auto& binaryOperator : s_BinaryOperators)
+				{
+					if (expression.substr(i).starts_with(binaryOperator.symbol))
+					{
+						found = &binaryOperator;
+						break;
+					}
+				}
+				if (!found || found->precedence < minPrecedence)
+					return true;
+				i += found->symbol.size();
+
+				int64_t right = 0;
+				if (!ParseBinary(found->precedence + 1, right))
+					return false;
+				if (!Apply(found->symbol, value, right))
+					return false;
+			}
+		}
+
+		static bool Apply(std::string_view symbol, int64_t& left, int64_t right) noexcept
+		{
+			int64_t shift = std::min<int64_t>(std::max<int64_t>(right, 0), 63);
+			switch (symbol.front())
+			{
+				case '|': left = symbol.size() == 2 ? (left || right) : (left | right); return true;
+				case '&': left = symbol.size() == 2 ? (left && right) : (left & right); return true;
+				case '^': left ^= right; return true;
+				case '=': left = left == right; return true;
+				case '!': left = left != right; return true;
+				case '+': left = WrappingAdd(left, right); return true;
+				case '-': left = WrappingSubtract(left, right); return true;
+				case '*': left = WrappingMultiply(left, right); return true;
+				case '/':
+				case '%':
+					// The one quotient that doesn't fit traps instead of overflowing.
+					if (right == 0 || (right == -1 && left == INT64_MIN))
+						return false;
+					left = symbol.front() == '/' ? left / right : left % right;
+					return true;
+				case '<':
+					if (symbol == "<<")
+						left <<= shift;
+					else
+						left = symbol.size() == 2 ? left <= right : left < right;
+					return true;
+				case '>':
+					if (symbol == ">>>")
+						left = static_cast<int64_t>(static_cast<uint64_t>(left & s_ValueMask) >> shift);
+					else if (symbol == ">>")
+						left >>= shift;
+					else
+						left = symbol.size() == 2 ? left >= right : left > right;
+					return true;
+			}
+			return false;
+		}
+
+		bool ParseUnary(int64_t& value)
+		{
+			SkipBlanks();
+			if (i >= expression.size() || nesting == s_MaxNesting)
+				return false;
+
+			nesting++;
+			bool parsed = false;
+			char c = expression[i];
+			if (c == '-' || c == '~' || c == '!' || c == '+')
+			{
+				i++;
+				parsed = ParseUnary(value);
+				if (parsed)
+					value = c == '-' ? WrappingSubtract(0, value) : c == '~' ? ~value : c == '!' ? !value : value;
+			}
+			else
+				parsed = ParsePrimary(value);
+			nesting--;
+			return parsed;
+		}
+
+		bool ParsePrimary(int64_t& value)
+		{
+			char c = expression[i];
+			if (c == '(')
+			{
+				i++;
+				if (!ParseBinary(0, value))
+					return false;
+				SkipBlanks();
+				if (i >= expression.size() || expression[i] != ')')
+					return false;
+				i++;
+				return true;
+			}
+
+			if (c == '\'')
+			{
+				// 'a' or an escaped '\''.
+				size_t length = i + 2 < expression.size() && expression[i + 1] == '\\' ? 4 : 3;
+				if (i + length > expression.size() || expression[i + length - 1] != '\'')
+					return false;
+				value = static_cast<uint8_t>(expression[i + length - 2]);
+				i += length;
+				return true;
+			}
+
+			size_t start = i;
+			if (c == '$' || c == '%' || util::string::IsDecimalDigit(c))
+			{
+				for (i++; i < expression.size() && util::string::IsWord(expression[i]); i++);
+				uint32_t literal = 0;
+				if (!ParseNumericLiteral(expression.substr(start, i - start), literal))
+					return false;
+				value = literal;
+				return true;
+			}
+
+			if (IsIdentifierStart(c))
+			{
+				for (i++; i < expression.size() && (util::string::IsWord(expression[i]) || expression[i] == '.'); i++);
+				return resolve(expression.substr(start, i - start), value);
+			}
+			return false;
+		}
+
+		std::string_view expression;
+		const ExpressionResolver& resolve;
+		size_t i = 0;
+		uint32_t nesting = 0;
+	};
+
+	bool EvaluateExpression(std::string_view expression, const ExpressionResolver& resolve, int64_t& outValue)
+	{
+		return ExpressionParser(expression, resolve).Parse(outValue);
+	}
+
+	EquateResolver::EquateResolver(std::span<const Equate> equates, ExpressionResolver fallback)
+		: equates(equates), fallback(std::move(fallback)), states(equates.size(), EquateState_Unevaluated), values(equates.size(), 0)
+	{
+		equateIndices.reserve(equates.size());
+		for (size_t i = 0; i < equates.size(); i++)
+			equateIndices.emplace(equates[i].identifier, i);
+	}
+
+	bool EquateResolver::Resolve(std::string_view identifier, int64_t& outValue)
+	{
+		if (auto equate = equateIndices.find(identifier); equate != equateIndices.end())
+			return Evaluate(equate->second, outValue);
+		return fallback && fallback(identifier, outValue);
+	}
+
+	bool EquateResolver::Evaluate(size_t index, int64_t& outValue)
+	{
+		bool known = EvaluateEquate(equates[index].value, [this](std::string_view identifier, int64_t& identifierValue) { return Resolve(identifier, identifierValue); }, states[index], values[index]);
+		outValue = values[index];
+		return known;
+	}
+}
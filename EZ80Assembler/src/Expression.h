@@ -0,0 +1,59 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+
+namespace ez80
+{
+	// Returns false if the identifier has no known value.
+	using ExpressionResolver = std::function<bool(std::string_view identifier, int64_t& outValue)>;
+
+	// Evaluates numeric literals, identifiers and the operators, from lowest to highest precedence:
+	//	||, &&, |, ^, &, == !=, < <= > >=, << >> >>>, + -, * / %, and the unary - ~ ! +
+	// Returns false if the expression is malformed, divides by zero, divides the most negative value by -1,
+	// or uses an identifier resolve doesn't know. Anything else that overflows wraps around.
+	bool EvaluateExpression(std::string_view expression, const ExpressionResolver& resolve, int64_t& outValue);
+
+	enum EquateState_ : uint8_t
+	{
+		EquateState_Unevaluated,
+		EquateState_Evaluating, // Catches equates defined in terms of themselves.
+		EquateState_Known,
+		EquateState_Unknown,
+	};
+	using EquateState = std::underlying_type_t<EquateState_>;
+
+	// Evaluates an equate's expression into value the first time, and returns whether it's known. Equates defined
+	// in terms of themselves have no value. Setting state back to EquateState_Unevaluated has it evaluated again.
+	// Resolver is anything an ExpressionResolver can be made from, which is only done if it's evaluated.
+	template<typename Resolver>
+	bool EvaluateEquate(std::string_view expression, const Resolver& resolve, EquateState& state, int64_t& value);
+
+	// Resolves equates by evaluating each one the first time it's looked up, and anything else with fallback.
+	// Equates can use each other in any order, and those defined in terms of themselves have no value.
+	class EquateResolver
+	{
+	public:
+		EquateResolver(std::span<const Equate> equates, ExpressionResolver fallback = nullptr);
+
+		bool Resolve(std::string_view identifier, int64_t& outValue);
+		ExpressionResolver Resolver() { return [this](std::string_view identifier, int64_t& outValue) { return Resolve(identifier, outValue); }; }
+
+		// By index into equates.
+		bool Evaluate(size_t index, int64_t& outValue);
+	private:
+		std::span<const Equate> equates;
+		ExpressionResolver fallback;
+		std::unordered_map<std::string_view, size_t> equateIndices;
+		std::vector<EquateState> states;
+		std::vector<int64_t> values;
+	};
+
+	// Calls visitor with every identifier in an operand or expression, skipping string and character literals.
+	template<typename Visitor>
+	void ForEachIdentifier(std::string_view expression, Visitor visitor);
+}
+
+#include "Expression.inl"
@@ -0,0 +1,46 @@
+#include "Expression.h"
+#include "AssemblerStringUtil.h"
+#include "StringUtil.h"
+
+namespace ez80
+{
+	template<typename Resolver>
+	bool EvaluateEquate(std::string_view expression, const Resolver& resolve, EquateState& state, int64_t& value)
+	{
+		if (state == EquateState_Unevaluated)
+		{
+			state = EquateState_Evaluating;
+			bool evaluated = EvaluateExpression(expression, resolve, value);
+			state = evaluated ? EquateState_Known : EquateState_Unknown;
+		}
+		return state == EquateState_Known;
+	}
+
+	template<typename Visitor>
+	void ForEachIdentifier(std::string_view expression, Visitor visitor)
+	{
+		size_t i = 0;
+		while (i < expression.size())
+		{
+			char c = expression[i];
+			if (c == '"' || c == '\'')
+			{
+				// Skip to the closing quote.
+				for (i++; i < expression.size() && expression[i] != c; i++)
+					if (expression[i] == '\\')
+						i++;
+				i++;
+			}
+			else if (IsIdentifierStart(c) || util::string::IsDecimalDigit(c) || c == '$' || c == '%')
+			{
+				size_t start = i++;
+				while (i < expression.size() && (util::string::IsWord(expression[i]) || expression[i] == '.'))
+					i++;
+				if (IsIdentifierStart(c))
+					visitor(expression.substr(start, i - start));
+			}
+			else
+				i++;
+		}
+	}
+}
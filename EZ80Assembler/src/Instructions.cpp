@@ -0,0 +1,612 @@
+#include "Instructions.h"
+#include "StringUtil.h"
+
+namespace ez80
+{
+	// The size of an address, immediate word or pushed register in each mode.
+	static constexpr uint8_t s_WordSizes[AssemblyMode_Count] = { 3, 2 };
+
+	// How an instruction's costs are derived, see InstructionCost.
+	struct CostModel
+	{
+		uint8_t opcodeBytes = 0; // Prefixes, opcode, displacement and 8-bit immediate bytes.
+		uint8_t immediateWords = 0; // Mode sized immediates or addresses following the opcode.
+		uint8_t transferBytes = 0; // Data bytes read or written.
+		uint8_t transferWords = 0; // Mode sized data words read or written.
+		uint8_t extra = 0; // Fixed overhead.
+		uint8_t takenWords = 0; // Mode sized words transferred only when branching, i.e. the return address.
+		uint8_t takenExtra = 0; // Fixed overhead only when branching, i.e. refilling the pipeline.
+	};
+
+	static bool Is(std::string_view left, std::string_view right) noexcept
+	{
+		return util::string::EqualsIgnoreCase(left, right);
+	}
+
+	// Returns if the operand is ix or iy, optionally followed by a signed displacement.
+	static bool IsIndexExpression(std::string_view operand) noexcept
+	{
+		if (operand.size() < 2 || !(Is(operand.substr(0, 2), "ix") || Is(operand.substr(0, 2), "iy")))
+			return false;
+		std::string_view displacement = util::string::TrimBlanks(operand.substr(2));
+		return displacement.empty() || displacement.front() == '+' || displacement.front() == '-';
+	}
+
+	OperandKind ClassifyOperand(std::string_view operand) noexcept
+	{
+		operand = util::string::TrimBlanks(operand);
+		if (operand.empty())
+			return OperandKind_None;
+
+		if (operand.size() > 2 && operand.front() == '(' && operand.back() == ')')
+		{
+			std::string_view inner = util::string::TrimBlanks(operand.substr(1, operand.size() - 2));
+			if (Is(inner, "hl"))
+				return OperandKind_IndirectHL;
+			if (Is(inner, "bc") || Is(inner, "de"))
+				return OperandKind_IndirectRegister;
+			if (Is(inner, "sp"))
+				return OperandKind_IndirectSP;
+			if (Is(inner, "c"))
+				return OperandKind_IndirectC;
+			if (IsIndexExpression(inner))
+				return OperandKind_Indexed;
+			return OperandKind_IndirectImmediate;
+		}
+
+		if (operand.size() == 1)
+		{
+			switch (util::string::ToLower(operand.front()))
+			{
+				case 'a': case 'b': case 'c': case 'd': case 'e': case 'h': case 'l':
+					return OperandKind_Register8;
+				case 'i': case 'r':
+					return OperandKind_SpecialRegister;
+			}
+		}
+		else if (operand.size() == 2)
+		{
+			if (Is(operand, "bc") || Is(operand, "de") || Is(operand, "hl"))
+				return OperandKind_Register16;
+			if (Is(operand, "sp"))
+				return OperandKind_StackPointer;
+			if (Is(operand, "ix") || Is(operand, "iy"))
+				return OperandKind_IndexRegister;
+			if (Is(operand, "af"))
+				return OperandKind_AccumulatorFlags;
+			if (Is(operand, "mb"))
+				return OperandKind_SpecialRegister;
+		}
+		else if (operand.size() == 3)
+		{
+			if (Is(operand, "ixh") || Is(operand, "ixl") || Is(operand, "iyh") || Is(operand, "iyl"))
+				return OperandKind_IndexHalf;
+			if (Is(operand, "af'"))
+				return OperandKind_ShadowAF;
+		}
+
+		if (IsIndexExpression(operand))
+			return OperandKind_IndexOffset;
+		return OperandKind_Immediate;
+	}
+
+	bool IsCondition(std::string_view operand) noexcept
+	{
+		operand = util::string::TrimBlanks(operand);
+		return Is(operand, "nz") || Is(operand, "z") || Is(operand, "nc") || Is(operand, "c") ||
+			Is(operand, "po") || Is(operand, "pe") || Is(operand, "p") || Is(operand, "m");
+	}
+
+	static bool IsShortCondition(std::string_view operand) noexcept
+	{
+		operand = util::string::TrimBlanks(operand);
+		return Is(operand, "nz") || Is(operand, "z") || Is(operand, "nc") || Is(operand, "c");
+	}
+
+	// Mnemonics are case insensitive, so this writes a lowercase copy into buffer and strips any mode suffix.
+	// Mode suffixes (.s, .l, .is, .il, .sis, .lis, .sil, .lil) each add a prefix byte.
+	static bool NormalizeMnemonic(std::string_view mnemonic, char (&buffer)[8], std::string_view& outName, bool& outSuffixed) noexcept
+	{
+		if (mnemonic.empty() || mnemonic.size() > sizeof(buffer))
+			return false;
+		for (size_t i = 0; i < mnemonic.size(); i++)
+			buffer[i] = util::string::ToLower(mnemonic[i]);
+		outName = std::string_view(buffer, mnemonic.size());
+
+		outSuffixed = false;
+		if (size_t dotIndex = outName.find('.'); dotIndex != std::string_view::npos)
+		{
+			std::string_view suffix = outName.substr(dotIndex + 1);
+			if (suffix != "s" && suffix != "l" && suffix != "is" && suffix != "il" &&
+				suffix != "sis" && suffix != "lis" && suffix != "sil" && suffix != "lil")
+				return false;
+			outName = outName.substr(0, dotIndex);
+			outSuffixed = true;
+		}
+		return true;
+	}
+
+	bool LookupInstruction(std::string_view mnemonic, std::span<const std::string_view> operands, InstructionInfo& outInfo) noexcept
+	{
+		if (operands.size() > 2)
+			return false;
+
+		char buffer[8];
+		std::string_view name;
+		bool suffixed;
+		if (!NormalizeMnemonic(mnemonic, buffer, name, suffixed))
+			return false;
+
+		OperandKind k0 = OperandKind_None;
+		OperandKind k1 = OperandKind_None;
+		if (operands.size() > 0)
+			k0 = ClassifyOperand(operands[0]);
+		if (operands.size() > 1)
+			k1 = ClassifyOperand(operands[1]);
+		size_t operandCount = operands.size();
+
+		auto Set = [&outInfo, suffixed](const CostModel& model, uint8_t flags = InstructionFlags_None) noexcept
+		{
+			outInfo.flags = flags;
+			for (AssemblyMode mode = 0; mode < AssemblyMode_Count; mode++)
+			{
+				uint8_t wordSize = s_WordSizes[mode];
+				InstructionCost& cost = outInfo.costs[mode];
+				cost.size = model.opcodeBytes + model.immediateWords * wordSize + suffixed;
+				cost.cycles = static_cast<uint8_t>(cost.size + model.transferBytes + model.transferWords * wordSize + model.extra);
+				cost.takenCycles = static_cast<uint8_t>(cost.cycles + model.takenWords * wordSize + model.takenExtra);
+				if (!(flags & InstructionFlags_Conditional))
+					cost.cycles = cost.takenCycles;
+			}
+			return true;
+		};
+
+		auto IsA = [&operands](size_t index) noexcept { return Is(util::string::TrimBlanks(operands[index]), "a"); };
+		auto IsHL = [&operands](size_t index) noexcept { return Is(util::string::TrimBlanks(operands[index]), "hl"); };
+		auto IsRegister16 = [](OperandKind kind) noexcept { return kind == OperandKind_Register16 || kind == OperandKind_StackPointer; };
+		auto IsRegister8 = [](OperandKind kind) noexcept { return kind == OperandKind_Register8 || kind == OperandKind_IndexHalf; };
+
+		// No operands.
+		if (operandCount == 0)
+		{
+			if (name == "nop" || name == "daa" || name == "cpl" || name == "ccf" || name == "scf" || name == "di" || name == "ei" ||
+				name == "exx" || name == "rlca" || name == "rla" || name == "rrca" || name == "rra")
+				return Set({ .opcodeBytes = 1 });
+			if (name == "halt")
+				return Set({ .opcodeBytes = 1, .extra = 1 });
+			if (name == "neg" || name == "slp" || name == "rsmix" || name == "stmix")
+				return Set({ .opcodeBytes = 2 });
+			if (name == "ret")
+				return Set({ .opcodeBytes = 1, .takenWords = 1, .takenExtra = 2 }, InstructionFlags_Branch);
+			if (name == "reti" || name == "retn")
+				return Set({ .opcodeBytes = 2, .takenWords = 1, .takenExtra = 2 }, InstructionFlags_Branch);
+			if (name == "rld" || name == "rrd")
+				return Set({ .opcodeBytes = 2, .transferBytes = 2, .extra = 1 });
+			if (name == "ldi" || name == "ldd")
+				return Set({ .opcodeBytes = 2, .transferBytes = 2, .extra = 1 });
+			if (name == "ldir" || name == "lddr")
+				return Set({ .opcodeBytes = 2, .transferBytes = 2, .extra = 1 }, InstructionFlags_Repeating);
+			if (name == "cpi" || name == "cpd")
+				return Set({ .opcodeBytes = 2, .transferBytes = 1 });
+			if (name == "cpir" || name == "cpdr")
+				return Set({ .opcodeBytes = 2, .transferBytes = 1 }, InstructionFlags_Repeating);
+			if (name == "ini" || name == "ind" || name == "outi" || name == "outd")
+				return Set({ .opcodeBytes = 2, .transferBytes = 2, .extra = 1 });
+			if (name == "inir" || name == "indr" || name == "otir" || name == "otdr")
+				return Set({ .opcodeBytes = 2, .transferBytes = 2, .extra = 1 }, InstructionFlags_Repeating);
+			return false;
+		}
+
+		// Control flow.
+		if (name == "jp")
+		{
+			if (operandCount == 1)
+			{
+				if (k0 == OperandKind_Immediate)
+					return Set({ .opcodeBytes = 1, .immediateWords = 1, .takenExtra = 1 }, InstructionFlags_Branch);
+				if (k0 == OperandKind_IndirectHL)
+					return Set({ .opcodeBytes = 1, .takenExtra = 2 }, InstructionFlags_Branch);
+				if (k0 == OperandKind_Indexed)
+					return Set({ .opcodeBytes = 2, .takenExtra = 2 }, InstructionFlags_Branch);
+			}
+			else if (IsCondition(operands[0]) && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 1, .immediateWords = 1, .takenExtra = 1 }, InstructionFlags_Branch | InstructionFlags_Conditional);
+			return false;
+		}
+		if (name == "jr")
+		{
+			if (operandCount == 1 && k0 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 2, .takenExtra = 1 }, InstructionFlags_Branch);
+			if (operandCount == 2 && IsShortCondition(operands[0]) && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 2, .takenExtra = 1 }, InstructionFlags_Branch | InstructionFlags_Conditional);
+			return false;
+		}
+		if (name == "djnz")
+		{
+			if (operandCount == 1 && k0 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 2, .extra = 1, .takenExtra = 1 }, InstructionFlags_Branch | InstructionFlags_Conditional);
+			return false;
+		}
+		if (name == "call")
+		{
+			if (operandCount == 1 && k0 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 1, .immediateWords = 1, .takenWords = 1 }, InstructionFlags_Branch);
+			if (operandCount == 2 && IsCondition(operands[0]) && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 1, .immediateWords = 1, .takenWords = 1 }, InstructionFlags_Branch | InstructionFlags_Conditional);
+			return false;
+		}
+		if (name == "ret")
+		{
+			if (operandCount == 1 && IsCondition(operands[0]))
+				return Set({ .opcodeBytes = 1, .extra = 1, .takenWords = 1, .takenExtra = 2 }, InstructionFlags_Branch | InstructionFlags_Conditional);
+			return false;
+		}
+		if (name == "rst")
+		{
+			if (operandCount == 1 && k0 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 1, .takenWords = 1, .takenExtra = 2 }, InstructionFlags_Branch);
+			return false;
+		}
+
+		// Loads.
+		if (name == "ld" && operandCount == 2)
+		{
+			if (IsRegister8(k0) && IsRegister8(k1))
+				return Set({ .opcodeBytes = static_cast<uint8_t>(1 + (k0 == OperandKind_IndexHalf || k1 == OperandKind_IndexHalf)) });
+			if (IsRegister8(k0) && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = static_cast<uint8_t>(2 + (k0 == OperandKind_IndexHalf)) });
+			if ((k0 == OperandKind_Register8 && k1 == OperandKind_IndirectHL) || (k0 == OperandKind_IndirectHL && k1 == OperandKind_Register8))
+				return Set({ .opcodeBytes = 1, .transferBytes = 1 });
+			if (k0 == OperandKind_IndirectHL && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 2, .transferBytes = 1 });
+			if ((k0 == OperandKind_Register8 && k1 == OperandKind_Indexed) || (k0 == OperandKind_Indexed && k1 == OperandKind_Register8))
+				return Set({ .opcodeBytes = 3, .transferBytes = 1 });
+			if (k0 == OperandKind_Indexed && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 4, .transferBytes = 1 });
+			if ((IsA(0) && k1 == OperandKind_IndirectRegister) || (k0 == OperandKind_IndirectRegister && IsA(1)))
+				return Set({ .opcodeBytes = 1, .transferBytes = 1 });
+			if ((IsA(0) && k1 == OperandKind_IndirectImmediate) || (k0 == OperandKind_IndirectImmediate && IsA(1)))
+				return Set({ .opcodeBytes = 1, .immediateWords = 1, .transferBytes = 1 });
+			if ((IsA(0) && k1 == OperandKind_SpecialRegister) || (k0 == OperandKind_SpecialRegister && IsA(1)))
+				return Set({ .opcodeBytes = 2 });
+			if (IsRegister16(k0) && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 1, .immediateWords = 1 });
+			if (k0 == OperandKind_IndexRegister && k1 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 2, .immediateWords = 1 });
+			if ((IsHL(0) && k1 == OperandKind_IndirectImmediate) || (k0 == OperandKind_IndirectImmediate && IsHL(1)))
+				return Set({ .opcodeBytes = 1, .immediateWords = 1, .transferWords = 1 });
+			if (((IsRegister16(k0) || k0 == OperandKind_IndexRegister) && k1 == OperandKind_IndirectImmediate) ||
+				(k0 == OperandKind_IndirectImmediate && (IsRegister16(k1) || k1 == OperandKind_IndexRegister)))
+				return Set({ .opcodeBytes = 2, .immediateWords = 1, .transferWords = 1 });
+			if (((k0 == OperandKind_Register16 || k0 == OperandKind_IndexRegister) && k1 == OperandKind_IndirectHL) ||
+				(k0 == OperandKind_IndirectHL && (k1 == OperandKind_Register16 || k1 == OperandKind_IndexRegister)))
+				return Set({ .opcodeBytes = 2, .transferWords = 1 });
+			if (((k0 == OperandKind_Register16 || k0 == OperandKind_IndexRegister) && k1 == OperandKind_Indexed) ||
+				(k0 == OperandKind_Indexed && (k1 == OperandKind_Register16 || k1 == OperandKind_IndexRegister)))
+				return Set({ .opcodeBytes = 3, .transferWords = 1 });
+			if (k0 == OperandKind_StackPointer && IsHL(1))
+				return Set({ .opcodeBytes = 1 });
+			if (k0 == OperandKind_StackPointer && k1 == OperandKind_IndexRegister)
+				return Set({ .opcodeBytes = 2 });
+			if ((k0 == OperandKind_SpecialRegister && IsHL(1)) || (IsHL(0) && k1 == OperandKind_SpecialRegister))
+				return Set({ .opcodeBytes = 2 });
+			return false;
+		}
+		if (name == "lea" && operandCount == 2)
+		{
+			if ((k0 == OperandKind_Register16 || k0 == OperandKind_IndexRegister) && k1 == OperandKind_IndexOffset)
+				return Set({ .opcodeBytes = 3 });
+			return false;
+		}
+		if (name == "pea")
+		{
+			if (operandCount == 1 && k0 == OperandKind_IndexOffset)
+				return Set({ .opcodeBytes = 3, .transferWords = 1 });
+			return false;
+		}
+		if (name == "push" || name == "pop")
+		{
+			if (operandCount == 1 && (k0 == OperandKind_Register16 || k0 == OperandKind_AccumulatorFlags))
+				return Set({ .opcodeBytes = 1, .transferWords = 1 });
+			if (operandCount == 1 && k0 == OperandKind_IndexRegister)
+				return Set({ .opcodeBytes = 2, .transferWords = 1 });
+			return false;
+		}
+		if (name == "ex" && operandCount == 2)
+		{
+			if ((Is(util::string::TrimBlanks(operands[0]), "de") && IsHL(1)) || (k0 == OperandKind_AccumulatorFlags && k1 == OperandKind_ShadowAF))
+				return Set({ .opcodeBytes = 1 });
+			if (k0 == OperandKind_IndirectSP && IsHL(1))
+				return Set({ .opcodeBytes = 1, .transferWords = 2 });
+			if (k0 == OperandKind_IndirectSP && k1 == OperandKind_IndexRegister)
+				return Set({ .opcodeBytes = 2, .transferWords = 2 });
+			return false;
+		}
+
+		// Arithmetic and logic.
+		if (name == "add" || name == "adc" || name == "sub" || name == "sbc" || name == "and" || name == "xor" || name == "or" || name == "cp" || name == "tst")
+		{
+			// 16 and 24-bit arithmetic.
+			if (operandCount == 2 && (IsHL(0) || k0 == OperandKind_IndexRegister))
+			{
+				if (!IsRegister16(k1) && k1 != OperandKind_IndexRegister)
+					return false;
+				if (name == "add")
+					return Set({ .opcodeBytes = static_cast<uint8_t>(1 + (k0 == OperandKind_IndexRegister)) });
+				if ((name == "adc" || name == "sbc") && k0 != OperandKind_IndexRegister)
+					return Set({ .opcodeBytes = 2 });
+				return false;
+			}
+
+			// The accumulator is implied when there is only one operand.
+			if (operandCount == 2 && !IsA(0))
+				return false;
+			OperandKind source = operandCount == 2 ? k1 : k0;
+			uint8_t prefix = name == "tst";
+
+			if (source == OperandKind_Register8)
+				return Set({ .opcodeBytes = static_cast<uint8_t>(1 + prefix) });
+			if (source == OperandKind_IndexHalf && !prefix)
+				return Set({ .opcodeBytes = 2 });
+			if (source == OperandKind_IndirectHL)
+				return Set({ .opcodeBytes = static_cast<uint8_t>(1 + prefix), .transferBytes = 1 });
+			if (source == OperandKind_Indexed && !prefix)
+				return Set({ .opcodeBytes = 3, .transferBytes = 1 });
+			if (source == OperandKind_Immediate)
+				return Set({ .opcodeBytes = static_cast<uint8_t>(2 + prefix) });
+			return false;
+		}
+		if ((name == "inc" || name == "dec") && operandCount == 1)
+		{
+			if (k0 == OperandKind_Register8 || k0 == OperandKind_Register16 || k0 == OperandKind_StackPointer)
+				return Set({ .opcodeBytes = 1 });
+			if (k0 == OperandKind_IndexHalf || k0 == OperandKind_IndexRegister)
+				return Set({ .opcodeBytes = 2 });
+			if (k0 == OperandKind_IndirectHL)
+				return Set({ .opcodeBytes = 1, .transferBytes = 2, .extra = 1 });
+			if (k0 == OperandKind_Indexed)
+				return Set({ .opcodeBytes = 3, .transferBytes = 2, .extra = 1 });
+			return false;
+		}
+		if (name == "mlt")
+		{
+			if (operandCount == 1 && IsRegister16(k0))
+				return Set({ .opcodeBytes = 2, .extra = 4 });
+			return false;
+		}
+		if (name == "im")
+		{
+			if (operandCount == 1 && k0 == OperandKind_Immediate)
+				return Set({ .opcodeBytes = 2 });
+			return false;
+		}
+
+		// Rotates, shifts and bit operations.
+		if (name == "rlc" || name == "rrc" || name == "rl" || name == "rr" || name == "sla" || name == "sra" || name == "srl")
+		{
+			if (operandCount == 1 && k0 == OperandKind_Register8)
+				return Set({ .opcodeBytes = 2 });
+			if (operandCount == 1 && k0 == OperandKind_IndirectHL)
+				return Set({ .opcodeBytes = 2, .transferBytes = 2, .extra = 1 });
+			if (operandCount == 1 && k0 == OperandKind_Indexed)
+				return Set({ .opcodeBytes = 4, .transferBytes = 2, .extra = 1 });
+			return false;
+		}
+		if ((name == "bit" || name == "set" || name == "res") && operandCount == 2 && k0 == OperandKind_Immediate)
+		{
+			uint8_t writeBack = name != "bit";
+			if (k1 == OperandKind_Register8)
+				return Set({ .opcodeBytes = 2 });
+			if (k1 == OperandKind_IndirectHL)
+				return Set({ .opcodeBytes = 2, .transferBytes = static_cast<uint8_t>(1 + writeBack), .extra = writeBack });
+			if (k1 == OperandKind_Indexed)
+				return Set({ .opcodeBytes = 4, .transferBytes = static_cast<uint8_t>(1 + writeBack), .extra = writeBack });
+			return false;
+		}
+
+		// Input and output, not counting any wait states the port adds.
+		if (name == "in" && operandCount == 2)
+		{
+			if ((IsA(0) && k1 == OperandKind_IndirectImmediate) || (k0 == OperandKind_Register8 && k1 == OperandKind_IndirectC))
+				return Set({ .opcodeBytes = 2, .transferBytes = 1 });
+			return false;
+		}
+		if (name == "out" && operandCount == 2)
+		{
+			if ((k0 == OperandKind_IndirectImmediate && IsA(1)) || (k0 == OperandKind_IndirectC && k1 == OperandKind_Register8))
+				return Set({ .opcodeBytes = 2, .transferBytes = 1 });
+			return false;
+		}
+		if (name == "in0" && operandCount == 2)
+		{
+			if (k0 == OperandKind_Register8 && k1 == OperandKind_IndirectImmediate)
+				return Set({ .opcodeBytes = 3, .transferBytes = 1 });
+			return false;
+		}
+		if (name == "out0" && operandCount == 2)
+		{
+			if (k0 == OperandKind_IndirectImmediate && k1 == OperandKind_Register8)
+				return Set({ .opcodeBytes = 3, .transferBytes = 1 });
+			return false;
+		}
+
+		return false;
+	}
+
+	bool EndsFlow(std::string_view mnemonic, std::span<const std::string_view> operands) noexcept
+	{
+		InstructionInfo info;
+		if (!LookupInstruction(mnemonic, operands, info))
+			return false;
+		if (!(info.flags & InstructionFlags_Branch) || (info.flags & InstructionFlags_Conditional))
+			return false;
+
+		// Calls and rst come back.
+		return !Is(mnemonic.substr(0, 4), "call") && !Is(mnemonic.substr(0, 3), "rst");
+	}
+
+	bool LookupFlagEffects(std::string_view mnemonic, std::span<const std::string_view> operands, uint8_t& outRead, uint8_t& outWritten) noexcept
+	{
+		char buffer[8];
+		std::string_view name;
+		bool suffixed;
+		if (!NormalizeMnemonic(mnemonic, buffer, name, suffixed) || operands.size() > 2)
+			return false;
+
+		constexpr uint8_t allButCarry = CpuFlags_S | CpuFlags_Z | CpuFlags_H | CpuFlags_PV | CpuFlags_N;
+		OperandKind k0 = OperandKind_None;
+		if (operands.size() > 0)
+			k0 = ClassifyOperand(operands[0]);
+		bool wide = k0 == OperandKind_Register16 || k0 == OperandKind_StackPointer || k0 == OperandKind_IndexRegister;
+		bool accumulatorFlags = (operands.size() > 0 && Is(util::string::TrimBlanks(operands[0]), "af"));
+
+		outRead = CpuFlags_None;
+		outWritten = CpuFlags_None;
+
+		if (name == "jp" || name == "jr" || name == "call" || name == "ret")
+		{
+			// Only the tested flag is really read, but every condition is treated as reading all of them.
+			bool conditional = (operands.size() == 2 && name != "ret") || (operands.size() == 1 && name == "ret");
+			if (conditional && IsCondition(operands[0]))
+				outRead = CpuFlags_All;
+			return true;
+		}
+		if (name == "ld")
+		{
+			if (operands.size() == 2 && Is(util::string::TrimBlanks(operands[0]), "a") && ClassifyOperand(operands[1]) == OperandKind_SpecialRegister && !Is(util::string::TrimBlanks(operands[1]), "mb"))
+				outWritten = allButCarry;
+			return true;
+		}
+		if (name == "push" || name == "pop")
+		{
+			if (accumulatorFlags)
+				(name == "push" ? outRead : outWritten) = CpuFlags_All;
+			return true;
+		}
+		if (name == "ex")
+		{
+			if (accumulatorFlags)
+				outRead = outWritten = CpuFlags_All;
+			return true;
+		}
+		if (name == "add" || name == "adc" || name == "sbc")
+		{
+			if (name != "add")
+				outRead = CpuFlags_C;
+			outWritten = wide && name == "add" ? static_cast<uint8_t>(CpuFlags_H | CpuFlags_N | CpuFlags_C) : static_cast<uint8_t>(CpuFlags_All);
+			return true;
+		}
+		if (name == "sub" || name == "and" || name == "xor" || name == "or" || name == "cp" || name == "tst" || name == "neg" ||
+			name == "rlc" || name == "rrc" || name == "sla" || name == "sra" || name == "srl")
+		{
+			outWritten = CpuFlags_All;
+			return true;
+		}
+		if (name == "rl" || name == "rr")
+		{
+			outRead = CpuFlags_C;
+			outWritten = CpuFlags_All;
+			return true;
+		}
+		if (name == "inc" || name == "dec")
+		{
+			if (!wide)
+				outWritten = allButCarry;
+			return true;
+		}
+		if (name == "rlca" || name == "rrca" || name == "scf")
+		{
+			outWritten = CpuFlags_H | CpuFlags_N | CpuFlags_C;
+			return true;
+		}
+		if (name == "rla" || name == "rra" || name == "ccf")
+		{
+			outRead = CpuFlags_C;
+			outWritten = CpuFlags_H | CpuFlags_N | CpuFlags_C;
+			return true;
+		}
+		if (name == "daa")
+		{
+			outRead = CpuFlags_H | CpuFlags_N | CpuFlags_C;
+			outWritten = CpuFlags_All;
+			return true;
+		}
+		if (name == "cpl")
+		{
+			outWritten = CpuFlags_H | CpuFlags_N;
+			return true;
+		}
+		if (name == "bit" || name == "cpi" || name == "cpd" || name == "cpir" || name == "cpdr" || name == "rld" || name == "rrd" || name == "in0" ||
+			(name == "in" && ClassifyOperand(operands.size() > 1 ? operands[1] : std::string_view()) == OperandKind_IndirectC))
+		{
+			outWritten = allButCarry;
+			return true;
+		}
+		if (name == "ldi" || name == "ldd" || name == "ldir" || name == "lddr")
+		{
+			outWritten = CpuFlags_H | CpuFlags_PV | CpuFlags_N;
+			return true;
+		}
+		if (name == "ini" || name == "ind" || name == "outi" || name == "outd" || name == "inir" || name == "indr" || name == "otir" || name == "otdr")
+		{
+			outWritten = CpuFlags_Z | CpuFlags_N;
+			return true;
+		}
+		if (name == "nop" || name == "halt" || name == "slp" || name == "di" || name == "ei" || name == "im" || name == "exx" ||
+			name == "lea" || name == "pea" || name == "mlt" || name == "set" || name == "res" || name == "in" || name == "out" || name == "out0" ||
+			name == "djnz" || name == "rst" || name == "reti" || name == "retn" || name == "rsmix" || name == "stmix")
+			return true;
+
+		return false;
+	}
+
+	bool LookupDataDirective(std::string_view directive, std::span<const std::string_view> operands, InstructionInfo& outInfo) noexcept
+	{
+		uint32_t elementSize;
+		if (Is(directive, ".db"))
+			elementSize = 1;
+		else if (Is(directive, ".dw"))
+			elementSize = 2;
+		else if (Is(directive, ".dl"))
+			elementSize = 3;
+		else
+			return false;
+
+		uint32_t size = 0;
+		for (std::string_view operand : operands)
+		{
+			operand = util::string::TrimBlanks(operand);
+			if (elementSize == 1 && operand.starts_with('"'))
+				size += static_cast<uint32_t>(GetStringLiteralSize(operand));
+			else
+				size += elementSize;
+		}
+
+		outInfo.flags = InstructionFlags_Data;
+		for (auto& cost : outInfo.costs)
+			cost = { size, 0, 0 };
+		return true;
+	}
+
+	size_t GetStringLiteralSize(std::string_view literal) noexcept
+	{
+		size_t size = 0;
+		bool escaped = false;
+		for (size_t i = 1; i < literal.size(); i++)
+		{
+			char c = literal[i];
+			if (escaped)
+			{
+				escaped = false;
+				size++;
+			}
+			else if (c == '\\')
+				escaped = true;
+			else if (c == '"')
+				break;
+			else
+				size++;
+		}
+		return size;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+
+namespace ez80
+{
+	enum AssemblyMode_ : uint8_t
+	{
+		AssemblyMode_ADL = 0, // 24-bit addresses and immediates.
+		AssemblyMode_Z80,     // 16-bit addresses and immediates.
+
+		AssemblyMode_Count
+	};
+	using AssemblyMode = std::underlying_type_t<AssemblyMode_>;
+
+	enum OperandKind_ : uint8_t
+	{
+		OperandKind_None = 0,
+
+		OperandKind_Register8,         // a, b, c, d, e, h, l
+		OperandKind_IndexHalf,         // ixh, ixl, iyh, iyl
+		OperandKind_Register16,        // bc, de, hl
+		OperandKind_StackPointer,      // sp
+		OperandKind_IndexRegister,     // ix, iy
+		OperandKind_AccumulatorFlags,  // af
+		OperandKind_ShadowAF,          // af'
+		OperandKind_SpecialRegister,   // i, r, mb
+		OperandKind_IndirectHL,        // (hl)
+		OperandKind_IndirectRegister,  // (bc), (de)
+		OperandKind_IndirectSP,        // (sp)
+		OperandKind_IndirectC,         // (c)
+		OperandKind_Indexed,           // (ix + d), (iy + d)
+		OperandKind_IndexOffset,       // ix + d, iy + d, used by lea and pea.
+		OperandKind_Immediate,         // Any expression.
+		OperandKind_IndirectImmediate, // (expression)
+	};
+	using OperandKind = std::underlying_type_t<OperandKind_>;
+
+	enum InstructionFlags_ : uint8_t
+	{
+		InstructionFlags_None        = 0,
+		InstructionFlags_Branch      = 1 << 0, // Can transfer control, i.e. jp, jr, djnz, call, ret, rst.
+		InstructionFlags_Conditional = 1 << 1, // Only transfers control sometimes.
+		InstructionFlags_Repeating   = 1 << 2, // Block instructions like ldir, whose costs are per iteration.
+		InstructionFlags_Data        = 1 << 3, // .db, .dw and .dl.
+	};
+
+	enum CpuFlags_ : uint8_t
+	{
+		CpuFlags_None = 0,
+		CpuFlags_C    = 1 << 0,
+		CpuFlags_N    = 1 << 1,
+		CpuFlags_PV   = 1 << 2,
+		CpuFlags_H    = 1 << 4,
+		CpuFlags_Z    = 1 << 6,
+		CpuFlags_S    = 1 << 7,
+		CpuFlags_All  = CpuFlags_C | CpuFlags_N | CpuFlags_PV | CpuFlags_H | CpuFlags_Z | CpuFlags_S,
+	};
+
+	// Cycle counts assume zero wait states, as listed in the eZ80 CPU User Manual.
+	// The eZ80 takes roughly one cycle per opcode byte fetched plus one per data byte transferred,
+	// so the table below is written in those terms, plus any fixed overhead such as pipeline refills.
+	struct InstructionCost
+	{
+		uint32_t size = 0; // Data directives can be arbitrarily large.
+		uint8_t cycles = 0; // When a conditional branch falls through, or the only cost otherwise.
+		uint8_t takenCycles = 0; // When a conditional branch is taken, equal to cycles otherwise.
+	};
+
+	struct InstructionInfo
+	{
+		InstructionCost costs[AssemblyMode_Count];
+		uint8_t flags = InstructionFlags_None;
+	};
+
+	OperandKind ClassifyOperand(std::string_view operand) noexcept;
+	bool IsCondition(std::string_view operand) noexcept;
+
+	// Returns false if the mnemonic or its operands are not a known eZ80 instruction.
+	bool LookupInstruction(std::string_view mnemonic, std::span<const std::string_view> operands, InstructionInfo& outInfo) noexcept;
+
+	// Whether execution can never continue on to the next instruction, i.e. jp, jr and ret without a condition.
+	bool EndsFlow(std::string_view mnemonic, std::span<const std::string_view> operands) noexcept;
+
+	// Which flags an instruction reads and which it overwrites. Returns false if the instruction isn't known.
+	bool LookupFlagEffects(std::string_view mnemonic, std::span<const std::string_view> operands, uint8_t& outRead, uint8_t& outWritten) noexcept;
+
+	// Returns false if the directive is not a data directive.
+	bool LookupDataDirective(std::string_view directive, std::span<const std::string_view> operands, InstructionInfo& outInfo) noexcept;
+
+	// Returns the number of bytes a string literal, including its quotes, will emit.
+	size_t GetStringLiteralSize(std::string_view literal) noexcept;
+}
@@ -0,0 +1,132 @@
+#include "Layout.h"
+#include "SourceScope.h"
+#include "StringUtil.h"
+#include "Profile.h"
+
+namespace ez80
+{
+	void BuildLayout(const std::pmr::vector<TokenizedLine>& tokenizedLines, AssemblyMode mode, uint32_t origin, const ExpressionResolver& resolve, Layout& layout)
+	{
+		PROFILE_FUNCTION();
+
+		SourceScope scope;
+		uint32_t offset = 0;
+		uint32_t addressBase = origin; // The address of offset 0, as of the last .org.
+
+		for (size_t lineIndex = 0; lineIndex < tokenizedLines.size(); lineIndex++)
+		{
+			const TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+
+			SourceScopeEvent event = scope.Visit(tokenizedLine);
+			if (event == SourceScopeEvent_Label)
+				layout.labels.emplace_back(scope.Qualify(GetLabelName(tokenizedLine)), tokenizedLine.number, offset, (addressBase + offset) & 0xFFFFFF);
+			if (event != SourceScopeEvent_None)
+			{
+				if (IsUnsizedLine(tokenizedLine, event))
+					layout.unknownLineCount++;
+				continue;
+			}
+
+			InstructionInfo info;
+			if (LookupDataDirective(tokenizedLine[0], tokenizedLine.Operands(), info) ||
+				LookupInstruction(tokenizedLine[0], tokenizedLine.Operands(), info))
+			{
+				uint32_t size = info.costs[mode].size;
+				layout.lines.emplace_back(lineIndex, tokenizedLine.number, offset, size, (addressBase + offset) & 0xFFFFFF);
+				offset += size;
+			}
+			else if (util::string::EqualsIgnoreCase(tokenizedLine[0], std::string_view(".org")))
+			{
+				int64_t address = 0;
+				if (tokenizedLine.tokenCount == 2 && EvaluateExpression(tokenizedLine[1], resolve, address))
+					addressBase = static_cast<uint32_t>(address) - offset;
+				else
+					layout.unresolvedOrigins.push_back(tokenizedLine.number);
+			}
+			else if (IsUnsizedLine(tokenizedLine, event))
+				layout.unknownLineCount++;
+		}
+
+		layout.size = offset;
+	}
+
+	bool IsUnsizedLine(const TokenizedLine& tokenizedLine, SourceScopeEvent event) noexcept
+	{
+		if (event == SourceScopeEvent_None)
+			return true;
+		if (event != SourceScopeEvent_Preprocessor)
+			return false;
+
+		// Defining macros and values emits nothing, but an include or a conditional can emit anything.
+		std::string_view directive = tokenizedLine[0].substr(1);
+		return directive != "define" && directive != "undef" && directive != "macro" && directive != "endmacro";
+	}
+
+	LineKind FlowScan::Visit(const TokenizedLine& tokenizedLine)
+	{
+		SourceScopeEvent event = scope.Visit(tokenizedLine);
+		switch (event)
+		{
+			case SourceScopeEvent_Label:
+			{
+				fallsThrough = true;
+				hasInstructions = false;
+				afterEmptyLabel = true;
+				return LineKind_Label;
+			}
+			case SourceScopeEvent_NamespaceBegin:
+				return LineKind_NamespaceBegin;
+			case SourceScopeEvent_NamespaceEnd:
+				return LineKind_NamespaceEnd;
+			case SourceScopeEvent_MacroBody:
+				return LineKind_MacroBody;
+			case SourceScopeEvent_Preprocessor:
+			{
+				if (!IsUnsizedLine(tokenizedLine, event))
+					return LineKind_Preprocessor;
+				fallsThrough = true;
+				hasInstructions = true;
+				return LineKind_UnsizedPreprocessor;
+			}
+		}
+
+		std::string_view token0 = tokenizedLine[0];
+		if (LookupDataDirective(token0, tokenizedLine.Operands(), info))
+		{
+			afterEmptyLabel = false;
+			if (!hasInstructions)
+				fallsThrough = false;
+			return LineKind_Data;
+		}
+		if (util::string::EqualsIgnoreCase(token0, std::string_view(".org")))
+			return LineKind_Origin;
+		if (token0.starts_with('.'))
+			return LineKind_Directive;
+
+		afterEmptyLabel = false;
+		hasInstructions = true;
+		if (!LookupInstruction(token0, tokenizedLine.Operands(), info))
+		{
+			fallsThrough = true;
+			return LineKind_MacroInvocation;
+		}
+		fallsThrough = !EndsFlow(token0, tokenizedLine.Operands());
+		return LineKind_Instruction;
+	}
+
+	bool LookupShortBranch(const TokenizedLine& tokenizedLine, InstructionInfo& outShortInfo) noexcept
+	{
+		return util::string::EqualsIgnoreCase(tokenizedLine[0], std::string_view("jp")) && !GetBranchLabel(tokenizedLine).empty() &&
+			LookupInstruction("jr", tokenizedLine.Operands(), outShortInfo);
+	}
+
+	std::string_view GetBranchLabel(const TokenizedLine& tokenizedLine) noexcept
+	{
+		if (tokenizedLine.tokenCount < 2)
+			return {};
+		std::string_view target = tokenizedLine[tokenizedLine.tokenCount - 1];
+		if (ClassifyOperand(target) != OperandKind_Immediate || target.empty() || !(util::string::IsAlpha(target.front()) || target.front() == '_' || target.front() == '.'))
+			return {};
+		return target;
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "Expression.h"
+#include "Instructions.h"
+#include "SourceScope.h"
+#include <string>
+
+namespace ez80
+{
+	// Where the OS runs programs from. Images are loaded 2 bytes before it, so the code after the EF 7B header starts here.
+	constexpr uint32_t UserMem = 0xD1A881;
+	constexpr uint32_t ProgramOrigin = UserMem - 2;
+
+	struct LineLayout
+	{
+		size_t lineIndex = 0; // Into tokenizedLines.
+		size_t lineNumber = 0;
+		uint32_t offset = 0; // From the start of the image.
+		uint32_t size = 0;
+		uint32_t address = 0; // What labels at the line's offset are given, see BuildLayout.
+	};
+
+	struct LabelLayout
+	{
+		std::string name; // Fully qualified.
+		size_t lineNumber = 0;
+		uint32_t offset = 0;
+		uint32_t address = 0;
+	};
+
+	// Where every line and label ends up in the image, derived from instruction sizes.
+	// .org doesn't move anything in the image, it only changes the address labels are given.
+	struct Layout
+	{
+		std::vector<LineLayout> lines; // Every line that emits bytes, in order.
+		std::vector<LabelLayout> labels; // In order.
+		uint32_t size = 0;
+		uint32_t unknownLineCount = 0; // Lines that couldn't be sized, any offset after one is an estimate.
+		std::vector<size_t> unresolvedOrigins; // Line numbers of every .org that couldn't be evaluated, and was ignored.
+	};
+
+	// Addresses start at origin, and each .org sets the address of what follows it to its operand evaluated with resolve.
+	void BuildLayout(const std::pmr::vector<TokenizedLine>& tokenizedLines, AssemblyMode mode, uint32_t origin, const ExpressionResolver& resolve, Layout& layout);
+
+	// For a line that isn't an instruction or data, given what SourceScope::Visit returned for it, whether it can still
+	// emit bytes or move what comes after it, like a macro invocation, an #include, an #if or a .org.
+	// Nothing after one can be placed relative to anything before it.
+	bool IsUnsizedLine(const TokenizedLine& tokenizedLine, SourceScopeEvent event) noexcept;
+
+	enum LineKind_ : uint8_t
+	{
+		LineKind_Label,
+		LineKind_NamespaceBegin,
+		LineKind_NamespaceEnd,
+		LineKind_MacroBody,           // Any line between #macro and #endmacro.
+		LineKind_Preprocessor,        // #define, #undef, #macro and #endmacro, which emit nothing.
+		LineKind_UnsizedPreprocessor, // Any other # line, like an #include or an #if, which can emit anything.
+		LineKind_Origin,              // .org
+		LineKind_Directive,           // Any other directive that isn't data, like .assume.
+		LineKind_Data,
+		LineKind_Instruction,
+		LineKind_MacroInvocation,     // Or anything else that isn't a known instruction.
+	};
+	using LineKind = std::underlying_type_t<LineKind_>;
+
+	// Walks tokenized lines in order, telling what each one is and whether execution can run on past it,
+	// for the passes that split the source at labels and need to know which blocks are fallen into.
+	// Data isn't executed, so a block of only data never runs into the next one, but data after code in the same block
+	// could be an inline argument that execution continues past. The program starts right after the header, so the
+	// block before the first label counts as code. Whatever an #include, an #if or a macro invocation emits is unknown,
+	// so execution is assumed to run on past them, e.g. from either branch of an #if into the label after its #endif.
+	class FlowScan
+	{
+	public:
+		LineKind Visit(const TokenizedLine& tokenizedLine);
+
+		const SourceScope& Scope() const noexcept { return scope; }
+		// Of the last data or instruction line visited.
+		const InstructionInfo& Info() const noexcept { return info; }
+
+		// Whether execution can run from the last line visited into the next one, i.e. whether a label there is fallen into.
+		constexpr bool FallsThrough() const noexcept { return fallsThrough; }
+		// Whether nothing that emits bytes has been visited since the last label. A label with nothing after it is likely used
+		// to find where the block before it ends or the one after it starts, so neither should be moved or folded away.
+		constexpr bool AfterEmptyLabel() const noexcept { return afterEmptyLabel; }
+	private:
+		SourceScope scope;
+		InstructionInfo info;
+		bool fallsThrough = true;
+		bool hasInstructions = true; // Since the last label.
+		bool afterEmptyLabel = false;
+	};
+
+	// For a plain jp to a label, looks up the jr that could stand in for it. Only plain jp, since jp.lil and friends also switch modes.
+	bool LookupShortBranch(const TokenizedLine& tokenizedLine, InstructionInfo& outShortInfo) noexcept;
+
+	// The last operand of a branch, if it could be a label rather than something like (hl) or a constant address,
+	// otherwise an empty string_view.
+	std::string_view GetBranchLabel(const TokenizedLine& tokenizedLine) noexcept;
+}
@@ -0,0 +1,310 @@
+#include "Linker.h"
+#include "EZ80Assembler.h"
+#include "Overlay.h"
+#include "Profile.h"
+#include <span>
+#include <unordered_map>
+
+namespace ez80
+{
+	// Defined in EZ80Assembler.cpp.
+	bool IsOutputFilepathValid(const std::filesystem::path& filepath, wchar_t extensionLetter, std::string_view& outputName);
+	AssemblerError::ID WriteFile(const std::filesystem::path& filepath, std::string_view outputName, uint8_t variableType, const std::vector<uint8_t>& assembly);
+
+	namespace
+	{
+		// Objects placed into one image, the program or one overlay.
+		struct LinkUnit
+		{
+			std::span<const ObjectFile> objectFiles;
+			size_t firstObjectIndex = 0; // Of objectFiles' first, for errors.
+			uint32_t origin = 0;
+			uint32_t end = 0; // Set by PlaceSections.
+			std::vector<std::vector<uint32_t>> sectionAddresses; // Set by PlaceSections.
+		};
+	}
+
+	static LinkerResult PlaceSections(LinkUnit& unit)
+	{
+		LinkerResult result;
+
+		unit.sectionAddresses.assign(unit.objectFiles.size(), {});
+		uint32_t address = unit.origin;
+		for (size_t objectIndex = 0; objectIndex < unit.objectFiles.size(); objectIndex++)
+		{
+			for (const auto& section : unit.objectFiles[objectIndex].sections)
+			{
+				if (section.hasOrigin)
+				{
+					if (section.origin < address)
+						return result.Error({ LinkerError_OverlappingSections, unit.firstObjectIndex + objectIndex, section.name });
+					address = section.origin;
+				}
+				unit.sectionAddresses[objectIndex].push_back(address);
+
+				uint64_t end = static_cast<uint64_t>(address) + section.data.size();
+				if (end > (1 << 24))
+					return result.Error({ LinkerError_AssemblyTooLarge, unit.firstObjectIndex + objectIndex, section.name });
+				address = static_cast<uint32_t>(end);
+			}
+		}
+		unit.end = address;
+		return result;
+	}
+
+	static void CopySections(const LinkUnit& unit, std::vector<uint8_t>& image)
+	{
+		image.assign(unit.end - unit.origin, 0);
+		for (size_t objectIndex = 0; objectIndex < unit.objectFiles.size(); objectIndex++)
+		{
+			const auto& sections = unit.objectFiles[objectIndex].sections;
+			for (size_t sectionIndex = 0; sectionIndex < sections.size(); sectionIndex++)
+				std::copy(sections[sectionIndex].data.begin(), sections[sectionIndex].data.end(), image.begin() + (unit.sectionAddresses[objectIndex][sectionIndex] - unit.origin));
+		}
+	}
+
+	static LinkerResult AddExports(const LinkUnit& unit, std::unordered_map<std::string_view, uint32_t>& exports)
+	{
+		LinkerResult result;
+
+		for (size_t objectIndex = 0; objectIndex < unit.objectFiles.size(); objectIndex++)
+		{
+			for (const auto& symbol : unit.objectFiles[objectIndex].symbols)
+			{
+				if (!symbol.exported || symbol.section == ObjectSymbol::Import)
+					continue;
+				if (!exports.emplace(symbol.name, unit.sectionAddresses[objectIndex][symbol.section] + symbol.offset).second)
+					return result.Error({ LinkerError_DuplicateSymbol, unit.firstObjectIndex + objectIndex, symbol.name });
+			}
+		}
+		return result;
+	}
+
+	// Patches every field that refers to a symbol.
+	static LinkerResult Patch(const LinkUnit& unit, const std::unordered_map<std::string_view, uint32_t>& exports, std::vector<uint8_t>& image)
+	{
+		LinkerResult result;
+
+		for (size_t objectIndex = 0; objectIndex < unit.objectFiles.size(); objectIndex++)
+		{
+			const ObjectFile& objectFile = unit.objectFiles[objectIndex];
+			for (const auto& relocation : objectFile.relocations)
+			{
+				const ObjectSymbol& symbol = objectFile.symbols[relocation.symbol];
+
+				uint32_t symbolAddress;
+				if (symbol.section != ObjectSymbol::Import)
+					symbolAddress = unit.sectionAddresses[objectIndex][symbol.section] + symbol.offset;
+				else if (auto it = exports.find(symbol.name); it != exports.end())
+					symbolAddress = it->second;
+				else
+					return result.Error({ LinkerError_UndefinedSymbol, unit.firstObjectIndex + objectIndex, symbol.name });
+
+				// Fields may hold either signed or unsigned values, like ld a, -1.
+				int64_t value = static_cast<int64_t>(symbolAddress) + relocation.addend;
+				int64_t limit = static_cast<int64_t>(1) << (relocation.width * 8);
+				if (value < -(limit / 2) || value >= limit)
+					return result.Error({ LinkerError_RelocationOutOfRange, unit.firstObjectIndex + objectIndex, symbol.name });
+
+				size_t fieldIndex = unit.sectionAddresses[objectIndex][relocation.section] - unit.origin + relocation.offset;
+				for (uint8_t i = 0; i < relocation.width; i++)
+					image[fieldIndex + i] = static_cast<uint8_t>(value >> (i * 8));
+			}
+		}
+		return result;
+	}
+
+	LinkerResult Link(const std::vector<ObjectFile>& objectFiles, uint32_t origin, std::vector<uint8_t>& image)
+	{
+		PROFILE_FUNCTION();
+
+		LinkUnit unit;
+		unit.objectFiles = objectFiles;
+		unit.origin = origin;
+		if (LinkerResult placeResult = PlaceSections(unit))
+			return placeResult;
+		CopySections(unit, image);
+
+		std::unordered_map<std::string_view, uint32_t> exports;
+		if (LinkerResult exportResult = AddExports(unit, exports))
+			return exportResult;
+
+		LinkerResult result = Patch(unit, exports, image);
+		result.programSize = static_cast<uint32_t>(image.size());
+		return result;
+	}
+
+	LinkerResult LinkOverlays(std::vector<ObjectFile>& objectFiles, std::vector<std::vector<ObjectFile>>& overlays,
+		const std::vector<std::string>& appVarNames, uint32_t origin, std::vector<uint8_t>& image, std::vector<std::vector<uint8_t>>& overlayImages)
+	{
+		PROFILE_FUNCTION();
+
+		LinkerResult result;
+
+		// One less than the indices a byte can hold, which is left for none.
+		if (overlays.size() > 0xFF)
+			return result.Error(LinkerError_TooManyOverlays);
+
+		// Unit 0 is the program, and unit i + 1 is overlay i.
+		auto UnitObjects = [&](size_t unitIndex) -> std::vector<ObjectFile>& { return unitIndex == 0 ? objectFiles : overlays[unitIndex - 1]; };
+		size_t unitCount = overlays.size() + 1;
+		std::vector<size_t> firstObjectIndices(unitCount, 0);
+		for (size_t unitIndex = 1; unitIndex < unitCount; unitIndex++)
+			firstObjectIndices[unitIndex] = firstObjectIndices[unitIndex - 1] + UnitObjects(unitIndex - 1).size();
+
+		// Find which unit defines every exported symbol.
+		std::unordered_map<std::string, size_t> symbolUnits;
+		for (size_t unitIndex = 0; unitIndex < unitCount; unitIndex++)
+		{
+			const std::vector<ObjectFile>& unitObjects = UnitObjects(unitIndex);
+			for (size_t objectIndex = 0; objectIndex < unitObjects.size(); objectIndex++)
+				for (const auto& symbol : unitObjects[objectIndex].symbols)
+					if (symbol.exported && symbol.section != ObjectSymbol::Import && !symbolUnits.emplace(symbol.name, unitIndex).second)
+						return result.Error({ LinkerError_DuplicateSymbol, firstObjectIndices[unitIndex] + objectIndex, symbol.name });
+		}
+
+		// Redirect every call and jump into an overlay from outside of it to the overlay's thunk.
+		std::vector<OverlayThunk> thunks;
+		std::unordered_map<std::string, size_t> thunkIndices; // By target.
+		for (size_t unitIndex = 0; unitIndex < unitCount; unitIndex++)
+		{
+			std::vector<ObjectFile>& unitObjects = UnitObjects(unitIndex);
+			for (size_t objectIndex = 0; objectIndex < unitObjects.size(); objectIndex++)
+			{
+				ObjectFile& objectFile = unitObjects[objectIndex];
+				std::unordered_map<uint32_t, uint32_t> thunkSymbols; // The symbol each symbol is redirected to, in this object.
+				for (auto& relocation : objectFile.relocations)
+				{
+					auto it = thunkSymbols.find(relocation.symbol);
+					if (it == thunkSymbols.end())
+					{
+						const ObjectSymbol& symbol = objectFile.symbols[relocation.symbol];
+						if (symbol.section != ObjectSymbol::Import)
+							continue;
+
+						// Undefined symbols are reported once everything is placed.
+						auto unit = symbolUnits.find(symbol.name);
+						if (unit == symbolUnits.end() || unit->second == 0 || unit->second == unitIndex)
+							continue;
+
+						auto [thunk, inserted] = thunkIndices.try_emplace(symbol.name, thunks.size());
+						if (inserted)
+							thunks.push_back({ symbol.name, static_cast<uint8_t>(unit->second - 1) });
+
+						ObjectSymbol thunkSymbol{ std::string(OverlayThunkPrefix) + symbol.name };
+						objectFile.symbols.push_back(std::move(thunkSymbol));
+						it = thunkSymbols.emplace(relocation.symbol, static_cast<uint32_t>(objectFile.symbols.size() - 1)).first;
+					}
+
+					// The thunk has to be called in place of the symbol, so nothing else can use its address.
+					const std::vector<uint8_t>& data = objectFile.sections[relocation.section].data;
+					if (relocation.width != 3 || relocation.addend != 0 || relocation.offset == 0 || !IsCallOrJump(data[relocation.offset - 1]))
+						return result.Error({ LinkerError_CrossOverlayReference, firstObjectIndices[unitIndex] + objectIndex, objectFile.symbols[relocation.symbol].name });
+					relocation.symbol = it->second;
+				}
+			}
+		}
+
+		// The runtime is the end of the program, where the overlays are loaded, so it's placed before its size is known.
+		// Its code doesn't depend on the size, so it's built again once it is, without moving anything.
+		BuildOverlayRuntime(appVarNames, thunks, 0, objectFiles.emplace_back());
+		std::vector<LinkUnit> units(unitCount);
+		for (size_t unitIndex = 0; unitIndex < unitCount; unitIndex++)
+		{
+			LinkUnit& unit = units[unitIndex];
+			unit.objectFiles = UnitObjects(unitIndex);
+			unit.firstObjectIndex = firstObjectIndices[unitIndex];
+			unit.origin = unitIndex == 0 ? origin : units[0].end;
+			if (LinkerResult placeResult = PlaceSections(unit))
+				return placeResult;
+			if (unitIndex > 0)
+				result.overlayAreaSize = std::max(result.overlayAreaSize, unit.end - unit.origin);
+		}
+		objectFiles.back() = {};
+		BuildOverlayRuntime(appVarNames, thunks, result.overlayAreaSize, objectFiles.back());
+
+		std::unordered_map<std::string_view, uint32_t> exports;
+		for (const LinkUnit& unit : units)
+			if (LinkerResult exportResult = AddExports(unit, exports))
+				return exportResult;
+
+		overlayImages.resize(overlays.size());
+		for (size_t unitIndex = 0; unitIndex < unitCount; unitIndex++)
+		{
+			std::vector<uint8_t>& unitImage = unitIndex == 0 ? image : overlayImages[unitIndex - 1];
+			CopySections(units[unitIndex], unitImage);
+			if (LinkerResult patchResult = Patch(units[unitIndex], exports, unitImage))
+				return patchResult;
+		}
+
+		result.programSize = static_cast<uint32_t>(image.size());
+		result.thunkCount = static_cast<uint32_t>(thunks.size());
+		return result;
+	}
+
+	static LinkerError::ID ToLinkerError(AssemblerError::ID error) noexcept
+	{
+		switch (error)
+		{
+			case AssemblerError_AssemblyEmpty: return LinkerError_AssemblyEmpty;
+			case AssemblerError_AssemblyTooLarge: return LinkerError_AssemblyTooLarge;
+			case AssemblerError_FailedToWriteOutputFile: return LinkerError_FailedToWriteOutputFile;
+		}
+		return LinkerError_None;
+	}
+
+	LinkerResult Link(const LinkerInfo& info)
+	{
+		PROFILE_FUNCTION();
+
+		LinkerResult result;
+
+		std::string_view outputName;
+		if (!IsOutputFilepathValid(info.outputFilepath, L'p', outputName))
+			return result.Error(LinkerError_OutputFileNameInvalid);
+		std::string programName(outputName); // outputName is overwritten by the next name checked.
+
+		std::vector<std::string> appVarNames;
+		for (const LinkerOverlay& overlay : info.overlays)
+		{
+			if (!IsOutputFilepathValid(overlay.outputFilepath, L'v', outputName))
+				return result.Error(LinkerError_OverlayFileNameInvalid);
+			appVarNames.emplace_back(outputName);
+		}
+
+		size_t objectIndex = 0;
+		auto ReadObjectFiles = [&objectIndex](const std::vector<std::filesystem::path>& objectFilepaths, std::vector<ObjectFile>& objectFiles)
+		{
+			objectFiles.resize(objectFilepaths.size());
+			for (size_t i = 0; i < objectFiles.size(); i++, objectIndex++)
+				if (!ReadObjectFile(objectFilepaths[i], objectFiles[i]))
+					return false;
+			return true;
+		};
+
+		std::vector<ObjectFile> objectFiles;
+		std::vector<std::vector<ObjectFile>> overlays(info.overlays.size());
+		if (!ReadObjectFiles(info.objectFilepaths, objectFiles))
+			return result.Error({ LinkerError_FailedToReadObjectFile, objectIndex });
+		for (size_t overlayIndex = 0; overlayIndex < overlays.size(); overlayIndex++)
+			if (!ReadObjectFiles(info.overlays[overlayIndex].objectFilepaths, overlays[overlayIndex]))
+				return result.Error({ LinkerError_FailedToReadObjectFile, objectIndex });
+
+		std::vector<uint8_t> image;
+		std::vector<std::vector<uint8_t>> overlayImages;
+		if (overlays.empty())
+			result = Link(objectFiles, info.origin, image);
+		else
+			result = LinkOverlays(objectFiles, overlays, appVarNames, info.origin, image, overlayImages);
+		if (result)
+			return result;
+
+		if (auto error = ToLinkerError(WriteFile(info.outputFilepath, programName, ProtectedProgramType, image)))
+			return result.Error(error);
+		for (size_t overlayIndex = 0; overlayIndex < overlays.size(); overlayIndex++)
+			if (auto error = ToLinkerError(WriteFile(info.overlays[overlayIndex].outputFilepath, appVarNames[overlayIndex], AppVarType, overlayImages[overlayIndex])))
+				return result.Error(error);
+
+		return result;
+	}
+}
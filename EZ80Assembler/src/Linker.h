@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Layout.h"
+#include "ObjectFile.h"
+
+namespace ez80
+{
+	enum LinkerError_ : uint32_t
+	{
+		LinkerError_None = 0,
+
+		LinkerError_OutputFileNameInvalid,
+		LinkerError_FailedToReadObjectFile,
+		LinkerError_DuplicateSymbol,
+		LinkerError_UndefinedSymbol,
+		LinkerError_OverlappingSections, // A .org points before the end of what was placed before it.
+		LinkerError_RelocationOutOfRange, // The symbol's address doesn't fit in the field.
+		LinkerError_OverlayFileNameInvalid, // Overlays are AppVars, so their output files need a .8xv extension.
+		LinkerError_TooManyOverlays,
+		LinkerError_CrossOverlayReference, // Only calls and jumps can reach a symbol in another overlay.
+
+		// At the very end of the error list. (approximately ordered in the order they can happen in)
+		LinkerError_AssemblyEmpty,
+		LinkerError_AssemblyTooLarge,
+		LinkerError_FailedToWriteOutputFile,
+	};
+	struct LinkerError
+	{
+		using ID = std::underlying_type_t<LinkerError_>;
+
+		LinkerError(ID id = 0, size_t objectIndex = 0, std::string_view symbol = {})
+			: id(id), objectIndex(objectIndex), symbol(symbol) {}
+
+		constexpr operator ID() const noexcept { return id; }
+
+		ID id = 0;
+		size_t objectIndex = 0; // Into LinkerInfo::objectFilepaths, then on through every overlay's objectFilepaths in order.
+		std::string symbol;
+	};
+
+	struct LinkerResult
+	{
+		LinkerResult& Error(LinkerError error) noexcept { this->error = std::move(error); return *this; }
+		explicit constexpr operator bool() const noexcept { return error != LinkerError_None; }
+
+		// Only the first error is reported.
+		LinkerError error = LinkerError_None;
+
+		uint32_t programSize = 0; // Including the overlay runtime, if there are overlays.
+		uint32_t overlayAreaSize = 0; // Of the largest overlay.
+		uint32_t thunkCount = 0;
+	};
+
+	// Linked on its own at the end of the program, and loaded there from its AppVar when something it defines is called.
+	struct LinkerOverlay
+	{
+		std::vector<std::filesystem::path> objectFilepaths; // Placed in this order.
+		std::filesystem::path outputFilepath; // .8xv
+	};
+
+	struct LinkerInfo
+	{
+		std::vector<std::filesystem::path> objectFilepaths; // Placed in this order.
+		std::filesystem::path outputFilepath;
+		uint32_t origin = ProgramOrigin; // Where the image is loaded.
+		std::vector<LinkerOverlay> overlays; // For programs too large for one variable, see LinkOverlays.
+	};
+
+	// Places every section of every object, resolves exported labels and writes the program.
+	// Sections without a .org follow the one before them, across objects, and any gap left by a .org is zero filled.
+	LinkerResult Link(const LinkerInfo& info);
+
+	// The same as Link, for objects that are already in memory.
+	LinkerResult Link(const std::vector<ObjectFile>& objectFiles, uint32_t origin, std::vector<uint8_t>& image);
+
+	// The same as Link, with overlays, for objects that are already in memory. Each overlay is linked to run from right after
+	// the program, where only one is loaded at a time, and is named by the AppVar in appVarNames at the same index.
+	// Every call or jump into an overlay from outside of it is redirected to a thunk that loads it first,
+	// see BuildOverlayRuntime, and the runtime holding them is appended to objectFiles.
+	LinkerResult LinkOverlays(std::vector<ObjectFile>& objectFiles, std::vector<std::vector<ObjectFile>>& overlays,
+		const std::vector<std::string>& appVarNames, uint32_t origin, std::vector<uint8_t>& image, std::vector<std::vector<uint8_t>>& overlayImages);
+}
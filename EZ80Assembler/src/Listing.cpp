@@ -0,0 +1,228 @@
+#include "Listing.h"
+#include "Expression.h"
+#include "PlatformSymbols.h"
+#include "Profile.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace ez80
+{
+	// BufferedFileWriter writes its buffer out whenever it grows past this.
+	static constexpr size_t s_BufferSize = 1 << 20;
+
+	// Bytes shown per line, longer lines end with a + instead.
+	static constexpr size_t s_ListingBytesShown = 4;
+
+	static constexpr char s_HexDigits[] = "0123456789ABCDEF";
+
+	// Right aligned, in a field of digits characters.
+	static void FormatHex(char* field, uint32_t value, size_t digits) noexcept
+	{
+		while (digits--)
+		{
+			field[digits] = s_HexDigits[value & 0xF];
+			value >>= 4;
+		}
+	}
+
+	// Right aligned, in a field of width characters already filled with spaces.
+	static void FormatDecimal(char* field, uint64_t value, size_t width) noexcept
+	{
+		do
+		{
+			field[--width] = static_cast<char>('0' + value % 10);
+			value /= 10;
+		}
+		while (value && width);
+	}
+
+	static void AppendHex(std::string& buffer, uint32_t value, size_t digits)
+	{
+		char field[8];
+		FormatHex(field, value, digits);
+		buffer.append(field, digits);
+	}
+
+	bool BufferedFileWriter::Open(const std::filesystem::path& filepath)
+	{
+		file.open(filepath, std::ios::binary);
+		buffer.reserve(s_BufferSize);
+		return file.is_open();
+	}
+
+	void BufferedFileWriter::Commit()
+	{
+		if (buffer.size() >= s_BufferSize)
+			Flush();
+	}
+
+	bool BufferedFileWriter::Close()
+	{
+		Flush();
+		file.close();
+		return !file.fail();
+	}
+
+	void BufferedFileWriter::Flush()
+	{
+		file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		buffer.clear();
+	}
+
+	bool ListingWriter::Open(const std::filesystem::path& filepath)
+	{
+		if (!writer.Open(filepath))
+			return false;
+		writer.Buffer() += "   line address    size  bytes         source\n";
+		return true;
+	}
+
+	void ListingWriter::WriteLine(const ListingLine& line)
+	{
+		// Every column before the source is a fixed width, so they're formatted in place instead of appended piecemeal.
+		//	"   line address    size  bytes         "
+		char columns[7 + 8 + 8 + 2 + s_ListingBytesShown * 3 + 2];
+		std::fill(std::begin(columns), std::end(columns), ' ');
+		FormatDecimal(columns, line.lineNumber + 1, 7);
+		if (line.hasAddress)
+		{
+			FormatHex(columns + 9, line.address, 6);
+			FormatDecimal(columns + 16, line.size, 7);
+
+			size_t shown = std::min(line.bytes.size(), s_ListingBytesShown);
+			for (size_t i = 0; i < shown; i++)
+				FormatHex(columns + 25 + i * 3, line.bytes[i], 2);
+			if (line.size > shown && !line.bytes.empty())
+				columns[25 + s_ListingBytesShown * 3] = '+';
+		}
+
+		std::string& buffer = writer.Buffer();
+		buffer.append(columns, sizeof(columns));
+		buffer += line.source;
+		buffer += '\n';
+		writer.Commit();
+	}
+
+	// Indices into entries, sorted by line number, keeping the order of entries on the same line.
+	template<typename T>
+	static std::vector<uint32_t> LineOrder(const std::vector<T>& entries)
+	{
+		std::vector<uint32_t> order(entries.size());
+		for (uint32_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return entries[a].lineNumber < entries[b].lineNumber; });
+		return order;
+	}
+
+	bool WriteListing(const std::filesystem::path& filepath, const std::pmr::vector<std::string_view>& lines, const Layout& layout, const std::vector<uint8_t>& assembly)
+	{
+		PROFILE_FUNCTION();
+
+		ListingWriter writer;
+		if (!writer.Open(filepath))
+			return false;
+
+		// Both are walked alongside the source in line order, which is address order unless OrderRoutinesByProfile
+		// moved something. Labels are statements of their own, so a line can have both a label and an instruction, at the same offset.
+		std::vector<uint32_t> labelOrder = LineOrder(layout.labels);
+		std::vector<uint32_t> layoutOrder = LineOrder(layout.lines);
+		size_t labelIndex = 0;
+		size_t layoutIndex = 0;
+		for (size_t lineNumber = 0; lineNumber < lines.size(); lineNumber++)
+		{
+			ListingLine line;
+			line.lineNumber = lineNumber;
+			line.source = lines[lineNumber];
+
+			uint32_t offset = 0;
+			for (; labelIndex < labelOrder.size() && layout.labels[labelOrder[labelIndex]].lineNumber <= lineNumber; labelIndex++)
+			{
+				const LabelLayout& label = layout.labels[labelOrder[labelIndex]];
+				offset = label.offset;
+				line.address = label.address;
+				line.hasAddress = true;
+			}
+			for (; layoutIndex < layoutOrder.size() && layout.lines[layoutOrder[layoutIndex]].lineNumber <= lineNumber; layoutIndex++)
+			{
+				const LineLayout& lineLayout = layout.lines[layoutOrder[layoutIndex]];
+				if (!line.hasAddress)
+				{
+					offset = lineLayout.offset;
+					line.address = lineLayout.address;
+				}
+				line.hasAddress = true;
+				line.size += lineLayout.size;
+			}
+
+			if (offset < assembly.size())
+				line.bytes = std::span(assembly).subspan(offset, std::min<size_t>(line.size, assembly.size() - offset));
+			writer.WriteLine(line);
+		}
+
+		return writer.Close();
+	}
+
+	bool WriteSymbolMap(const std::filesystem::path& filepath, const Layout& layout, const std::pmr::vector<Equate>& equates, bool platformSymbols)
+	{
+		PROFILE_FUNCTION();
+
+		BufferedFileWriter writer;
+		if (!writer.Open(filepath))
+			return false;
+		std::string& buffer = writer.Buffer();
+
+		// A .org can move addresses back, so labels aren't always in address order already.
+		std::vector<uint32_t> sortedLabels(layout.labels.size());
+		for (uint32_t i = 0; i < sortedLabels.size(); i++)
+			sortedLabels[i] = i;
+		std::stable_sort(sortedLabels.begin(), sortedLabels.end(), [&layout](uint32_t left, uint32_t right) { return layout.labels[left].address < layout.labels[right].address; });
+
+		std::unordered_map<std::string_view, uint32_t> labelAddresses;
+		labelAddresses.reserve(layout.labels.size());
+		buffer += "; Labels, by address.\n";
+		for (uint32_t index : sortedLabels)
+		{
+			const LabelLayout& label = layout.labels[index];
+			labelAddresses.emplace(label.name, label.address);
+
+			AppendHex(buffer, label.address, 6);
+			buffer += "  ";
+			buffer += label.name;
+			buffer += '\n';
+			writer.Commit();
+		}
+
+		// Equates can use each other and labels in any order, so each is evaluated when it's first needed.
+		EquateResolver resolver(equates, [&](std::string_view identifier, int64_t& outValue)
+		{
+			if (auto label = labelAddresses.find(identifier); label != labelAddresses.end())
+			{
+				outValue = label->second;
+				return true;
+			}
+			return platformSymbols && FindPlatformSymbol(identifier, outValue);
+		});
+
+		std::vector<size_t> sortedEquates(equates.size());
+		for (size_t i = 0; i < equates.size(); i++)
+			sortedEquates[i] = i;
+		std::sort(sortedEquates.begin(), sortedEquates.end(), [&equates](size_t left, size_t right) { return equates[left].identifier < equates[right].identifier; });
+
+		buffer += "\n; Equates, by name.\n";
+		for (size_t index : sortedEquates)
+		{
+			if (int64_t value = 0; resolver.Evaluate(index, value))
+				AppendHex(buffer, static_cast<uint32_t>(value) & 0xFFFFFF, 6);
+			else
+				buffer += "     ?";
+			buffer += "  ";
+			buffer += equates[index].identifier;
+			buffer += " = ";
+			buffer += equates[index].value;
+			buffer += '\n';
+			writer.Commit();
+		}
+
+		return writer.Close();
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "Layout.h"
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+
+namespace ez80
+{
+	struct ListingLine
+	{
+		size_t lineNumber = 0;
+		std::string_view source;
+		bool hasAddress = false; // Only lines that emit bytes or define a label have one.
+		uint32_t address = 0;
+		uint32_t size = 0;
+		std::span<const uint8_t> bytes; // Shorter than size for lines that weren't encoded.
+	};
+
+	// Output is appended to a buffer large enough that the file is rarely written to,
+	// so that memory use doesn't grow with the output.
+	class BufferedFileWriter
+	{
+	public:
+		bool Open(const std::filesystem::path& filepath);
+
+		// Append to the buffer, then call Commit.
+		std::string& Buffer() noexcept { return buffer; }
+		void Commit();
+
+		// Returns false if anything failed to write.
+		bool Close();
+	private:
+		void Flush();
+
+		std::ofstream file;
+		std::string buffer;
+	};
+
+	class ListingWriter
+	{
+	public:
+		bool Open(const std::filesystem::path& filepath);
+		void WriteLine(const ListingLine& line);
+		bool Close() { return writer.Close(); }
+	private:
+		BufferedFileWriter writer;
+	};
+
+	// Pairs every source line with its address and size from the layout, and the bytes it assembled to.
+	bool WriteListing(const std::filesystem::path& filepath, const std::pmr::vector<std::string_view>& lines, const Layout& layout, const std::vector<uint8_t>& assembly);
+
+	// Labels in address order, then equates by name, with their values where they can be evaluated.
+	// With platformSymbols, names that aren't equates or labels are looked up with FindPlatformSymbol.
+	bool WriteSymbolMap(const std::filesystem::path& filepath, const Layout& layout, const std::pmr::vector<Equate>& equates, bool platformSymbols);
+}
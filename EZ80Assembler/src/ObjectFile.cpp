@@ -0,0 +1,286 @@
+#include "ObjectFile.h"
+#include "AssemblerStringUtil.h"
+#include "Expression.h"
+#include "Instructions.h"
+#include "SourceScope.h"
+#include "StringUtil.h"
+#include "Profile.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+namespace ez80
+{
+	static constexpr char s_Magic[4] = { 'E', 'Z', '8', 'O' };
+	static constexpr uint8_t s_Version = 1;
+
+	static void WriteUnsigned(std::vector<uint8_t>& bytes, uint64_t value)
+	{
+		do
+		{
+			uint8_t byte = value & 0x7F;
+			value >>= 7;
+			bytes.push_back(byte | (value ? 0x80 : 0x00));
+		}
+		while (value);
+	}
+
+	static void WriteSigned(std::vector<uint8_t>& bytes, int64_t value)
+	{
+		// Zigzag, so small negative numbers stay small.
+		WriteUnsigned(bytes, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+	}
+
+	static void WriteString(std::vector<uint8_t>& bytes, std::string_view string)
+	{
+		WriteUnsigned(bytes, string.size());
+		bytes.insert(bytes.end(), string.begin(), string.end());
+	}
+
+	class ObjectReader
+	{
+	public:
+		ObjectReader(const std::vector<uint8_t>& bytes) noexcept
+			: bytes(bytes) {}
+
+		bool ReadUnsigned(uint64_t& value) noexcept
+		{
+			value = 0;
+			for (uint32_t shift = 0; shift < 64; shift += 7)
+			{
+				if (index >= bytes.size())
+					return false;
+				uint8_t byte = bytes[index++];
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if (!(byte & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		template<typename Integral>
+		bool ReadUnsigned(Integral& value) noexcept
+		{
+			uint64_t wide;
+			if (!ReadUnsigned(wide) || wide > static_cast<uint64_t>(std::numeric_limits<Integral>::max()))
+				return false;
+			value = static_cast<Integral>(wide);
+			return true;
+		}
+
+		bool ReadSigned(int32_t& value) noexcept
+		{
+			uint64_t zigzag;
+			if (!ReadUnsigned(zigzag))
+				return false;
+			int64_t wide = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+			if (wide < INT32_MIN || wide > INT32_MAX)
+				return false;
+			value = static_cast<int32_t>(wide);
+			return true;
+		}
+
+		bool ReadBytes(size_t count, const uint8_t*& data) noexcept
+		{
+			if (count > bytes.size() - index)
+				return false;
+			data = bytes.data() + index;
+			index += count;
+			return true;
+		}
+
+		bool ReadString(std::string& string)
+		{
+			size_t size;
+			const uint8_t* data;
+			if (!ReadUnsigned(size) || !ReadBytes(size, data))
+				return false;
+			string.assign(reinterpret_cast<const char*>(data), size);
+			return true;
+		}
+
+		constexpr bool AtEnd() const noexcept { return index == bytes.size(); }
+	private:
+		const std::vector<uint8_t>& bytes;
+		size_t index = 0;
+	};
+
+	void BuildObjectFile(const std::pmr::vector<TokenizedLine>& tokenizedLines, const std::vector<uint8_t>& assembly, const ExpressionResolver& resolve,
+		ObjectFile& objectFile, std::vector<size_t>& outUnresolvedOrigins)
+	{
+		PROFILE_FUNCTION();
+
+		SourceScope scope;
+		uint32_t offset = 0;
+		uint32_t sectionStart = 0;
+		objectFile.sections.emplace_back().name = "code";
+
+		auto EndSection = [&]()
+		{
+			// Lines that couldn't be sized make offset an estimate, so never read past what was generated.
+			size_t begin = std::min<size_t>(sectionStart, assembly.size());
+			size_t end = std::min<size_t>(offset, assembly.size());
+			objectFile.sections.back().data.assign(assembly.begin() + begin, assembly.begin() + end);
+		};
+
+		for (const auto& tokenizedLine : tokenizedLines)
+		{
+			SourceScopeEvent event = scope.Visit(tokenizedLine);
+			if (event == SourceScopeEvent_Label)
+			{
+				std::string_view name = GetLabelName(tokenizedLine);
+				auto& symbol = objectFile.symbols.emplace_back();
+				symbol.name = scope.Qualify(name);
+				symbol.section = static_cast<uint32_t>(objectFile.sections.size() - 1);
+				symbol.offset = offset - sectionStart;
+				symbol.exported = !name.starts_with('.');
+			}
+			if (event != SourceScopeEvent_None)
+				continue;
+
+			std::string_view token0 = tokenizedLine[0];
+			if (util::string::EqualsIgnoreCase(token0, std::string_view(".org")))
+			{
+				int64_t origin = 0;
+				if (tokenizedLine.tokenCount != 2 || !EvaluateExpression(tokenizedLine[1], resolve, origin))
+				{
+					outUnresolvedOrigins.push_back(tokenizedLine.number);
+					continue;
+				}
+
+				EndSection();
+
+				// Nothing was placed in the current section yet, so the .org can apply to it instead.
+				if (offset != sectionStart)
+					objectFile.sections.emplace_back().name = "code";
+				sectionStart = offset;
+
+				objectFile.sections.back().hasOrigin = true;
+				objectFile.sections.back().origin = static_cast<uint32_t>(origin) & 0xFFFFFF;
+				continue;
+			}
+
+			InstructionInfo info;
+			if (LookupDataDirective(token0, tokenizedLine.Operands(), info) || LookupInstruction(token0, tokenizedLine.Operands(), info))
+				offset += info.costs[AssemblyMode_ADL].size;
+		}
+
+		EndSection();
+	}
+
+	bool WriteObjectFile(const std::filesystem::path& filepath, const ObjectFile& objectFile)
+	{
+		PROFILE_FUNCTION();
+
+		std::vector<uint8_t> bytes(std::begin(s_Magic), std::end(s_Magic));
+		bytes.push_back(s_Version);
+
+		WriteUnsigned(bytes, objectFile.sections.size());
+		for (const auto& section : objectFile.sections)
+		{
+			WriteString(bytes, section.name);
+			bytes.push_back(section.hasOrigin);
+			if (section.hasOrigin)
+				WriteUnsigned(bytes, section.origin);
+			WriteUnsigned(bytes, section.data.size());
+			bytes.insert(bytes.end(), section.data.begin(), section.data.end());
+		}
+
+		// Imports are stored with section 0, everything else with its section + 1.
+		WriteUnsigned(bytes, objectFile.symbols.size());
+		for (const auto& symbol : objectFile.symbols)
+		{
+			WriteString(bytes, symbol.name);
+			WriteUnsigned(bytes, symbol.section == ObjectSymbol::Import ? 0 : static_cast<uint64_t>(symbol.section) + 1);
+			WriteUnsigned(bytes, symbol.offset);
+			bytes.push_back(symbol.exported);
+		}
+
+		WriteUnsigned(bytes, objectFile.relocations.size());
+		for (const auto& relocation : objectFile.relocations)
+		{
+			WriteUnsigned(bytes, relocation.section);
+			WriteUnsigned(bytes, relocation.offset);
+			bytes.push_back(relocation.width);
+			WriteUnsigned(bytes, relocation.symbol);
+			WriteSigned(bytes, relocation.addend);
+		}
+
+		std::ofstream file(filepath, std::ios::binary);
+		if (!file.is_open())
+			return false;
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		return file.good();
+	}
+
+	bool ReadObjectFile(const std::filesystem::path& filepath, ObjectFile& objectFile)
+	{
+		PROFILE_FUNCTION();
+
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file.is_open())
+			return false;
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		ObjectReader reader(bytes);
+		const uint8_t* header;
+		if (!reader.ReadBytes(sizeof(s_Magic) + 1, header) || !std::equal(std::begin(s_Magic), std::end(s_Magic), header) || header[sizeof(s_Magic)] != s_Version)
+			return false;
+
+		// Counts are checked against what's left, so a corrupt file can't make these allocate too much.
+		size_t sectionCount;
+		if (!reader.ReadUnsigned(sectionCount) || sectionCount > bytes.size())
+			return false;
+		objectFile.sections.resize(sectionCount);
+		for (auto& section : objectFile.sections)
+		{
+			const uint8_t* hasOrigin;
+			if (!reader.ReadString(section.name) || !reader.ReadBytes(1, hasOrigin))
+				return false;
+			section.hasOrigin = *hasOrigin;
+			if (section.hasOrigin && !reader.ReadUnsigned(section.origin))
+				return false;
+
+			size_t size;
+			const uint8_t* data;
+			if (!reader.ReadUnsigned(size) || !reader.ReadBytes(size, data))
+				return false;
+			section.data.assign(data, data + size);
+		}
+
+		size_t symbolCount;
+		if (!reader.ReadUnsigned(symbolCount) || symbolCount > bytes.size())
+			return false;
+		objectFile.symbols.resize(symbolCount);
+		for (auto& symbol : objectFile.symbols)
+		{
+			const uint8_t* exported;
+			if (!reader.ReadString(symbol.name) || !reader.ReadUnsigned(symbol.section) || !reader.ReadUnsigned(symbol.offset) || !reader.ReadBytes(1, exported))
+				return false;
+			if (symbol.section > sectionCount)
+				return false;
+			symbol.section = symbol.section == 0 ? ObjectSymbol::Import : symbol.section - 1;
+			symbol.exported = *exported;
+		}
+
+		size_t relocationCount;
+		if (!reader.ReadUnsigned(relocationCount) || relocationCount > bytes.size())
+			return false;
+		objectFile.relocations.resize(relocationCount);
+		for (auto& relocation : objectFile.relocations)
+		{
+			const uint8_t* width;
+			if (!reader.ReadUnsigned(relocation.section) || !reader.ReadUnsigned(relocation.offset) || !reader.ReadBytes(1, width) ||
+				!reader.ReadUnsigned(relocation.symbol) || !reader.ReadSigned(relocation.addend))
+				return false;
+			relocation.width = *width;
+
+			if (relocation.section >= sectionCount || relocation.symbol >= symbolCount || relocation.width < 1 || relocation.width > 3 ||
+				static_cast<uint64_t>(relocation.offset) + relocation.width > objectFile.sections[relocation.section].data.size())
+				return false;
+		}
+
+		return reader.AtEnd();
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "Expression.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ez80
+{
+	// Types of the variables images are written as.
+	constexpr uint8_t ProtectedProgramType = 0x06;
+	constexpr uint8_t AppVarType = 0x15;
+
+	struct ObjectSection
+	{
+		std::string name;
+		std::vector<uint8_t> data;
+		bool hasOrigin = false; // Set by .org, otherwise the section follows the previous one.
+		uint32_t origin = 0;
+	};
+
+	struct ObjectSymbol
+	{
+		static constexpr uint32_t Import = static_cast<uint32_t>(-1); // Defined by another object.
+
+		std::string name;
+		uint32_t section = Import;
+		uint32_t offset = 0; // From the start of the section.
+		bool exported = false;
+	};
+
+	struct ObjectRelocation
+	{
+		uint32_t section = 0;
+		uint32_t offset = 0; // Of the field, from the start of the section.
+		uint8_t width = 3; // Of the field in bytes, 1, 2 or 3.
+		uint32_t symbol = 0; // Into ObjectFile::symbols.
+		int32_t addend = 0;
+	};
+
+	// What one .asm assembles into, before its addresses are known.
+	struct ObjectFile
+	{
+		std::vector<ObjectSection> sections;
+		std::vector<ObjectSymbol> symbols;
+		std::vector<ObjectRelocation> relocations;
+	};
+
+	// Splits the program into a section per .org, and lists every label as a symbol.
+	// Labels starting with a dot are local to the object, every other label is exported.
+	// A .org whose operand can't be evaluated doesn't start a section, its line number is added to outUnresolvedOrigins.
+	// No relocations are made yet, since which operands refer to labels is only known once byte code is generated.
+	void BuildObjectFile(const std::pmr::vector<TokenizedLine>& tokenizedLines, const std::vector<uint8_t>& assembly, const ExpressionResolver& resolve,
+		ObjectFile& objectFile, std::vector<size_t>& outUnresolvedOrigins);
+
+	// Integers are stored as LEB128 and strings are length prefixed, so small objects stay small.
+	bool WriteObjectFile(const std::filesystem::path& filepath, const ObjectFile& objectFile);
+	bool ReadObjectFile(const std::filesystem::path& filepath, ObjectFile& objectFile);
+}
@@ -0,0 +1,215 @@
+#include "Overlay.h"
+#include "Profile.h"
+#include <cassert>
+
+namespace ez80
+{
+	// From ti84pce.inc.
+	static constexpr uint32_t s_Mov9ToOP1 = 0x020320;   // _Mov9ToOP1, copies 9 bytes from hl to OP1.
+	static constexpr uint32_t s_ChkFindSym = 0x02050C;  // _ChkFindSym, finds the variable named in OP1, carry if it doesn't exist.
+	static constexpr uint32_t s_ChkInRam = 0x021F98;    // _ChkInRam, z if de is in RAM rather than archived.
+	static constexpr uint32_t s_MemChk = 0x0204FC;      // _MemChk, returns the free RAM in hl.
+	static constexpr uint32_t s_InsertMem = 0x020514;   // _InsertMem, inserts hl bytes at de.
+	static constexpr uint32_t s_AsmProgramSize = 0xD0118C; // asm_prgm_size, freed from UserMem when the program returns.
+
+	static constexpr uint8_t s_NoOverlay = 0xFF;
+
+	// Emits code into the runtime's only section, with every address, even of its own labels, left to the linker.
+	class RuntimeWriter
+	{
+	public:
+		RuntimeWriter(ObjectFile& object)
+			: object(object), data(object.sections.emplace_back("overlays").data) {}
+
+		// Imported until it's defined.
+		uint32_t Symbol(std::string name, bool exported = false)
+		{
+			object.symbols.push_back({ std::move(name), ObjectSymbol::Import, 0, exported });
+			return static_cast<uint32_t>(object.symbols.size() - 1);
+		}
+
+		void Define(uint32_t symbol)
+		{
+			object.symbols[symbol].section = 0;
+			object.symbols[symbol].offset = static_cast<uint32_t>(data.size());
+		}
+
+		void Emit(std::initializer_list<uint8_t> bytes) { data.insert(data.end(), bytes); }
+
+		void Emit24(std::initializer_list<uint8_t> opcode, uint32_t value)
+		{
+			Emit(opcode);
+			for (uint32_t i = 0; i < 3; i++)
+				data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+
+		void EmitAddress(std::initializer_list<uint8_t> opcode, uint32_t symbol)
+		{
+			Emit(opcode);
+			object.relocations.push_back({ 0, static_cast<uint32_t>(data.size()), 3, symbol, 0 });
+			data.insert(data.end(), 3, 0);
+		}
+
+		// Relative jumps are resolved here, once every label is defined.
+		void EmitRelative(uint8_t opcode, uint32_t symbol)
+		{
+			Emit({ opcode, 0 });
+			relativeJumps.push_back({ static_cast<uint32_t>(data.size() - 1), symbol });
+		}
+
+		void Finish()
+		{
+			for (auto [offset, symbol] : relativeJumps)
+			{
+				int64_t distance = static_cast<int64_t>(object.symbols[symbol].offset) - (offset + 1);
+				assert(object.symbols[symbol].section == 0 && distance >= -128 && distance <= 127);
+				data[offset] = static_cast<uint8_t>(distance);
+			}
+		}
+	private:
+		struct RelativeJump
+		{
+			uint32_t offset = 0; // Of the distance byte.
+			uint32_t symbol = 0;
+		};
+
+		ObjectFile& object;
+		std::vector<uint8_t>& data;
+		std::vector<RelativeJump> relativeJumps;
+	};
+
+	void BuildOverlayRuntime(const std::vector<std::string>& appVarNames, const std::vector<OverlayThunk>& thunks, uint32_t areaSize, ObjectFile& runtime)
+	{
+		PROFILE_FUNCTION();
+
+		RuntimeWriter writer(runtime);
+		uint32_t load = writer.Symbol("@overlay.Load");
+		uint32_t done = writer.Symbol("@overlay.Done");
+		uint32_t failed = writer.Symbol("@overlay.Failed");
+		uint32_t haveRoom = writer.Symbol("@overlay.HaveRoom");
+		uint32_t inRam = writer.Symbol("@overlay.InRam");
+		uint32_t restore = writer.Symbol("@overlay.Restore");
+		uint32_t current = writer.Symbol("@overlay.Current");
+		uint32_t pending = writer.Symbol("@overlay.Pending");
+		uint32_t ready = writer.Symbol("@overlay.Ready");
+		uint32_t names = writer.Symbol("@overlay.Names");
+		uint32_t area = writer.Symbol("@overlay.Area");
+
+		// Callers' stacks hold the overlay to load back on return, and their af while loading.
+		for (const OverlayThunk& thunk : thunks)
+		{
+			writer.Define(writer.Symbol(std::string(OverlayThunkPrefix) + thunk.target, true));
+			writer.Emit({ 0xE5 });                                   // push hl
+			writer.EmitAddress({ 0x2A }, current);                   // ld hl, (Current)
+			writer.Emit({ 0xE3 });                                   // ex (sp), hl
+			writer.Emit({ 0xF5 });                                   // push af
+			writer.Emit({ 0x3E, thunk.overlayIndex });               // ld a, overlayIndex
+			writer.EmitAddress({ 0xCD }, load);                      // call Load
+			writer.Emit({ 0xF1 });                                   // pop af
+			writer.EmitAddress({ 0xCD }, writer.Symbol(thunk.target)); // call target
+			writer.EmitAddress({ 0xC3 }, restore);                   // jp Restore
+		}
+
+		// The same stack layout as a thunk's while loading, so that both fail the same way.
+		writer.Define(restore);
+		writer.Emit({ 0xF5, 0xE5 });                                 // push af \ push hl
+		writer.Emit24({ 0x21 }, 6);                                  // ld hl, 6
+		writer.Emit({ 0x39, 0x7E });                                 // add hl, sp \ ld a, (hl) ; The overlay before.
+		writer.Emit({ 0xE1 });                                       // pop hl
+		writer.EmitAddress({ 0xCD }, load);                          // call Load
+		writer.Emit({ 0xF1 });                                       // pop af
+		writer.Emit({ 0x33, 0x33, 0x33 });                           // inc sp (x3)
+		writer.Emit({ 0xC9 });                                       // ret
+
+		// Loads overlay a, unless it's already loaded or is s_NoOverlay. Preserves everything but af.
+		// Done and Failed are too far for jr from most of it.
+		writer.Define(load);
+		writer.Emit({ 0xC5, 0xD5, 0xE5, 0xDD, 0xE5 });               // push bc \ push de \ push hl \ push ix
+		writer.EmitAddress({ 0x21 }, current);                       // ld hl, Current
+		writer.Emit({ 0xBE });                                       // cp a, (hl)
+		writer.EmitAddress({ 0xCA }, done);                          // jp z, Done
+		writer.Emit({ 0xFE, s_NoOverlay });                          // cp a, s_NoOverlay
+		writer.EmitAddress({ 0xCA }, done);                          // jp z, Done
+		writer.EmitAddress({ 0x32 }, pending);                       // ld (Pending), a
+
+		// The area is inserted right after the program on first use, and freed with it.
+		// Variables after it move up, so this has to come before looking the AppVar up.
+		writer.EmitAddress({ 0x3A }, ready);                         // ld a, (Ready)
+		writer.Emit({ 0xB7 });                                       // or a, a
+		writer.EmitRelative(0x20, haveRoom);                         // jr nz, HaveRoom
+		writer.Emit24({ 0xCD }, s_MemChk);                           // call _MemChk
+		writer.Emit24({ 0x11 }, areaSize);                           // ld de, areaSize
+		writer.Emit({ 0xB7, 0xED, 0x52 });                           // or a, a \ sbc hl, de
+		writer.EmitAddress({ 0xDA }, failed);                        // jp c, Failed
+		writer.Emit24({ 0x21 }, areaSize);                           // ld hl, areaSize
+		writer.EmitAddress({ 0x11 }, area);                          // ld de, Area
+		writer.Emit24({ 0xCD }, s_InsertMem);                        // call _InsertMem
+		writer.Emit24({ 0x2A }, s_AsmProgramSize);                   // ld hl, (asm_prgm_size)
+		writer.Emit24({ 0x11 }, areaSize);                           // ld de, areaSize
+		writer.Emit({ 0x19 });                                       // add hl, de
+		writer.Emit24({ 0x22 }, s_AsmProgramSize);                   // ld (asm_prgm_size), hl
+		writer.Emit({ 0x3E, 0x01 });                                 // ld a, 1
+		writer.EmitAddress({ 0x32 }, ready);                         // ld (Ready), a
+
+		writer.Define(haveRoom);
+		writer.EmitAddress({ 0x3A }, pending);                       // ld a, (Pending)
+		writer.Emit24({ 0x21 }, 0);                                  // ld hl, 0
+		writer.Emit({ 0x6F, 0xE5, 0xD1 });                           // ld l, a \ push hl \ pop de
+		writer.Emit({ 0x29, 0x29, 0x29, 0x19 });                     // add hl, hl (x3) \ add hl, de ; Names are 9 bytes each.
+		writer.EmitAddress({ 0x11 }, names);                         // ld de, Names
+		writer.Emit({ 0x19 });                                       // add hl, de
+		writer.Emit24({ 0xCD }, s_Mov9ToOP1);                        // call _Mov9ToOP1
+		writer.Emit24({ 0xCD }, s_ChkFindSym);                       // call _ChkFindSym
+		writer.EmitAddress({ 0xDA }, failed);                        // jp c, Failed
+		writer.Emit24({ 0xCD }, s_ChkInRam);                         // call _ChkInRam
+		writer.Emit({ 0xEB });                                       // ex de, hl
+		writer.EmitRelative(0x28, inRam);                            // jr z, InRam
+		writer.Emit24({ 0x11 }, 9);                                  // ld de, 9 ; Past the archived variable's header and name.
+		writer.Emit({ 0x19, 0x5E, 0x19, 0x23 });                     // add hl, de \ ld e, (hl) \ add hl, de \ inc hl
+
+		writer.Define(inRam);
+		writer.Emit24({ 0x01 }, 0);                                  // ld bc, 0
+		writer.Emit({ 0x4E, 0x23, 0x46, 0x23 });                     // ld c, (hl) \ inc hl \ ld b, (hl) \ inc hl
+		writer.Emit({ 0x78, 0xB1 });                                 // ld a, b \ or a, c
+		writer.EmitAddress({ 0xCA }, failed);                        // jp z, Failed ; An empty AppVar, which ldir would take as 16M bytes.
+		writer.Emit({ 0xE5 });                                       // push hl
+		writer.Emit24({ 0x21 }, areaSize);                           // ld hl, areaSize
+		writer.Emit({ 0xB7, 0xED, 0x42 });                           // or a, a \ sbc hl, bc
+		writer.Emit({ 0xE1 });                                       // pop hl
+		writer.EmitAddress({ 0xDA }, failed);                        // jp c, Failed ; Bigger than the area, so not the overlay that was linked.
+		writer.EmitAddress({ 0x11 }, area);                          // ld de, Area
+		writer.Emit({ 0xED, 0xB0 });                                 // ldir
+		writer.EmitAddress({ 0x3A }, pending);                       // ld a, (Pending)
+		writer.EmitAddress({ 0x32 }, current);                       // ld (Current), a
+
+		writer.Define(done);
+		writer.Emit({ 0xDD, 0xE1, 0xE1, 0xD1, 0xC1 });               // pop ix \ pop hl \ pop de \ pop bc
+		writer.Emit({ 0xC9 });                                       // ret
+
+		// Returns from the thunk, or Restore, with the caller's registers but carry set.
+		writer.Define(failed);
+		writer.Emit({ 0xDD, 0xE1, 0xE1, 0xD1, 0xC1 });               // pop ix \ pop hl \ pop de \ pop bc
+		writer.Emit({ 0x33, 0x33, 0x33 });                           // inc sp (x3) ; Drops the return into the thunk.
+		writer.Emit({ 0xF1 });                                       // pop af
+		writer.Emit({ 0x33, 0x33, 0x33 });                           // inc sp (x3) ; Drops the overlay to load back.
+		writer.Emit({ 0x37, 0xC9 });                                 // scf \ ret
+
+		writer.Define(current);
+		writer.Emit({ s_NoOverlay });
+		writer.Define(pending);
+		writer.Emit({ 0 });
+		writer.Define(ready);
+		writer.Emit({ 0 });
+
+		writer.Define(names);
+		for (const std::string& name : appVarNames)
+		{
+			writer.Emit({ AppVarType });
+			for (size_t i = 0; i < 8; i++)
+				writer.Emit({ static_cast<uint8_t>(i < name.size() ? name[i] : 0) });
+		}
+
+		writer.Define(area);
+		writer.Finish();
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ObjectFile.h"
+#include <string_view>
+
+namespace ez80
+{
+	// Thunks are exported as this followed by the name of the symbol they call, which no label can start with.
+	constexpr std::string_view OverlayThunkPrefix = "@overlay.";
+
+	// A symbol in an overlay that's called from outside of it.
+	struct OverlayThunk
+	{
+		std::string target;
+		uint8_t overlayIndex = 0; // Into appVarNames.
+	};
+
+	// Builds what a program needs to call into overlays, as an object to place after everything else in the program.
+	// Overlays are the AppVars in appVarNames, each 8 characters padded with zeros, all run from one area of areaSize bytes
+	// right after the program, which the first one loaded makes room for. Only one overlay is loaded at a time.
+	// Every thunk saves which overlay was loaded, loads the one it calls into unless it already is, calls it, and
+	// loads the one before back on return, so that overlays can call each other, and every register is preserved
+	// both ways. If an overlay can't be loaded, since its AppVar is missing or there isn't enough free RAM,
+	// the call returns at once with carry set instead, as it does if the AppVar is empty or bigger than the area.
+	// A thunk leaves the overlay to load back and its own return address on the stack, so what's called through one
+	// finds its stack arguments 6 bytes further up than a direct call would. Overlays can't take arguments on the stack.
+	void BuildOverlayRuntime(const std::vector<std::string>& appVarNames, const std::vector<OverlayThunk>& thunks, uint32_t areaSize, ObjectFile& runtime);
+
+	// Whether opcode is a call or jp with a 24-bit address after it, conditional or not.
+	constexpr bool IsCallOrJump(uint8_t opcode) noexcept
+	{
+		return opcode == 0xC3 || opcode == 0xCD || (opcode & 0xC7) == 0xC2 || (opcode & 0xC7) == 0xC4;
+	}
+}
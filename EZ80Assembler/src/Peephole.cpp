@@ -0,0 +1,248 @@
+#include "Peephole.h"
+#include "AssemblerStringUtil.h"
+#include "Instructions.h"
+#include "SourceScope.h"
+#include "StringUtil.h"
+#include "Profile.h"
+
+namespace ez80
+{
+	static constexpr size_t s_NoLine = static_cast<size_t>(-1);
+	static constexpr size_t s_LivenessWindow = 32; // Lines looked at before a value is assumed to be live.
+
+	static bool Is(std::string_view left, std::string_view right) noexcept
+	{
+		return util::string::EqualsIgnoreCase(left, right);
+	}
+
+	static bool IsInstruction(const TokenizedLine& tokenizedLine, std::string_view mnemonic, size_t operandCount) noexcept
+	{
+		return tokenizedLine.tokenCount == operandCount + 1 && Is(tokenizedLine[0], mnemonic);
+	}
+
+	// Instructions and macro invocations, but not labels, directives or preprocessor statements.
+	static bool IsCode(const TokenizedLine& tokenizedLine) noexcept
+	{
+		std::string_view token0 = tokenizedLine[0];
+		return !token0.starts_with('#') && !token0.starts_with('.') && GetLabelName(tokenizedLine).empty();
+	}
+
+	static bool IsZeroLiteral(std::string_view literal) noexcept
+	{
+		uint32_t value;
+		return ParseNumericLiteral(literal, value) && value == 0;
+	}
+
+	static InstructionCost CostOf(const TokenizedLine& tokenizedLine) noexcept
+	{
+		InstructionInfo info;
+		if (!LookupInstruction(tokenizedLine[0], tokenizedLine.Operands(), info))
+			return {};
+		return info.costs[AssemblyMode_ADL];
+	}
+
+	static bool IsBranch(const TokenizedLine& tokenizedLine) noexcept
+	{
+		InstructionInfo info;
+		return !LookupInstruction(tokenizedLine[0], tokenizedLine.Operands(), info) || (info.flags & InstructionFlags_Branch);
+	}
+
+	// Returns the index of the following line if it is an instruction, with nothing else in between.
+	static size_t NextInstruction(const std::pmr::vector<TokenizedLine>& tokenizedLines, size_t lineIndex) noexcept
+	{
+		for (size_t i = lineIndex + 1; i < tokenizedLines.size(); i++)
+		{
+			if (!tokenizedLines[i].handled)
+				return IsCode(tokenizedLines[i]) ? i : s_NoLine;
+		}
+		return s_NoLine;
+	}
+
+	// Walks forward from the line after lineIndex, through labels, until the visitor decides or something unknown is found.
+	// The visitor returns 1 if the value is dead, 0 if it's live, and -1 to keep looking.
+	template<typename Visitor>
+	static bool IsDeadAfter(const std::pmr::vector<TokenizedLine>& tokenizedLines, size_t lineIndex, Visitor visitor)
+	{
+		size_t scanned = 0;
+		for (size_t i = lineIndex + 1; i < tokenizedLines.size() && scanned < s_LivenessWindow; i++)
+		{
+			const TokenizedLine& tokenizedLine = tokenizedLines[i];
+			if (tokenizedLine.handled)
+				continue;
+			scanned++;
+
+			// Falling through a label doesn't change what runs next.
+			if (!GetLabelName(tokenizedLine).empty())
+				continue;
+			if (!IsCode(tokenizedLine))
+				return false;
+
+			if (int decision = visitor(tokenizedLine); decision >= 0)
+				return decision;
+
+			// Whatever the branch goes to might read it.
+			if (IsBranch(tokenizedLine))
+				return false;
+		}
+		return false;
+	}
+
+	static bool AreFlagsDead(const std::pmr::vector<TokenizedLine>& tokenizedLines, size_t lineIndex, uint8_t flags)
+	{
+		uint8_t written = CpuFlags_None;
+		return IsDeadAfter(tokenizedLines, lineIndex, [flags, &written](const TokenizedLine& tokenizedLine)
+		{
+			uint8_t read;
+			uint8_t overwritten;
+			if (!LookupFlagEffects(tokenizedLine[0], tokenizedLine.Operands(), read, overwritten) || (read & flags & ~written))
+				return 0;
+			written |= overwritten;
+			return (written & flags) == flags ? 1 : -1;
+		});
+	}
+
+	static bool MentionsHL(std::string_view operand) noexcept
+	{
+		return Is(operand, "hl") || Is(operand, "h") || Is(operand, "l") || Is(operand, "(hl)");
+	}
+
+	static bool IsHLDead(const std::pmr::vector<TokenizedLine>& tokenizedLines, size_t lineIndex)
+	{
+		return IsDeadAfter(tokenizedLines, lineIndex, [](const TokenizedLine& tokenizedLine)
+		{
+			std::string_view mnemonic = tokenizedLine[0];
+
+			// Block instructions use hl without naming it, and exx keeps it in hl', where a later exx brings it back.
+			static constexpr std::string_view implicitUsers[] = {
+				"ldi", "ldd", "ldir", "lddr", "cpi", "cpd", "cpir", "cpdr", "ini", "ind", "inir", "indr",
+				"outi", "outd", "otir", "otdr", "rld", "rrd", "exx"
+			};
+			for (std::string_view implicitUser : implicitUsers)
+				if (Is(mnemonic, implicitUser))
+					return 0;
+
+			bool overwrites = ((IsInstruction(tokenizedLine, "ld", 2) || IsInstruction(tokenizedLine, "lea", 2)) && Is(tokenizedLine[1], "hl") && !MentionsHL(tokenizedLine[2])) ||
+				(IsInstruction(tokenizedLine, "pop", 1) && Is(tokenizedLine[1], "hl"));
+			if (overwrites)
+				return 1;
+
+			for (std::string_view operand : tokenizedLine.Operands())
+				if (MentionsHL(operand))
+					return 0;
+			return -1;
+		});
+	}
+
+	void OptimizePeephole(std::pmr::vector<TokenizedLine>& tokenizedLines, std::vector<AssemblerRewrite>& rewrites)
+	{
+		PROFILE_FUNCTION();
+
+		SourceScope scope;
+
+		// Records a rewrite of every line in [first, last], using the costs from before it happened.
+		auto Record = [&tokenizedLines, &rewrites](AssemblerRewrite::ID id, size_t first, size_t last, uint32_t bytesBefore, uint32_t cyclesBefore)
+		{
+			uint32_t bytesAfter = 0;
+			uint32_t cyclesAfter = 0;
+			for (size_t i = first; i <= last; i++)
+			{
+				if (!tokenizedLines[i].handled)
+				{
+					InstructionCost cost = CostOf(tokenizedLines[i]);
+					bytesAfter += cost.size;
+					cyclesAfter += cost.takenCycles;
+				}
+			}
+			rewrites.emplace_back(id, tokenizedLines[first].number, bytesBefore - bytesAfter, cyclesBefore - cyclesAfter);
+		};
+
+		for (size_t i = 0; i < tokenizedLines.size(); i++)
+		{
+			TokenizedLine& line = tokenizedLines[i];
+			if (line.handled || scope.Visit(line) != SourceScopeEvent_None || !IsCode(line))
+				continue;
+
+			InstructionCost lineCost = CostOf(line);
+			size_t next = NextInstruction(tokenizedLines, i);
+
+			// ld a, 0 -> xor a
+			if (IsInstruction(line, "ld", 2) && Is(line[1], "a") && IsZeroLiteral(line[2]) && AreFlagsDead(tokenizedLines, i, CpuFlags_All))
+			{
+				auto it = line.begin();
+				*it++ = "xor";
+				*it = "a";
+				line.Truncate(2);
+				Record(AssemblerRewrite_LoadZeroToXor, i, i, lineCost.size, lineCost.takenCycles);
+				continue;
+			}
+
+			if (next == s_NoLine)
+				continue;
+			TokenizedLine& nextLine = tokenizedLines[next];
+			InstructionCost nextCost = CostOf(nextLine);
+
+			// call x / ret -> jp x, where the ret can only be dropped if the call was unconditional.
+			if ((IsInstruction(line, "call", 1) || (IsInstruction(line, "call", 2) && IsCondition(line[1]))) && IsInstruction(nextLine, "ret", 0))
+			{
+				*line.begin() = "jp";
+				if (line.tokenCount == 2)
+					nextLine.handled = true;
+				Record(AssemblerRewrite_TailCall, i, next, lineCost.size + nextCost.size, lineCost.takenCycles + nextCost.takenCycles);
+				i = next;
+				continue;
+			}
+
+			// ex de, hl / ex de, hl -> nothing
+			auto IsExchange = [](const TokenizedLine& tokenizedLine) noexcept
+			{
+				return IsInstruction(tokenizedLine, "ex", 2) &&
+					((Is(tokenizedLine[1], "de") && Is(tokenizedLine[2], "hl")) || (Is(tokenizedLine[1], "hl") && Is(tokenizedLine[2], "de")));
+			};
+			if (IsExchange(line) && IsExchange(nextLine))
+			{
+				line.handled = true;
+				nextLine.handled = true;
+				Record(AssemblerRewrite_RedundantExchange, i, next, lineCost.size + nextCost.size, lineCost.takenCycles + nextCost.takenCycles);
+				i = next;
+				continue;
+			}
+
+			// ld hl, n / add hl, sp / ld sp, hl -> |n| inc sp or dec sp, for |n| <= 3.
+			// A plain ld hl, 0 / add hl, sp is already the cheapest way to read sp, so it is left alone.
+			int32_t adjustment;
+			if (IsInstruction(line, "ld", 2) && Is(line[1], "hl") && util::string::SToI(line[2], adjustment) && adjustment >= -3 && adjustment <= 3 &&
+				IsInstruction(nextLine, "add", 2) && Is(nextLine[1], "hl") && Is(nextLine[2], "sp"))
+			{
+				size_t last = NextInstruction(tokenizedLines, next);
+				if (last == s_NoLine)
+					continue;
+				TokenizedLine& lastLine = tokenizedLines[last];
+				if (!IsInstruction(lastLine, "ld", 2) || !Is(lastLine[1], "sp") || !Is(lastLine[2], "hl") ||
+					!AreFlagsDead(tokenizedLines, last, CpuFlags_H | CpuFlags_N | CpuFlags_C) || !IsHLDead(tokenizedLines, last))
+					continue;
+
+				InstructionCost lastCost = CostOf(lastLine);
+				uint32_t bytesBefore = lineCost.size + nextCost.size + lastCost.size;
+				uint32_t cyclesBefore = lineCost.takenCycles + nextCost.takenCycles + lastCost.takenCycles;
+
+				TokenizedLine* sequence[3] = { &line, &nextLine, &lastLine };
+				uint32_t steps = static_cast<uint32_t>(adjustment < 0 ? -adjustment : adjustment);
+				for (uint32_t step = 0; step < 3; step++)
+				{
+					if (step < steps)
+					{
+						auto it = sequence[step]->begin();
+						*it++ = adjustment < 0 ? "dec" : "inc";
+						*it = "sp";
+						sequence[step]->Truncate(2);
+					}
+					else
+						sequence[step]->handled = true;
+				}
+				Record(AssemblerRewrite_StackAdjust, i, last, bytesBefore, cyclesBefore);
+				i = last;
+				continue;
+			}
+		}
+	}
+}
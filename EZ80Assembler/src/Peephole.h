@@ -0,0 +1,12 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "EZ80Assembler.h"
+
+namespace ez80
+{
+	// Rewrites known slow or large instruction sequences into cheaper equivalents, marking removed lines as handled.
+	// Sequences never span labels or preprocessor statements, and a sequence that clobbers flags or registers
+	// is only rewritten when they are overwritten before anything can read them.
+	void OptimizePeephole(std::pmr::vector<TokenizedLine>& tokenizedLines, std::vector<AssemblerRewrite>& rewrites);
+}
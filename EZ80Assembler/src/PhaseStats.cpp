@@ -0,0 +1,209 @@
+#include "PhaseStats.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if EZ80_COUNT_ALLOCATIONS
+#if SYSTEM_WINDOWS
+	#include <malloc.h>
+	#define EZ80_ALLOCATION_SIZE(pointer) _msize(pointer)
+	#define EZ80_ALIGNED_ALLOCATION_SIZE(pointer, alignment) _aligned_msize(pointer, alignment, 0)
+#elif defined(__APPLE__)
+	#include <malloc/malloc.h>
+	#define EZ80_ALLOCATION_SIZE(pointer) malloc_size(pointer)
+	#define EZ80_ALIGNED_ALLOCATION_SIZE(pointer, alignment) malloc_size(pointer)
+#else
+	#include <malloc.h>
+	#define EZ80_ALLOCATION_SIZE(pointer) malloc_usable_size(pointer)
+	#define EZ80_ALIGNED_ALLOCATION_SIZE(pointer, alignment) malloc_usable_size(pointer)
+#endif
+#endif
+
+namespace ez80
+{
+	namespace
+	{
+		// Constant initialized, so it's safe to use from operator new at any point in a thread's life.
+		struct AllocationCounters
+		{
+			uint32_t recorders = 0; // Nothing is counted while this is 0.
+			uint64_t allocationCount = 0;
+			uint64_t allocatedBytes = 0;
+			int64_t liveBytes = 0; // Can go negative, from freeing what was allocated before counting began.
+			int64_t peakBytes = 0;
+		};
+
+		thread_local AllocationCounters t_Counters;
+	}
+
+#if EZ80_COUNT_ALLOCATIONS
+	// Checked before anything else, so that while nothing is recorded an allocation costs one thread local load more.
+	static bool IsCountingAllocations() noexcept
+	{
+		return t_Counters.recorders != 0;
+	}
+
+	// Size is what was asked for, and usableSize what the allocator actually set aside.
+	static void CountAllocation(size_t size, size_t usableSize) noexcept
+	{
+		auto& counters = t_Counters;
+		counters.allocationCount++;
+		counters.allocatedBytes += size;
+		counters.liveBytes += static_cast<int64_t>(usableSize);
+		counters.peakBytes = std::max(counters.peakBytes, counters.liveBytes);
+	}
+
+	static void CountDeallocation(size_t usableSize) noexcept
+	{
+		t_Counters.liveBytes -= static_cast<int64_t>(usableSize);
+	}
+#endif
+
+	PhaseRecorder::PhaseRecorder(AssemblerStats* stats, std::string_view totalName) noexcept
+		: stats(stats)
+	{
+		if (stats)
+		{
+			t_Counters.recorders++;
+			stats->total.name = totalName;
+			totalStart = Take();
+		}
+	}
+
+	PhaseRecorder::~PhaseRecorder()
+	{
+		if (stats)
+		{
+			End();
+			Finish(totalStart, stats->total);
+			t_Counters.recorders--;
+		}
+	}
+
+	void PhaseRecorder::Begin(std::string_view name)
+	{
+		if (!stats)
+			return;
+
+		End();
+
+		// Grow the phases before the phase starts, so that it isn't counted in it.
+		stats->phases.emplace_back().name = name;
+		phaseStart = Take();
+		inPhase = true;
+	}
+
+	void PhaseRecorder::End()
+	{
+		if (stats && inPhase)
+		{
+			Finish(phaseStart, stats->phases.back());
+			inPhase = false;
+		}
+	}
+
+	PhaseRecorder::Snapshot PhaseRecorder::Take() noexcept
+	{
+		// Peaks are measured from here, and whoever measured from before gets theirs back in Finish.
+		Snapshot snapshot{ t_Counters.allocationCount, t_Counters.allocatedBytes, t_Counters.liveBytes, t_Counters.peakBytes, std::chrono::steady_clock::now() };
+		t_Counters.peakBytes = t_Counters.liveBytes;
+		return snapshot;
+	}
+
+	void PhaseRecorder::Finish(const Snapshot& start, PhaseStats& phase) noexcept
+	{
+		phase.nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start.time).count());
+		phase.allocationCount = t_Counters.allocationCount - start.allocationCount;
+		phase.allocatedBytes = t_Counters.allocatedBytes - start.allocatedBytes;
+		phase.peakBytes = static_cast<uint64_t>(std::max<int64_t>(t_Counters.peakBytes - start.liveBytes, 0));
+		t_Counters.peakBytes = std::max(t_Counters.peakBytes, start.outerPeakBytes);
+	}
+
+	void WriteAssemblerStats(std::ostream& stream, const AssemblerStats& stats)
+	{
+		auto WritePhase = [&stream](const PhaseStats& phase)
+		{
+			stream << "{ \"name\": \"" << phase.name << "\", \"nanoseconds\": " << phase.nanoseconds << ", \"allocationCount\": " << phase.allocationCount
+				<< ", \"allocatedBytes\": " << phase.allocatedBytes << ", \"peakBytes\": " << phase.peakBytes << " }";
+		};
+
+		stream << "{\n\t\"total\": ";
+		WritePhase(stats.total);
+		stream << ",\n\t\"phases\": [";
+		for (size_t i = 0; i < stats.phases.size(); i++)
+		{
+			stream << (i ? ",\n\t\t" : "\n\t\t");
+			WritePhase(stats.phases[i]);
+		}
+		stream << (stats.phases.empty() ? "]\n}\n" : "\n\t]\n}\n");
+	}
+}
+
+#if EZ80_COUNT_ALLOCATIONS
+// Every allocation goes through these, the other forms of new and delete forward to them by default.
+// The aligned forms don't, and std::pmr resources allocate their chunks through them, so they're replaced too.
+// Replacing them affects the whole program the assembler is linked into, so only hosts that want the counts define
+// EZ80_COUNT_ALLOCATIONS, like the benchmark does.
+void* operator new(std::size_t size)
+{
+	void* pointer = std::malloc(size ? size : 1);
+	if (!pointer)
+		throw std::bad_alloc();
+
+	if (ez80::IsCountingAllocations())
+		ez80::CountAllocation(size, EZ80_ALLOCATION_SIZE(pointer));
+	return pointer;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	size_t bytes = size ? size : 1;
+#if SYSTEM_WINDOWS
+	void* pointer = _aligned_malloc(bytes, static_cast<size_t>(alignment));
+#else
+	void* pointer = nullptr;
+	if (posix_memalign(&pointer, std::max(static_cast<size_t>(alignment), sizeof(void*)), bytes) != 0)
+		pointer = nullptr;
+#endif
+	if (!pointer)
+		throw std::bad_alloc();
+
+	if (ez80::IsCountingAllocations())
+		ez80::CountAllocation(size, EZ80_ALIGNED_ALLOCATION_SIZE(pointer, static_cast<size_t>(alignment)));
+	return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+	if (!pointer)
+		return;
+
+	if (ez80::IsCountingAllocations())
+		ez80::CountDeallocation(EZ80_ALLOCATION_SIZE(pointer));
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	operator delete(pointer);
+}
+
+void operator delete(void* pointer, [[maybe_unused]] std::align_val_t alignment) noexcept
+{
+	if (!pointer)
+		return;
+
+	if (ez80::IsCountingAllocations())
+		ez80::CountDeallocation(EZ80_ALIGNED_ALLOCATION_SIZE(pointer, static_cast<size_t>(alignment)));
+#if SYSTEM_WINDOWS
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace ez80
+{
+	struct PhaseStats
+	{
+		std::string_view name;
+		uint64_t nanoseconds = 0; // Wall clock time.
+		uint64_t allocationCount = 0;
+		uint64_t allocatedBytes = 0; // In total, including anything freed again.
+		uint64_t peakBytes = 0; // The most that was live at once, above what was live when the phase began.
+	};
+
+	struct AssemblerStats
+	{
+		std::vector<PhaseStats> phases; // In the order they ran.
+		PhaseStats total;
+	};
+
+	// Times consecutive phases and counts what the current thread allocates through operator new in each,
+	// ending each phase when the next begins and the last one when it's destroyed.
+	// Does nothing if stats is null, and allocations aren't counted at all while no recorder exists.
+	// Allocations are only counted if EZ80_COUNT_ALLOCATIONS is defined, which replaces the global operator new
+	// and delete, otherwise only times are recorded and the counts stay 0.
+	class PhaseRecorder
+	{
+	public:
+		PhaseRecorder(AssemblerStats* stats, std::string_view totalName) noexcept;
+		~PhaseRecorder();
+
+		PhaseRecorder(const PhaseRecorder&) = delete;
+		PhaseRecorder& operator=(const PhaseRecorder&) = delete;
+
+		void Begin(std::string_view name);
+		void End();
+	private:
+		struct Snapshot
+		{
+			uint64_t allocationCount = 0;
+			uint64_t allocatedBytes = 0;
+			int64_t liveBytes = 0;
+			int64_t outerPeakBytes = 0;
+			std::chrono::steady_clock::time_point time;
+		};
+
+		static Snapshot Take() noexcept;
+		static void Finish(const Snapshot& start, PhaseStats& phase) noexcept;
+
+		AssemblerStats* stats;
+		Snapshot totalStart;
+		Snapshot phaseStart;
+		bool inPhase = false;
+	};
+
+	void WriteAssemblerStats(std::ostream& stream, const AssemblerStats& stats);
+}
@@ -0,0 +1,152 @@
+#include "PlatformSymbols.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iterator>
+
+namespace ez80
+{
+	namespace
+	{
+		struct PlatformSymbol
+		{
+			std::string_view name;
+			int64_t value = 0;
+		};
+	}
+
+	static constexpr PlatformSymbol s_PlatformSymbols[] = {
+#include "PlatformSymbols.inl"
+	};
+
+	static constexpr size_t s_SymbolCount = std::size(s_PlatformSymbols);
+
+	// Both are powers of two, so they're indexed with a mask. About four names share a bucket,
+	// and a quarter of the slots are left free so that every bucket's seed is quick to find.
+	static constexpr size_t s_SlotCount = std::bit_ceil(s_SymbolCount + s_SymbolCount / 3 + 1);
+	static constexpr size_t s_BucketCount = std::bit_ceil(s_SymbolCount / 4 + 1);
+
+	static constexpr uint16_t s_EmptySlot = UINT16_MAX;
+	static_assert(s_SymbolCount < s_EmptySlot);
+
+	// Past this, names in the same bucket are assumed to be the same name.
+	static constexpr uint32_t s_MaxSeed = 1 << 16;
+
+	// FNV-1a.
+	static constexpr uint64_t HashName(std::string_view name) noexcept
+	{
+		uint64_t hash = 0xCBF29CE484222325;
+		for (char c : name)
+			hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001B3;
+		return hash;
+	}
+
+	static constexpr size_t Bucket(uint64_t hash) noexcept
+	{
+		return static_cast<size_t>(hash >> 40) & (s_BucketCount - 1);
+	}
+
+	// Mixes the name's hash with its bucket's seed, so trying another seed doesn't rehash the name.
+	static constexpr size_t Slot(uint64_t hash, uint32_t seed) noexcept
+	{
+		hash ^= seed * 0x9E3779B97F4A7C15;
+		hash *= 0xFF51AFD7ED558CCD;
+		hash ^= hash >> 33;
+		return static_cast<size_t>(hash) & (s_SlotCount - 1);
+	}
+
+	namespace
+	{
+		struct PerfectHashTable
+		{
+			std::array<uint16_t, s_SlotCount> slots{}; // Into s_PlatformSymbols.
+			std::array<uint32_t, s_BucketCount> seeds{};
+			bool built = false;
+		};
+	}
+
+	// Hash and displace: buckets are seeded from the largest down, each with the first seed that puts all of its names in free slots.
+	static constexpr PerfectHashTable BuildPerfectHashTable()
+	{
+		PerfectHashTable table;
+		table.slots.fill(s_EmptySlot);
+
+		// Group the names by bucket.
+		std::array<uint64_t, s_SymbolCount> hashes{};
+		std::array<size_t, s_BucketCount + 1> bucketStarts{};
+		for (size_t i = 0; i < s_SymbolCount; i++)
+		{
+			hashes[i] = HashName(s_PlatformSymbols[i].name);
+			bucketStarts[Bucket(hashes[i]) + 1]++;
+		}
+		for (size_t bucket = 0; bucket < s_BucketCount; bucket++)
+			bucketStarts[bucket + 1] += bucketStarts[bucket];
+
+		std::array<uint16_t, s_SymbolCount> members{};
+		std::array<size_t, s_BucketCount> bucketEnds{};
+		std::copy(bucketStarts.begin(), bucketStarts.end() - 1, bucketEnds.begin());
+		for (size_t i = 0; i < s_SymbolCount; i++)
+			members[bucketEnds[Bucket(hashes[i])]++] = static_cast<uint16_t>(i);
+
+		std::array<size_t, s_BucketCount> buckets{};
+		for (size_t bucket = 0; bucket < s_BucketCount; bucket++)
+			buckets[bucket] = bucket;
+		std::sort(buckets.begin(), buckets.end(), [&](size_t left, size_t right) { return bucketEnds[left] - bucketStarts[left] > bucketEnds[right] - bucketStarts[right]; });
+
+		for (size_t bucket : buckets)
+		{
+			size_t start = bucketStarts[bucket];
+			size_t size = bucketEnds[bucket] - start;
+			uint32_t seed = 0;
+			for (;; seed++)
+			{
+				if (seed == s_MaxSeed)
+					return table;
+
+				size_t placed = 0;
+				for (; placed < size; placed++)
+				{
+					uint16_t member = members[start + placed];
+					size_t slot = Slot(hashes[member], seed);
+					if (table.slots[slot] != s_EmptySlot)
+						break;
+					table.slots[slot] = member;
+				}
+				if (placed == size)
+					break;
+
+				while (placed--)
+					table.slots[Slot(hashes[members[start + placed]], seed)] = s_EmptySlot;
+			}
+			table.seeds[bucket] = seed;
+		}
+
+		table.built = true;
+		return table;
+	}
+
+	static constexpr PerfectHashTable s_PerfectHashTable = BuildPerfectHashTable();
+	static_assert(s_PerfectHashTable.built, "Every platform symbol needs a unique name.");
+
+	bool IsPlatformInclude(std::string_view include) noexcept
+	{
+		if (include.size() >= 2 && include.front() == '"' && include.back() == '"')
+			include = include.substr(1, include.size() - 2);
+
+		size_t nameStart = include.find_last_of("/\\");
+		if (nameStart != std::string_view::npos)
+			include.remove_prefix(nameStart + 1);
+		return include == PlatformIncludeName;
+	}
+
+	bool FindPlatformSymbol(std::string_view name, int64_t& outValue) noexcept
+	{
+		uint64_t hash = HashName(name);
+		uint16_t index = s_PerfectHashTable.slots[Slot(hash, s_PerfectHashTable.seeds[Bucket(hash)])];
+		if (index == s_EmptySlot || s_PlatformSymbols[index].name != name)
+			return false;
+
+		outValue = s_PlatformSymbols[index].value;
+		return true;
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace ez80
+{
+	// The OS include that AssemblerInfo::builtinPlatformInclude resolves to the table built into the assembler.
+	constexpr std::string_view PlatformIncludeName = "ti84pce.inc";
+
+	// Whether an #include's operand, with or without its quotes, names the platform include in any directory.
+	bool IsPlatformInclude(std::string_view include) noexcept;
+
+	// Looks an equate of the platform include up in a perfect hash table built at compile time, so it takes one hash
+	// of the name and one comparison. Returns false if the name isn't one. See Scripts/GeneratePlatformSymbols.sh.
+	bool FindPlatformSymbol(std::string_view name, int64_t& outValue) noexcept;
+}
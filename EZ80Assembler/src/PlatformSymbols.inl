@@ -0,0 +1,83 @@
+// Equates from ti84pce.inc, written by Scripts/GeneratePlatformSymbols.sh. Running it on a full copy of the file
+// replaces these with every equate the file defines as a literal.
+{ "ramStart", 0x0D00000 },
+{ "flags", 0x0D00080 },
+{ "curRow", 0x0D00595 },
+{ "curCol", 0x0D00596 },
+{ "OP1", 0x0D005F8 },
+{ "OP2", 0x0D00603 },
+{ "OP3", 0x0D0060E },
+{ "OP4", 0x0D00619 },
+{ "OP5", 0x0D00624 },
+{ "OP6", 0x0D0062F },
+{ "penCol", 0x0D008D2 },
+{ "penRow", 0x0D008D5 },
+{ "asm_prgm_size", 0x0D0118C },
+{ "pixelShadow", 0x0D031F6 },
+{ "saveSScreen", 0x0D0EA1F },
+{ "UserMem", 0x0D1A881 },
+{ "vRam", 0x0D40000 },
+{ "vRamEnd", 0x0D65800 },
+{ "lcdWidth", 320 },
+{ "lcdHeight", 240 },
+{ "mpLcdTiming0", 0x0E30000 },
+{ "mpLcdBase", 0x0E30010 },
+{ "mpLcdUpbase", 0x0E30010 },
+{ "mpLcdLpbase", 0x0E30014 },
+{ "mpLcdCtrl", 0x0E30018 },
+{ "mpLcdImsc", 0x0E3001C },
+{ "mpLcdRis", 0x0E30020 },
+{ "mpLcdMis", 0x0E30024 },
+{ "mpLcdIcr", 0x0E30028 },
+{ "mpLcdPalette", 0x0E30200 },
+{ "mpLcdCursorImg", 0x0E30800 },
+{ "mpKeyRange", 0x0F50000 },
+{ "kbdG1", 0x0F50012 },
+{ "kbdG2", 0x0F50014 },
+{ "kbdG3", 0x0F50016 },
+{ "kbdG4", 0x0F50018 },
+{ "kbdG5", 0x0F5001A },
+{ "kbdG6", 0x0F5001C },
+{ "kbdG7", 0x0F5001E },
+{ "_GetCSC", 0x002014C },
+{ "_Mov9ToOP1", 0x0020320 },
+{ "_ChkFindSym", 0x002050C },
+{ "_PutC", 0x00207B8 },
+{ "_PutS", 0x00207C0 },
+{ "_NewLine", 0x00207F0 },
+{ "_ClrLCDFull", 0x0020808 },
+{ "_HomeUp", 0x0020828 },
+{ "_RunIndicOff", 0x0020848 },
+{ "_GetKey", 0x0020D8C },
+{ "_DrawStatusBar", 0x0021A3C },
+{ "_DispHL", 0x0021EE0 },
+{ "RealObj", 0x00 },
+{ "ListObj", 0x01 },
+{ "MatObj", 0x02 },
+{ "EquObj", 0x03 },
+{ "StrngObj", 0x04 },
+{ "ProgObj", 0x05 },
+{ "ProtProgObj", 0x06 },
+{ "CplxObj", 0x0C },
+{ "AppVarObj", 0x15 },
+{ "TempProgObj", 0x16 },
+{ "GroupObj", 0x17 },
+{ "tAsm84CePrgm", 0x07A },
+{ "tAsm84CeCmp", 0x07B },
+{ "tExtTok", 0x0EF },
+{ "skDown", 0x01 },
+{ "skLeft", 0x02 },
+{ "skRight", 0x03 },
+{ "skUp", 0x04 },
+{ "skEnter", 0x09 },
+{ "skClear", 0x0F },
+{ "sk2nd", 0x36 },
+{ "skMode", 0x37 },
+{ "skDel", 0x38 },
+{ "kRight", 0x01 },
+{ "kLeft", 0x02 },
+{ "kUp", 0x03 },
+{ "kDown", 0x04 },
+{ "kEnter", 0x05 },
+{ "kClear", 0x09 },
+{ "kDel", 0x0A },
@@ -0,0 +1,100 @@
+#include "Profile.h"
+
+#if CONFIG_PROFILE
+	#include <atomic>
+	#include <fstream>
+	#include <memory>
+	#include <mutex>
+	#include <vector>
+
+	namespace ez80::profile
+	{
+		struct Event
+		{
+			const char* name;
+			std::chrono::steady_clock::time_point start;
+			std::chrono::steady_clock::duration duration;
+		};
+
+		// Each thread records into its own buffer, so recording never takes a lock.
+		struct ThreadEvents
+		{
+			uint32_t threadID = 0;
+			std::vector<Event> events;
+		};
+
+		struct Session
+		{
+			std::mutex mutex; // Guards threads and filepath, not the buffers in threads.
+			std::vector<std::unique_ptr<ThreadEvents>> threads; // Kept past the end of their threads, until the session is written.
+			std::filesystem::path filepath;
+			std::chrono::steady_clock::time_point start;
+			std::atomic<bool> active = false;
+		};
+
+		static Session s_Session;
+
+		static ThreadEvents& GetThreadEvents()
+		{
+			thread_local ThreadEvents* t_ThreadEvents = nullptr;
+			if (!t_ThreadEvents)
+			{
+				std::scoped_lock lock(s_Session.mutex);
+				auto& threadEvents = s_Session.threads.emplace_back(std::make_unique<ThreadEvents>());
+				threadEvents->threadID = static_cast<uint32_t>(s_Session.threads.size());
+				threadEvents->events.reserve(1024);
+				t_ThreadEvents = threadEvents.get();
+			}
+			return *t_ThreadEvents;
+		}
+
+		void BeginSession(const std::filesystem::path& filepath)
+		{
+			std::scoped_lock lock(s_Session.mutex);
+			for (auto& threadEvents : s_Session.threads)
+				threadEvents->events.clear();
+			s_Session.filepath = filepath;
+			s_Session.start = std::chrono::steady_clock::now();
+			s_Session.active = true;
+		}
+
+		void EndSession()
+		{
+			std::scoped_lock lock(s_Session.mutex);
+			if (!s_Session.active)
+				return;
+			s_Session.active = false;
+
+			std::ofstream file(s_Session.filepath);
+			if (!file.is_open())
+				return;
+
+			// Timestamps are in microseconds from the start of the session.
+			auto Microseconds = [](std::chrono::steady_clock::duration duration)
+			{
+				return std::chrono::duration<double, std::micro>(duration).count();
+			};
+
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool first = true;
+			for (const auto& threadEvents : s_Session.threads)
+			{
+				for (const auto& event : threadEvents->events)
+				{
+					file << (first ? "\n" : ",\n");
+					first = false;
+					file << "{\"name\":\"" << event.name << "\",\"cat\":\"function\",\"ph\":\"X\",\"pid\":0,\"tid\":" << threadEvents->threadID
+						<< ",\"ts\":" << Microseconds(event.start - s_Session.start) << ",\"dur\":" << Microseconds(event.duration) << '}';
+				}
+				threadEvents->events.clear();
+			}
+			file << "\n]}\n";
+		}
+
+		void Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+		{
+			if (s_Session.active.load(std::memory_order_relaxed))
+				GetThreadEvents().events.emplace_back(name, start, end - start);
+		}
+	}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#if CONFIG_PROFILE
+	#include <chrono>
+	#include <filesystem>
+
+	namespace ez80::profile
+	{
+		// Starts recording scopes from every thread, discarding anything recorded before.
+		// Like EndSession, no other thread can be recording while it runs.
+		void BeginSession(const std::filesystem::path& filepath);
+
+		// Writes everything recorded since BeginSession as a Chrome/Perfetto trace.
+		// Any thread that recorded scopes must be done with them by now.
+		void EndSession();
+
+		// Names must outlive the session, which string literals and __func__ do.
+		void Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+		class ScopedTimer
+		{
+		public:
+			ScopedTimer(const char* name) noexcept
+				: name(name), start(std::chrono::steady_clock::now()) {}
+			~ScopedTimer() { Record(name, start, std::chrono::steady_clock::now()); }
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+		private:
+			const char* name;
+			std::chrono::steady_clock::time_point start;
+		};
+	}
+
+	#define PROFILE_CONCAT_IMPL(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+	#define PROFILE_BEGIN_SESSION(filepath) ::ez80::profile::BeginSession(filepath)
+	#define PROFILE_END_SESSION() ::ez80::profile::EndSession()
+	#define PROFILE_SCOPE(name) ::ez80::profile::ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(name)
+	#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#else
+	#define PROFILE_BEGIN_SESSION(filepath)
+	#define PROFILE_END_SESSION()
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_FUNCTION()
+#endif
@@ -0,0 +1,509 @@
+#include "ProfileLayout.h"
+#include "BranchRelaxation.h"
+#include "Layout.h"
+#include "Instructions.h"
+#include "SourceScope.h"
+#include "StringUtil.h"
+#include "Profile.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <unordered_map>
+#include <utility>
+
+namespace ez80
+{
+	static constexpr size_t s_NoChain = static_cast<size_t>(-1);
+
+	// jr's displacement is relative to the end of the jr.
+	static constexpr int64_t s_ShortBranchMin = -128;
+	static constexpr int64_t s_ShortBranchMax = 127;
+
+	static constexpr std::string_view s_Blanks = " \t\r";
+
+	// Lines from a label up to the next one that nothing falls into. Chains only move as a whole.
+	struct Chain
+	{
+		size_t firstLineIndex = 0;
+		size_t endLineIndex = 0; // One past its last line.
+		uint64_t size = 0; // With every branch as it's written.
+		uint64_t hits = 0;
+		bool pinned = false; // Stays where it is, and nothing moves past it.
+		size_t segment = 0; // Chains only move between the pinned chains around them.
+
+		// Chains are merged into clusters laid out in order, linked from the first, which holds the cluster's totals.
+		size_t parent = 0;
+		size_t next = s_NoChain;
+		size_t last = 0;
+		uint64_t clusterSize = 0;
+		uint64_t clusterHits = 0;
+	};
+
+	// A branch to a label.
+	struct ChainBranch
+	{
+		size_t lineIndex = 0;
+		size_t targetLineIndex = 0;
+		bool relative = false; // jr or djnz, which can't be moved out of range.
+		bool relaxable = false; // A plain jp that a jr could stand in for.
+		uint32_t shortSize = 0; // As a jr.
+		int64_t cyclesSaved = 0; // Every time it runs, if it's relaxable and a jr would reach.
+	};
+
+	static uint32_t ReadLittleEndian32(const uint8_t* bytes) noexcept
+	{
+		return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	}
+
+	bool ReadExecutionProfile(const std::filesystem::path& filepath, std::vector<ExecutionCount>& counts)
+	{
+		PROFILE_FUNCTION();
+
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		if (filepath.extension() == ".bin")
+		{
+			uint8_t record[8];
+			while (file.read(reinterpret_cast<char*>(record), sizeof(record)))
+				counts.emplace_back(ReadLittleEndian32(record), ReadLittleEndian32(record + 4));
+			return file.gcount() == 0; // Not part way through a record.
+		}
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::string_view text = std::string_view(line).substr(0, line.find(';'));
+			size_t start = text.find_first_not_of(s_Blanks);
+			if (start == std::string_view::npos)
+				continue;
+			text.remove_prefix(start);
+
+			if (text.starts_with("0x") || text.starts_with("0X"))
+				text.remove_prefix(2);
+			else if (text.starts_with('$'))
+				text.remove_prefix(1);
+
+			ExecutionCount& count = counts.emplace_back();
+			const char* end = text.data() + text.size();
+			auto [addressEnd, addressError] = std::from_chars(text.data(), end, count.address, 16);
+			if (addressError != std::errc() || addressEnd == end || s_Blanks.find(*addressEnd) == std::string_view::npos)
+				return false;
+
+			std::string_view rest = std::string_view(addressEnd, end - addressEnd);
+			rest.remove_prefix(std::min(rest.find_first_not_of(s_Blanks), rest.size()));
+			auto [countEnd, countError] = std::from_chars(rest.data(), rest.data() + rest.size(), count.count);
+			if (countError != std::errc() || std::string_view(countEnd, rest.data() + rest.size() - countEnd).find_first_not_of(s_Blanks) != std::string_view::npos)
+				return false;
+		}
+		return true;
+	}
+
+	// Returns the index of the first line that can't be sized, or the line count if there isn't one.
+	// A .org has no size, and moves what's after it without changing its size, so it isn't one.
+	static size_t SizeLines(const std::pmr::vector<TokenizedLine>& tokenizedLines, std::pmr::vector<uint32_t>& sizes)
+	{
+		FlowScan flow;
+		size_t firstUnsizedLineIndex = tokenizedLines.size();
+		for (size_t lineIndex = 0; lineIndex < tokenizedLines.size(); lineIndex++)
+		{
+			LineKind kind = flow.Visit(tokenizedLines[lineIndex]);
+			if (kind == LineKind_Data || kind == LineKind_Instruction)
+				sizes[lineIndex] = flow.Info().costs[AssemblyMode_ADL].size;
+			else
+			{
+				sizes[lineIndex] = 0;
+				if (kind == LineKind_UnsizedPreprocessor || kind == LineKind_Directive || kind == LineKind_MacroInvocation)
+					firstUnsizedLineIndex = std::min(firstUnsizedLineIndex, lineIndex);
+			}
+		}
+		return firstUnsizedLineIndex;
+	}
+
+	uint64_t OrderRoutinesByProfile(std::pmr::vector<TokenizedLine>& tokenizedLines, std::span<const ExecutionCount> counts,
+		uint32_t origin, const ExpressionResolver& resolve, bool relaxBranches)
+	{
+		PROFILE_FUNCTION();
+
+		std::pmr::memory_resource* arena = tokenizedLines.get_allocator().resource();
+		size_t lineCount = tokenizedLines.size();
+
+		// The counts are of the program as it was before, with every branch RelaxBranches shortens shortened,
+		// so that's laid out again here, and then undone for RelaxBranches to do again after reordering.
+		std::pmr::vector<uint32_t> sizes(lineCount, 0, arena);
+		std::pmr::vector<uint32_t> profiledSizes(lineCount, 0, arena);
+		size_t firstUnsizedLineIndex = SizeLines(tokenizedLines, sizes);
+		if (relaxBranches)
+		{
+			std::pmr::vector<std::pair<size_t, std::string_view>> mnemonics(arena);
+			for (size_t lineIndex = 0; lineIndex < lineCount; lineIndex++)
+				if (util::string::EqualsIgnoreCase(tokenizedLines[lineIndex][0], std::string_view("jp")))
+					mnemonics.emplace_back(lineIndex, tokenizedLines[lineIndex][0]);
+
+			std::vector<AssemblerRewrite> rewrites;
+			RelaxBranches(tokenizedLines, AssemblyMode_ADL, rewrites);
+			SizeLines(tokenizedLines, profiledSizes);
+			for (auto [lineIndex, mnemonic] : mnemonics)
+				*tokenizedLines[lineIndex].begin() = mnemonic;
+		}
+		else
+			profiledSizes = sizes;
+
+		// Count how many times every line ran, at the addresses BuildLayout would give them. Where lines after one that
+		// can't be sized, or a .org that can't be evaluated, were isn't known, so they get no hits.
+		std::pmr::vector<uint64_t> lineHits(lineCount, 0, arena);
+		{
+			struct LineAddress
+			{
+				uint32_t address = 0;
+				size_t lineIndex = 0;
+			};
+			std::pmr::vector<LineAddress> lineAddresses(arena); // Of every line that emits bytes.
+			uint32_t offset = 0;
+			uint32_t addressBase = origin; // The address of offset 0, as of the last .org.
+			for (size_t lineIndex = 0; lineIndex < firstUnsizedLineIndex; lineIndex++)
+			{
+				const TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+				if (util::string::EqualsIgnoreCase(tokenizedLine[0], std::string_view(".org")))
+				{
+					int64_t address = 0;
+					if (tokenizedLine.tokenCount != 2 || !EvaluateExpression(tokenizedLine[1], resolve, address))
+						break;
+					addressBase = static_cast<uint32_t>(address) - offset;
+					continue;
+				}
+				if (profiledSizes[lineIndex] == 0)
+					continue;
+				lineAddresses.emplace_back((addressBase + offset) & 0xFFFFFF, lineIndex);
+				offset += profiledSizes[lineIndex];
+			}
+
+			// A .org can move addresses back. Where two lines share an address, the first one gets its hits.
+			std::stable_sort(lineAddresses.begin(), lineAddresses.end(), [](const LineAddress& left, const LineAddress& right) { return left.address < right.address; });
+			for (const ExecutionCount& count : counts)
+			{
+				auto it = std::upper_bound(lineAddresses.begin(), lineAddresses.end(), count.address, [](uint32_t address, const LineAddress& line) { return address < line.address; });
+				if (it == lineAddresses.begin())
+					continue;
+				uint32_t lineAddress = (--it)->address;
+				while (it != lineAddresses.begin() && std::prev(it)->address == lineAddress)
+					--it;
+				if (count.address < lineAddress + profiledSizes[it->lineIndex])
+					lineHits[it->lineIndex] += count.count;
+			}
+		}
+
+		// Split the lines into chains, and find every branch to a label.
+		// Everything before the first label is the entry point, and stays first.
+		std::pmr::vector<Chain> chains(1, arena);
+		chains[0].pinned = true;
+		std::pmr::unordered_map<std::string_view, size_t> labels(arena);
+		std::pmr::vector<ChainBranch> branches(arena);
+		{
+			FlowScan flow;
+			std::pmr::vector<std::string_view> qualifiedTargets(arena); // Parallel to branches, resolved once every label is known.
+			std::pmr::vector<std::string_view> unqualifiedTargets(arena);
+			size_t namespaceDepth = 0;
+
+			auto PinEmptyLabel = [&chains](bool afterEmptyLabel)
+			{
+				if (!afterEmptyLabel)
+					return;
+				chains.back().pinned = true;
+				if (chains.size() > 1)
+					chains[chains.size() - 2].pinned = true;
+			};
+
+			auto StartChain = [&chains](size_t lineIndex, bool pinned)
+			{
+				chains.back().endLineIndex = lineIndex;
+				Chain& chain = chains.emplace_back();
+				chain.firstLineIndex = lineIndex;
+				chain.pinned = pinned;
+			};
+
+			for (size_t lineIndex = 0; lineIndex < lineCount; lineIndex++)
+			{
+				const TokenizedLine& tokenizedLine = tokenizedLines[lineIndex];
+				bool topLevel = namespaceDepth == 0;
+				bool fallenInto = flow.FallsThrough();
+				bool afterEmptyLabel = flow.AfterEmptyLabel();
+				switch (flow.Visit(tokenizedLine))
+				{
+					case LineKind_Label:
+					{
+						labels.emplace(flow.Scope().Qualify(GetLabelName(tokenizedLine), arena), lineIndex);
+						PinEmptyLabel(afterEmptyLabel);
+						if (topLevel && !fallenInto)
+							StartChain(lineIndex, false);
+						continue;
+					}
+					case LineKind_NamespaceBegin:
+					{
+						if (topLevel && !fallenInto)
+							StartChain(lineIndex, false);
+						namespaceDepth++;
+						continue;
+					}
+					case LineKind_NamespaceEnd:
+					{
+						namespaceDepth--;
+						continue;
+					}
+					case LineKind_Preprocessor:
+					case LineKind_UnsizedPreprocessor:
+					case LineKind_MacroBody:
+					{
+						// Conditionals could span chains, and macros and defines could be used from anywhere after them.
+						if (topLevel && !fallenInto)
+							StartChain(lineIndex, true);
+						chains.back().pinned = true;
+						continue;
+					}
+					case LineKind_Origin:
+					case LineKind_Directive:
+					{
+						// Like .org and .assume, which change everything after them.
+						chains.back().pinned = true;
+						continue;
+					}
+					case LineKind_Data:
+						continue;
+					case LineKind_MacroInvocation:
+					{
+						// Its size isn't known, so nothing can be placed relative to it.
+						chains.back().pinned = true;
+						continue;
+					}
+				}
+
+				const InstructionInfo& info = flow.Info();
+				std::string_view target = GetBranchLabel(tokenizedLine);
+				if (!(info.flags & InstructionFlags_Branch) || target.empty())
+					continue;
+
+				std::string_view token0 = tokenizedLine[0];
+				ChainBranch& branch = branches.emplace_back();
+				branch.lineIndex = lineIndex;
+				branch.relative = util::string::EqualsIgnoreCase(token0, std::string_view("jr")) || util::string::EqualsIgnoreCase(token0, std::string_view("djnz"));
+
+				if (InstructionInfo shortInfo; LookupShortBranch(tokenizedLine, shortInfo))
+				{
+					const InstructionCost& longCost = info.costs[AssemblyMode_ADL];
+					const InstructionCost& shortCost = shortInfo.costs[AssemblyMode_ADL];
+					branch.relaxable = true;
+					branch.shortSize = shortCost.size;
+
+					// Whether a conditional one is taken isn't known, so it's counted as whichever saves less.
+					branch.cyclesSaved = static_cast<int64_t>(longCost.takenCycles) - shortCost.takenCycles;
+					if (info.flags & InstructionFlags_Conditional)
+						branch.cyclesSaved = std::min<int64_t>(branch.cyclesSaved, static_cast<int64_t>(longCost.cycles) - shortCost.cycles);
+				}
+				qualifiedTargets.push_back(flow.Scope().Qualify(target, arena));
+				unqualifiedTargets.push_back(target);
+			}
+			chains.back().endLineIndex = lineCount;
+			PinEmptyLabel(flow.AfterEmptyLabel());
+
+			// Whatever comes after the last line once it's moved isn't what it runs into now.
+			if (flow.FallsThrough())
+				chains.back().pinned = true;
+
+			// Labels in the enclosing namespace shadow global ones, the same way they are defined.
+			size_t resolvedCount = 0;
+			for (size_t i = 0; i < branches.size(); i++)
+			{
+				auto it = labels.find(qualifiedTargets[i]);
+				if (it == labels.end())
+					it = labels.find(unqualifiedTargets[i]);
+				if (it == labels.end())
+				{
+					// Likely a constant address, which moving the branch would take out of range.
+					if (branches[i].relative)
+						branches[i].targetLineIndex = branches[i].lineIndex;
+					else
+						continue;
+				}
+				else
+					branches[i].targetLineIndex = it->second;
+				branches[resolvedCount++] = branches[i];
+			}
+			branches.resize(resolvedCount);
+		}
+
+		std::pmr::vector<size_t> lineChains(lineCount, 0, arena);
+		for (size_t chainIndex = 0; chainIndex < chains.size(); chainIndex++)
+		{
+			Chain& chain = chains[chainIndex];
+			for (size_t lineIndex = chain.firstLineIndex; lineIndex < chain.endLineIndex; lineIndex++)
+			{
+				lineChains[lineIndex] = chainIndex;
+				chain.size += sizes[lineIndex];
+				chain.hits += lineHits[lineIndex];
+			}
+		}
+
+		// Short branches already written pin both ends, as does one to an address that isn't a label.
+		for (const ChainBranch& branch : branches)
+		{
+			size_t from = lineChains[branch.lineIndex];
+			size_t to = lineChains[branch.targetLineIndex];
+			if (branch.relative && (from != to || branch.targetLineIndex == branch.lineIndex))
+				chains[from].pinned = chains[to].pinned = true;
+		}
+
+		for (size_t chainIndex = 0, segment = 0; chainIndex < chains.size(); chainIndex++)
+		{
+			Chain& chain = chains[chainIndex];
+			if (chain.pinned)
+				segment++;
+			chain.segment = segment;
+			chain.parent = chainIndex;
+			chain.last = chainIndex;
+			chain.clusterSize = chain.size;
+			chain.clusterHits = chain.hits;
+		}
+
+		// How often each pair of chains that can be moved next to each other branch to one another, either way.
+		struct Edge
+		{
+			size_t first = 0;
+			size_t second = 0;
+			uint64_t hits = 0;
+		};
+		std::pmr::vector<Edge> edges(arena);
+		{
+			std::pmr::unordered_map<uint64_t, size_t> edgeIndices(arena);
+			for (const ChainBranch& branch : branches)
+			{
+				size_t from = lineChains[branch.lineIndex];
+				size_t to = lineChains[branch.targetLineIndex];
+				uint64_t hits = lineHits[branch.lineIndex];
+				if (from == to || hits == 0 || chains[from].pinned || chains[to].pinned || chains[from].segment != chains[to].segment)
+					continue;
+
+				size_t first = std::min(from, to);
+				size_t second = std::max(from, to);
+				auto [it, inserted] = edgeIndices.try_emplace((static_cast<uint64_t>(first) << 32) | second, edges.size());
+				if (inserted)
+					edges.emplace_back(first, second);
+				edges[it->second].hits += hits;
+			}
+		}
+		std::sort(edges.begin(), edges.end(), [](const Edge& left, const Edge& right)
+		{
+			if (left.hits != right.hits)
+				return left.hits > right.hits;
+			return left.first != right.first ? left.first < right.first : left.second < right.second;
+		});
+
+		auto FindCluster = [&chains](size_t chainIndex)
+		{
+			size_t root = chainIndex;
+			while (chains[root].parent != root)
+				root = chains[root].parent;
+			while (chains[chainIndex].parent != root)
+				chainIndex = std::exchange(chains[chainIndex].parent, root);
+			return root;
+		};
+
+		// Hottest pair first, join the clusters of both ends, so that the two ends meet if they're at the ends of their clusters.
+		for (const Edge& edge : edges)
+		{
+			size_t first = FindCluster(edge.first);
+			size_t second = FindCluster(edge.second);
+			if (first == second)
+				continue;
+			if (chains[second].last == edge.second && first == edge.first)
+				std::swap(first, second);
+
+			Chain& cluster = chains[first];
+			Chain& appended = chains[second];
+			chains[cluster.last].next = second;
+			cluster.last = appended.last;
+			cluster.clusterSize += appended.clusterSize;
+			cluster.clusterHits += appended.clusterHits;
+			appended.parent = first;
+		}
+
+		// Within each run of chains between pinned ones, lay out the hottest clusters for their size first.
+		// Clusters that never ran keep their order, after every one that did.
+		std::pmr::vector<size_t> order(arena);
+		order.reserve(chains.size());
+		{
+			std::pmr::vector<size_t> clusters(arena);
+			auto Density = [&chains](size_t cluster)
+			{
+				const Chain& chain = chains[cluster];
+				return chain.clusterHits == 0 ? 0.0 : static_cast<double>(chain.clusterHits) / static_cast<double>(std::max<uint64_t>(chain.clusterSize, 1));
+			};
+
+			for (size_t chainIndex = 0; chainIndex < chains.size();)
+			{
+				if (chains[chainIndex].pinned)
+				{
+					order.push_back(chainIndex++);
+					continue;
+				}
+
+				clusters.clear();
+				size_t segment = chains[chainIndex].segment;
+				for (; chainIndex < chains.size() && !chains[chainIndex].pinned && chains[chainIndex].segment == segment; chainIndex++)
+					if (FindCluster(chainIndex) == chainIndex)
+						clusters.push_back(chainIndex);
+
+				std::sort(clusters.begin(), clusters.end(), [&Density](size_t left, size_t right)
+				{
+					double leftDensity = Density(left);
+					double rightDensity = Density(right);
+					return leftDensity != rightDensity ? leftDensity > rightDensity : left < right;
+				});
+				for (size_t cluster : clusters)
+					for (size_t i = cluster; i != s_NoChain; i = chains[i].next)
+						order.push_back(i);
+			}
+		}
+
+		// Only branches that jr could reach in one order but not the other change anything.
+		// Every branch is counted as long, since whether the others around it end up short isn't known yet.
+		std::pmr::vector<int64_t> lineOffsets(lineCount, 0, arena);
+		auto EstimateCycles = [&](std::span<const size_t> chainOrder)
+		{
+			int64_t offset = 0;
+			for (size_t chainIndex : chainOrder)
+			{
+				for (size_t lineIndex = chains[chainIndex].firstLineIndex; lineIndex < chains[chainIndex].endLineIndex; lineIndex++)
+				{
+					lineOffsets[lineIndex] = offset;
+					offset += sizes[lineIndex];
+				}
+			}
+
+			int64_t cyclesSaved = 0;
+			for (const ChainBranch& branch : branches)
+			{
+				if (!branch.relaxable)
+					continue;
+				int64_t displacement = lineOffsets[branch.targetLineIndex] - (lineOffsets[branch.lineIndex] + branch.shortSize);
+				if (displacement >= s_ShortBranchMin && displacement <= s_ShortBranchMax)
+					cyclesSaved += static_cast<int64_t>(lineHits[branch.lineIndex]) * branch.cyclesSaved;
+			}
+			return cyclesSaved;
+		};
+
+		std::pmr::vector<size_t> originalOrder(chains.size(), 0, arena);
+		for (size_t i = 0; i < originalOrder.size(); i++)
+			originalOrder[i] = i;
+		int64_t cyclesSaved = EstimateCycles(order) - EstimateCycles(originalOrder);
+		if (cyclesSaved <= 0)
+			return 0;
+
+		std::pmr::vector<TokenizedLine> orderedLines(arena);
+		orderedLines.reserve(lineCount);
+		for (size_t chainIndex : order)
+			orderedLines.insert(orderedLines.end(), tokenizedLines.begin() + chains[chainIndex].firstLineIndex, tokenizedLines.begin() + chains[chainIndex].endLineIndex);
+		tokenizedLines.swap(orderedLines);
+		return static_cast<uint64_t>(cyclesSaved);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include "EZ80Assembler.h"
+#include "Expression.h"
+#include <filesystem>
+
+namespace ez80
+{
+	// How many times the instruction at an address ran, e.g. from an emulator's trace.
+	struct ExecutionCount
+	{
+		uint32_t address = 0;
+		uint64_t count = 0;
+	};
+
+	// Text files have one address and count per line, the address in hex with or without a 0x or $ prefix,
+	// and the count in decimal, with anything after a ; ignored. .bin files are little endian records
+	// of a 32-bit address followed by a 32-bit count.
+	bool ReadExecutionProfile(const std::filesystem::path& filepath, std::vector<ExecutionCount>& counts);
+
+	// Reorders routines so that those branching to each other most often, by the counts, are next to each other,
+	// and the hottest come first, so that more branches end up in range of jr. The counts have to be of the program
+	// assembled from the same source with the same options, without a profile, and loaded at origin.
+	// Every .org is evaluated with resolve, as BuildLayout does, to find which line each address is.
+	// Routines are moved along with every routine they fall into, and whole namespaces are moved as one.
+	// Nothing is moved past a .org, a preprocessor statement, a macro invocation, or anything a jr or djnz in or out of it depends on.
+	// Counts past the first line that can't be sized, like an #include or a macro invocation, or a .org that can't be
+	// evaluated, are ignored.
+	// Returns the estimated cycles saved over the profiled run, and leaves the order as is unless that's positive.
+	uint64_t OrderRoutinesByProfile(std::pmr::vector<TokenizedLine>& tokenizedLines, std::span<const ExecutionCount> counts,
+		uint32_t origin, const ExpressionResolver& resolve, bool relaxBranches);
+}
@@ -0,0 +1,376 @@
+#include "Project.h"
+#include "AssemblerArena.h"
+#include "PlatformSymbols.h"
+#include "ThreadPool.h"
+#include "Profile.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ez80
+{
+	static constexpr std::string_view s_Whitespace = " \t\r";
+
+	static std::string_view Trim(std::string_view string) noexcept
+	{
+		size_t start = string.find_first_not_of(s_Whitespace);
+		if (start == std::string_view::npos)
+			return {};
+		return string.substr(start, string.find_last_not_of(s_Whitespace) - start + 1);
+	}
+
+	static std::filesystem::path Resolve(const std::filesystem::path& directory, std::string_view path)
+	{
+		return (directory / std::filesystem::path(path)).lexically_normal();
+	}
+
+	ProjectError ReadProjectManifest(const std::filesystem::path& filepath, std::vector<ProjectProgram>& programs)
+	{
+		PROFILE_FUNCTION();
+
+		std::ifstream file(filepath);
+		if (!file.is_open())
+			return ProjectError_FailedToReadManifest;
+
+		std::filesystem::path directory = filepath.parent_path();
+		ProjectProgram shared; // Settings before the first program.
+		ProjectProgram* program = &shared;
+		size_t firstProgram = programs.size();
+
+		std::string line;
+		size_t lineNumber = 0;
+		for (; std::getline(file, line); lineNumber++)
+		{
+			std::string_view setting = Trim(std::string_view(line).substr(0, line.find(';')));
+			if (setting.empty())
+				continue;
+
+			size_t keyEnd = std::min(setting.find_first_of(s_Whitespace), setting.size());
+			std::string_view key = setting.substr(0, keyEnd);
+			std::string_view value = Trim(setting.substr(keyEnd));
+			if (value.empty())
+				return { ProjectError_MissingValue, lineNumber };
+
+			if (key == "program")
+			{
+				if (program != &shared && program->inputFilepath.empty())
+					return { ProjectError_MissingInputFile, lineNumber };
+				if (program != &shared && program->outputFilepath.empty())
+					return { ProjectError_MissingOutputFile, lineNumber };
+
+				program = &programs.emplace_back(shared);
+				program->name = value;
+			}
+			else if (key == "input" || key == "output")
+			{
+				if (program == &shared)
+					return { ProjectError_SettingOutsideProgram, lineNumber };
+				(key == "input" ? program->inputFilepath : program->outputFilepath) = Resolve(directory, value);
+			}
+			else if (key == "include")
+				program->includeDirectories.push_back(Resolve(directory, value));
+			else if (key == "define")
+			{
+				size_t nameEnd = std::min(value.find_first_of(s_Whitespace), value.size());
+				std::string_view defineValue = Trim(value.substr(nameEnd));
+				program->defines.emplace_back(std::string(value.substr(0, nameEnd)), std::string(defineValue.empty() ? "1" : defineValue));
+			}
+			else
+				return { ProjectError_UnknownKey, lineNumber };
+		}
+
+		// The last program is only checked once the manifest ends, so its errors are reported on the line after.
+		if (programs.size() > firstProgram && programs.back().inputFilepath.empty())
+			return { ProjectError_MissingInputFile, lineNumber };
+		if (programs.size() > firstProgram && programs.back().outputFilepath.empty())
+			return { ProjectError_MissingOutputFile, lineNumber };
+		return ProjectError_None;
+	}
+
+	static uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start) noexcept
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	namespace
+	{
+		struct FileNode
+		{
+			std::filesystem::path filepath;
+			ParsedSource source;
+			std::vector<std::pair<std::string_view, size_t>> includes; // The quotes are stripped, along with their line number.
+			uint64_t parseNanoseconds = 0;
+			bool parsed = false;
+		};
+
+		// Everything a program uses is parsed first, in parallel, and each program is assembled as soon as its last file is.
+		// Files are nodes of the graph keyed by their path, so a file shared by many programs, or included
+		// many times, is only parsed once.
+		class ProjectScheduler
+		{
+		public:
+			ProjectScheduler(const ProjectInfo& info, ProjectResult& result)
+				: info(info), result(result), pool(info.threadCount), states(info.programs.size()) {}
+
+			void Build()
+			{
+				{
+					std::scoped_lock lock(mutex);
+					for (size_t i = 0; i < info.programs.size(); i++)
+						Visit(i);
+				}
+				pool.Wait();
+				result.parsedFileCount = files.size();
+			}
+		private:
+			enum ProgramState_ : uint8_t
+			{
+				ProgramState_Waiting,
+				ProgramState_Started,
+			};
+			using ProgramState = std::underlying_type_t<ProgramState_>;
+
+			// Locked. Returns nullptr if filepath doesn't exist.
+			FileNode* GetFile(const std::filesystem::path& filepath)
+			{
+				// Every program looks up its includes again whenever a file is parsed, so lookups are cached by the path
+				// as given, and the file system is only asked once per path.
+				auto [resolved, inserted] = resolvedFiles.try_emplace(filepath.lexically_normal().string());
+				if (!inserted)
+					return resolved->second;
+
+				std::error_code error;
+				if (!std::filesystem::is_regular_file(filepath, error))
+					return resolved->second = nullptr;
+
+				std::filesystem::path key = std::filesystem::weakly_canonical(filepath, error);
+				if (error)
+					key = filepath.lexically_normal();
+
+				std::unique_ptr<FileNode>& file = files[key.string()];
+				if (!file)
+				{
+					file = std::make_unique<FileNode>();
+					file->filepath = std::move(key);
+					pool.Submit([this, node = file.get()] { Parse(*node); });
+				}
+				return resolved->second = file.get();
+			}
+
+			void Parse(FileNode& file)
+			{
+				auto start = std::chrono::steady_clock::now();
+				if (!ParseSource(file.filepath, info.settings.limits, file.source))
+				{
+					const ParsedSource& source = file.source;
+					for (const TokenizedLineView& view : source.tokenizedLineViews)
+					{
+						if (view.tokenCount != 2 || source.tokens[view.start] != "#include")
+							continue;
+
+						std::string_view include = source.tokens[view.start + 1];
+						if (include.size() >= 2 && include.front() == '"' && include.back() == '"')
+							include = include.substr(1, include.size() - 2);
+						file.includes.emplace_back(include, view.lineNumber);
+					}
+				}
+				file.parseNanoseconds = NanosecondsSince(start);
+
+				std::scoped_lock lock(mutex);
+				file.parsed = true;
+				for (size_t i = 0; i < info.programs.size(); i++)
+					if (states[i] == ProgramState_Waiting)
+						Visit(i);
+			}
+
+			// Locked. Walks everything the program uses, scheduling whatever hasn't been, and starts the program once it's all parsed.
+			void Visit(size_t programIndex)
+			{
+				const ProjectProgram& program = info.programs[programIndex];
+				ProjectProgramResult& programResult = result.programs[programIndex];
+
+				FileNode* input = GetFile(program.inputFilepath);
+				if (!input)
+				{
+					// Assemble reports the missing file itself.
+					Start(programIndex, nullptr, 0);
+					return;
+				}
+
+				std::vector<FileNode*> stack{ input };
+				std::unordered_set<FileNode*> visited{ input };
+				std::vector<AssemblerWarning> missingIncludes;
+				bool ready = true;
+				uint64_t longestParse = 0;
+				while (!stack.empty())
+				{
+					FileNode* file = stack.back();
+					stack.pop_back();
+					if (!file->parsed)
+					{
+						ready = false;
+						continue;
+					}
+					longestParse = std::max(longestParse, file->parseNanoseconds);
+
+					// The input's own parse errors are reported by Assemble, an include's are reported here.
+					if (file != input && file->source.error)
+					{
+						programResult.result.Error(file->source.error);
+						programResult.errorFilepath = file->filepath;
+						states[programIndex] = ProgramState_Started;
+						return;
+					}
+
+					for (auto [include, lineNumber] : file->includes)
+					{
+						if (info.settings.builtinPlatformInclude && IsPlatformInclude(include))
+							continue;
+
+						FileNode* included = nullptr;
+						if (!(included = GetFile(file->filepath.parent_path() / include)))
+							for (const std::filesystem::path& directory : program.includeDirectories)
+								if ((included = GetFile(directory / include)))
+									break;
+
+						if (!included)
+							missingIncludes.emplace_back(AssemblerWarning_IncludeNotFound, lineNumber);
+						else if (visited.insert(included).second)
+							stack.push_back(included);
+					}
+				}
+
+				if (ready)
+				{
+					programResult.result.warnings = std::move(missingIncludes);
+					Start(programIndex, input, longestParse);
+				}
+			}
+
+			// Locked.
+			void Start(size_t programIndex, FileNode* input, uint64_t longestParse)
+			{
+				states[programIndex] = ProgramState_Started;
+				pool.Submit([this, programIndex, input, longestParse] { AssembleProgram(programIndex, input, longestParse); });
+			}
+
+			void AssembleProgram(size_t programIndex, FileNode* input, uint64_t longestParse)
+			{
+				// Assemble isn't given the caller's memory resource, since it's shared by every thread.
+				// Each worker keeps an arena of its own instead, so programs after its first allocate almost nothing.
+				thread_local AssemblerArena t_Arena;
+
+				const ProjectProgram& program = info.programs[programIndex];
+				AssemblerInfo assemblerInfo = info.settings;
+				assemblerInfo.inputFilepath = program.inputFilepath;
+				assemblerInfo.outputFilepath = program.outputFilepath;
+				assemblerInfo.includeDirectories = program.includeDirectories;
+				assemblerInfo.defines.insert(assemblerInfo.defines.end(), program.defines.begin(), program.defines.end());
+				assemblerInfo.parsedInput = input ? &input->source : nullptr;
+				assemblerInfo.memoryResource = t_Arena.Resource();
+
+				auto start = std::chrono::steady_clock::now();
+				ProjectProgramResult& programResult = result.programs[programIndex];
+				std::vector<AssemblerWarning> missingIncludes = std::move(programResult.result.warnings);
+				programResult.result = ez80::Assemble(assemblerInfo);
+				programResult.result.warnings.insert(programResult.result.warnings.end(), missingIncludes.begin(), missingIncludes.end());
+				programResult.errorFilepath = program.inputFilepath;
+				programResult.nanoseconds = NanosecondsSince(start);
+				t_Arena.Reset();
+
+				std::scoped_lock lock(mutex);
+				result.criticalPathNanoseconds = std::max(result.criticalPathNanoseconds, longestParse + programResult.nanoseconds);
+			}
+
+			const ProjectInfo& info;
+			ProjectResult& result;
+			ThreadPool pool;
+
+			std::mutex mutex; // Guards everything below, and every FileNode's parsed, includes and parseNanoseconds once submitted.
+			std::unordered_map<std::string, std::unique_ptr<FileNode>> files; // By canonical path.
+			std::unordered_map<std::string, FileNode*> resolvedFiles; // By path as given, nullptr if it doesn't exist.
+			std::vector<ProgramState> states;
+		};
+	}
+
+	ProjectResult BuildProject(const ProjectInfo& info)
+	{
+		PROFILE_FUNCTION();
+
+		auto start = std::chrono::steady_clock::now();
+		ProjectResult result;
+		result.programs.resize(info.programs.size());
+
+		ProjectScheduler scheduler(info, result);
+		scheduler.Build();
+
+		result.nanoseconds = NanosecondsSince(start);
+		return result;
+	}
+
+	// Empty paths stay empty, so that only the files info asks for are written. Not a dot, since some of these paths
+	// have their extension replaced, and one without would lose the name.
+	static std::filesystem::path VariantFilepath(const std::filesystem::path& filepath, std::string_view name)
+	{
+		if (filepath.empty())
+			return {};
+
+		std::filesystem::path filename = filepath.stem();
+		filename += '-';
+		filename += name;
+		filename += filepath.extension();
+		return std::filesystem::path(filepath).replace_filename(filename);
+	}
+
+	AssemblerVariantsResult AssembleVariants(const AssemblerInfo& info, const std::vector<AssemblerVariant>& variants, uint32_t threadCount)
+	{
+		PROFILE_FUNCTION();
+
+		auto start = std::chrono::steady_clock::now();
+		AssemblerVariantsResult result;
+		result.variants.resize(variants.size());
+
+		// A parse failure is left for every variant's Assemble to report, after the checks it makes first.
+		ParsedSource parsedSource;
+		const ParsedSource* parsedInput = info.parsedInput;
+		if (!parsedInput)
+		{
+			ParseSource(info.inputFilepath, info.limits, parsedSource);
+			parsedInput = &parsedSource;
+			result.parseNanoseconds = NanosecondsSince(start);
+		}
+
+		{
+			ThreadPool pool(threadCount);
+			for (size_t i = 0; i < variants.size(); i++)
+			{
+				pool.Submit([&info, &variants, &result, parsedInput, i]
+				{
+					// The same as in BuildProject, each worker assembles into an arena of its own.
+					thread_local AssemblerArena t_Arena;
+
+					const AssemblerVariant& variant = variants[i];
+					AssemblerInfo assemblerInfo = info;
+					assemblerInfo.outputFilepath = variant.outputFilepath;
+					assemblerInfo.defines.insert(assemblerInfo.defines.end(), variant.defines.begin(), variant.defines.end());
+					assemblerInfo.parsedInput = parsedInput;
+					assemblerInfo.memoryResource = t_Arena.Resource();
+					assemblerInfo.objectFilepath = VariantFilepath(info.objectFilepath, variant.name);
+					assemblerInfo.cycleReportFilepath = VariantFilepath(info.cycleReportFilepath, variant.name);
+					assemblerInfo.listingFilepath = VariantFilepath(info.listingFilepath, variant.name);
+					assemblerInfo.profileFilepath = VariantFilepath(info.profileFilepath, variant.name);
+
+					result.variants[i] = ez80::Assemble(assemblerInfo);
+					t_Arena.Reset();
+				});
+			}
+			pool.Wait();
+		}
+
+		result.nanoseconds = NanosecondsSince(start);
+		return result;
+	}
+}
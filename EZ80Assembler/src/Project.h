@@ -0,0 +1,98 @@
+#pragma once
+
+#include "EZ80Assembler.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ez80
+{
+	enum ProjectError_ : uint32_t
+	{
+		ProjectError_None = 0,
+
+		ProjectError_FailedToReadManifest,
+		ProjectError_UnknownKey,
+		ProjectError_MissingValue,
+		ProjectError_SettingOutsideProgram, // input or output before the first program.
+		ProjectError_MissingInputFile, // A program without an input.
+		ProjectError_MissingOutputFile, // A program without an output.
+	};
+	struct ProjectError
+	{
+		using ID = std::underlying_type_t<ProjectError_>;
+
+		constexpr ProjectError(ID id = 0, size_t lineNumber = 0) noexcept
+			: id(id), lineNumber(lineNumber + 1) {}
+
+		constexpr operator ID() const noexcept { return id; }
+
+		ID id;
+		size_t lineNumber;
+	};
+
+	struct ProjectProgram
+	{
+		std::string name;
+		std::filesystem::path inputFilepath;
+		std::filesystem::path outputFilepath;
+		std::vector<std::filesystem::path> includeDirectories; // Searched in order, after the including file's own directory.
+		std::vector<AssemblerDefine> defines;
+	};
+
+	// A manifest lists programs, each starting with "program NAME" and followed by indented settings, one per line:
+	//	input file.asm, output FILE.8xp, include directory, and define NAME value.
+	// include and define lines before the first program apply to every program. Paths are relative to the manifest,
+	// and anything after a ; is a comment.
+	ProjectError ReadProjectManifest(const std::filesystem::path& filepath, std::vector<ProjectProgram>& programs);
+
+	struct ProjectInfo
+	{
+		std::vector<ProjectProgram> programs;
+
+		// Everything but the input, output, include directories, defines and memory resource applies to every program.
+		// Defines here come before each program's own.
+		AssemblerInfo settings;
+
+		uint32_t threadCount = 0; // 0 for one per hardware thread.
+	};
+
+	struct ProjectProgramResult
+	{
+		AssemblerResult result;
+		std::filesystem::path errorFilepath; // The file result.error's line number is in, either the input or one of its includes.
+		uint64_t nanoseconds = 0; // Assembling it, once everything it includes was parsed.
+	};
+
+	struct ProjectResult
+	{
+		std::vector<ProjectProgramResult> programs; // Parallel to ProjectInfo::programs.
+		size_t parsedFileCount = 0; // Every file used by any program, each parsed only once.
+		uint64_t nanoseconds = 0; // For the whole build.
+		uint64_t criticalPathNanoseconds = 0; // The longest chain of parsing a file and then assembling a program that uses it.
+	};
+
+	// Parses every program's input and includes once each, however many programs share them, and assembles every program
+	// as soon as everything it includes is parsed, all on one thread pool. Includes are found by following #include lines,
+	// and those that can't be found are reported as AssemblerWarning_IncludeNotFound.
+	ProjectResult BuildProject(const ProjectInfo& info);
+
+	// One of several builds of the same program, like a debug and a release build, see AssembleVariants.
+	struct AssemblerVariant
+	{
+		std::string name; // Goes before the extension of every file written besides the output, e.g. main-debug.lst.
+		std::filesystem::path outputFilepath;
+		std::vector<AssemblerDefine> defines; // After AssemblerInfo::defines.
+	};
+
+	struct AssemblerVariantsResult
+	{
+		std::vector<AssemblerResult> variants; // Parallel to the variants.
+		uint64_t parseNanoseconds = 0; // Reading, stripping and tokenizing the input, once for every variant.
+		uint64_t nanoseconds = 0; // For the whole build.
+	};
+
+	// Assembles info.inputFilepath once per variant, all from one parse of it, on a thread pool.
+	// Everything from finding equates on can depend on a define, so that's where the variants split.
+	AssemblerVariantsResult AssembleVariants(const AssemblerInfo& info, const std::vector<AssemblerVariant>& variants, uint32_t threadCount = 0);
+}
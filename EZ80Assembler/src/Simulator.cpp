@@ -0,0 +1,982 @@
+#include "Simulator.h"
+#include "Profile.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+namespace ez80
+{
+	namespace
+	{
+		enum Flag_ : uint8_t
+		{
+			Flag_C  = 1 << 0,
+			Flag_N  = 1 << 1,
+			Flag_PV = 1 << 2,
+			Flag_H  = 1 << 4,
+			Flag_Z  = 1 << 6,
+			Flag_S  = 1 << 7,
+		};
+
+		// Sign, zero and parity flags for every byte.
+		constexpr std::array<uint8_t, 256> s_SZP = []()
+		{
+			std::array<uint8_t, 256> table{};
+			for (uint32_t value = 0; value < 256; value++)
+			{
+				uint8_t bits = 0;
+				for (uint32_t bit = 0; bit < 8; bit++)
+					bits += (value >> bit) & 1;
+				table[value] = (value & Flag_S) | (value ? 0 : Flag_Z) | (bits & 1 ? 0 : Flag_PV);
+			}
+			return table;
+		}();
+
+		constexpr uint32_t s_AddressSpaceSize = 1 << 24;
+		constexpr uint32_t s_RAMStart = 0xD00000;
+		constexpr uint32_t s_StackTop = 0xD1A87E;
+		constexpr uint32_t s_OSFlags = 0xD00080; // The OS expects iy to point here.
+		constexpr uint32_t s_ExitAddress = 0; // Pushed as the return address of the program.
+
+		constexpr uint8_t High(uint32_t pair) noexcept { return static_cast<uint8_t>(pair >> 8); }
+		constexpr uint8_t Low(uint32_t pair) noexcept { return static_cast<uint8_t>(pair); }
+		constexpr void SetHigh(uint32_t& pair, uint8_t value) noexcept { pair = (pair & ~0xFF00u) | (value << 8); }
+		constexpr void SetLow(uint32_t& pair, uint8_t value) noexcept { pair = (pair & ~0xFFu) | value; }
+
+		class Cpu
+		{
+		public:
+			Cpu(const SimulatorInfo& info)
+				: memory(s_AddressSpaceSize), adl(info.adl)
+			{
+				mbase = static_cast<uint8_t>(info.origin >> 16);
+				sp = Mask(s_StackTop);
+				iy = Mask(s_OSFlags);
+				pc = Mask(info.entryPoint);
+				Push(s_ExitAddress);
+				cycles = 0;
+			}
+
+			// Returns false if the instruction couldn't be executed.
+			bool Step();
+
+			std::vector<uint8_t> memory;
+			uint64_t cycles = 0;
+			uint32_t pc = 0;
+			uint32_t sp = 0;
+			bool halted = false;
+
+			constexpr uint32_t Address(uint32_t address) const noexcept { return adl ? address & 0xFFFFFF : (mbase << 16) | (address & 0xFFFF); }
+			uint32_t Pop() noexcept { uint32_t value = ReadWord(sp); sp = Mask(sp + WordSize()); return value; }
+		private:
+			constexpr uint32_t WordSize() const noexcept { return adl ? 3 : 2; }
+			constexpr uint32_t Mask(uint32_t value) const noexcept { return adl ? value & 0xFFFFFF : value & 0xFFFF; }
+			constexpr uint32_t SignBit() const noexcept { return adl ? 0x800000 : 0x8000; }
+
+			uint8_t Read(uint32_t address) noexcept { cycles++; return memory[Address(address)]; }
+			void Write(uint32_t address, uint8_t value) noexcept { cycles++; memory[Address(address)] = value; }
+			uint8_t Fetch() noexcept { uint8_t value = Read(pc); pc = Mask(pc + 1); return value; }
+			int8_t FetchDisplacement() noexcept { return static_cast<int8_t>(Fetch()); }
+
+			uint32_t FetchWord() noexcept
+			{
+				uint32_t value = Fetch();
+				value |= Fetch() << 8;
+				if (adl)
+					value |= Fetch() << 16;
+				return value;
+			}
+
+			uint32_t ReadWord(uint32_t address) noexcept
+			{
+				uint32_t value = Read(address);
+				value |= Read(Mask(address + 1)) << 8;
+				if (adl)
+					value |= Read(Mask(address + 2)) << 16;
+				return value;
+			}
+
+			void WriteWord(uint32_t address, uint32_t value) noexcept
+			{
+				Write(address, static_cast<uint8_t>(value));
+				Write(Mask(address + 1), static_cast<uint8_t>(value >> 8));
+				if (adl)
+					Write(Mask(address + 2), static_cast<uint8_t>(value >> 16));
+			}
+
+			void Push(uint32_t value) noexcept { sp = Mask(sp - WordSize()); WriteWord(sp, value); }
+
+			// r[index] from the Z80 opcode tables, except (hl), with h and l optionally replaced by an index register's halves.
+			uint8_t GetRegister(uint8_t index, uint32_t hl) const noexcept
+			{
+				switch (index)
+				{
+					case 0: return High(bc);
+					case 1: return Low(bc);
+					case 2: return High(de);
+					case 3: return Low(de);
+					case 4: return High(hl);
+					case 5: return Low(hl);
+					default: return a;
+				}
+			}
+
+			void SetRegister(uint8_t index, uint8_t value, uint32_t& hl) noexcept
+			{
+				switch (index)
+				{
+					case 0: SetHigh(bc, value); break;
+					case 1: SetLow(bc, value); break;
+					case 2: SetHigh(de, value); break;
+					case 3: SetLow(de, value); break;
+					case 4: SetHigh(hl, value); break;
+					case 5: SetLow(hl, value); break;
+					default: a = value; break;
+				}
+			}
+
+			// rp[index] from the Z80 opcode tables.
+			uint32_t& Pair(uint8_t index, uint32_t& hl) noexcept
+			{
+				switch (index)
+				{
+					case 0: return bc;
+					case 1: return de;
+					case 2: return hl;
+					default: return sp;
+				}
+			}
+
+			constexpr bool Condition(uint8_t index) const noexcept
+			{
+				constexpr uint8_t masks[4] = { Flag_Z, Flag_C, Flag_PV, Flag_S };
+				bool set = f & masks[index >> 1];
+				return index & 1 ? set : !set;
+			}
+
+			uint8_t Add8(uint8_t left, uint8_t right, uint8_t carry) noexcept
+			{
+				uint32_t result = left + right + carry;
+				uint8_t byte = static_cast<uint8_t>(result);
+				f = (s_SZP[byte] & (Flag_S | Flag_Z)) | ((left ^ right ^ byte) & Flag_H) |
+					(((left ^ ~right) & (left ^ byte) & 0x80) ? Flag_PV : 0) | (result > 0xFF ? Flag_C : 0);
+				return byte;
+			}
+
+			uint8_t Sub8(uint8_t left, uint8_t right, uint8_t carry) noexcept
+			{
+				int32_t result = left - right - carry;
+				uint8_t byte = static_cast<uint8_t>(result);
+				f = (s_SZP[byte] & (Flag_S | Flag_Z)) | ((left ^ right ^ byte) & Flag_H) |
+					(((left ^ right) & (left ^ byte) & 0x80) ? Flag_PV : 0) | Flag_N | (result < 0 ? Flag_C : 0);
+				return byte;
+			}
+
+			void Alu(uint8_t operation, uint8_t value) noexcept
+			{
+				switch (operation)
+				{
+					case 0: a = Add8(a, value, 0); break;
+					case 1: a = Add8(a, value, f & Flag_C); break;
+					case 2: a = Sub8(a, value, 0); break;
+					case 3: a = Sub8(a, value, f & Flag_C); break;
+					case 4: a &= value; f = s_SZP[a] | Flag_H; break;
+					case 5: a ^= value; f = s_SZP[a]; break;
+					case 6: a |= value; f = s_SZP[a]; break;
+					case 7: Sub8(a, value, 0); break;
+				}
+			}
+
+			uint8_t Increment(uint8_t value) noexcept
+			{
+				uint8_t result = value + 1;
+				f = (f & Flag_C) | (s_SZP[result] & (Flag_S | Flag_Z)) | ((value & 0x0F) == 0x0F ? Flag_H : 0) | (value == 0x7F ? Flag_PV : 0);
+				return result;
+			}
+
+			uint8_t Decrement(uint8_t value) noexcept
+			{
+				uint8_t result = value - 1;
+				f = (f & Flag_C) | Flag_N | (s_SZP[result] & (Flag_S | Flag_Z)) | ((value & 0x0F) == 0 ? Flag_H : 0) | (value == 0x80 ? Flag_PV : 0);
+				return result;
+			}
+
+			uint32_t AddWide(uint32_t left, uint32_t right) noexcept
+			{
+				uint32_t result = left + right;
+				f = (f & (Flag_S | Flag_Z | Flag_PV)) | (((left ^ right ^ result) >> 8) & Flag_H) | (result > Mask(~0u) ? Flag_C : 0);
+				return Mask(result);
+			}
+
+			uint32_t AdcWide(uint32_t left, uint32_t right) noexcept
+			{
+				uint32_t result = left + right + (f & Flag_C);
+				uint32_t masked = Mask(result);
+				f = (masked & SignBit() ? Flag_S : 0) | (masked ? 0 : Flag_Z) | (((left ^ right ^ result) >> 8) & Flag_H) |
+					((~(left ^ right) & (left ^ masked) & SignBit()) ? Flag_PV : 0) | (result > Mask(~0u) ? Flag_C : 0);
+				return masked;
+			}
+
+			uint32_t SbcWide(uint32_t left, uint32_t right) noexcept
+			{
+				int64_t result = static_cast<int64_t>(left) - right - (f & Flag_C);
+				uint32_t masked = Mask(static_cast<uint32_t>(result));
+				f = (masked & SignBit() ? Flag_S : 0) | (masked ? 0 : Flag_Z) | (((left ^ right ^ masked) >> 8) & Flag_H) |
+					(((left ^ right) & (left ^ masked) & SignBit()) ? Flag_PV : 0) | Flag_N | (result < 0 ? Flag_C : 0);
+				return masked;
+			}
+
+			// Returns false for sll, which the eZ80 doesn't have.
+			bool Rotate(uint8_t operation, uint8_t value, uint8_t& outResult) noexcept
+			{
+				uint8_t carry;
+				switch (operation)
+				{
+					case 0: carry = value >> 7; outResult = (value << 1) | carry; break;
+					case 1: carry = value & 1; outResult = (value >> 1) | (carry << 7); break;
+					case 2: carry = value >> 7; outResult = (value << 1) | (f & Flag_C); break;
+					case 3: carry = value & 1; outResult = (value >> 1) | ((f & Flag_C) << 7); break;
+					case 4: carry = value >> 7; outResult = value << 1; break;
+					case 5: carry = value & 1; outResult = (value >> 1) | (value & 0x80); break;
+					case 7: carry = value & 1; outResult = value >> 1; break;
+					default: return false;
+				}
+				f = s_SZP[outResult] | carry;
+				return true;
+			}
+
+			bool StepMain(uint8_t opcode, uint32_t& index, bool indexed);
+			bool StepBits(uint32_t& index, bool indexed);
+			bool StepExtended();
+			bool StepBlock(uint8_t opcode);
+
+			uint8_t a = 0;
+			uint8_t f = 0;
+			uint32_t bc = 0;
+			uint32_t de = 0;
+			uint32_t hl = 0;
+			uint32_t ix = 0;
+			uint32_t iy = 0;
+			uint8_t shadowA = 0;
+			uint8_t shadowF = 0;
+			uint32_t shadowBC = 0;
+			uint32_t shadowDE = 0;
+			uint32_t shadowHL = 0;
+			uint16_t i = 0;
+			uint8_t r = 0;
+			uint8_t mbase = 0;
+			bool adl = true;
+			bool iff1 = false;
+			bool iff2 = false;
+		};
+
+		bool Cpu::Step()
+		{
+			uint8_t opcode = Fetch();
+			r = (r & 0x80) | ((r + 1) & 0x7F);
+
+			// Mode suffixes are only supported when they match the current mode, making them no-ops.
+			if (opcode == 0x40 || opcode == 0x49 || opcode == 0x52 || opcode == 0x5B)
+			{
+				if (adl ? opcode != 0x5B : opcode != 0x40)
+					return false;
+				opcode = Fetch();
+			}
+
+			switch (opcode)
+			{
+				case 0xDD: return StepMain(Fetch(), ix, true);
+				case 0xFD: return StepMain(Fetch(), iy, true);
+				case 0xED: return StepExtended();
+				default: return StepMain(opcode, hl, false);
+			}
+		}
+
+		bool Cpu::StepMain(uint8_t opcode, uint32_t& index, bool indexed)
+		{
+			uint8_t x = opcode >> 6;
+			uint8_t y = (opcode >> 3) & 7;
+			uint8_t z = opcode & 7;
+			uint8_t p = y >> 1;
+			uint8_t q = y & 1;
+
+			// (hl), or (ix + d) when indexed, which must be fetched in opcode order.
+			auto MemoryOperand = [this, &index, indexed]() noexcept { return indexed ? Mask(index + FetchDisplacement()) : hl; };
+
+			if (indexed)
+			{
+				// eZ80 only index register loads, which take over some otherwise redundant prefixed opcodes.
+				switch (opcode)
+				{
+					case 0x07: case 0x17: case 0x27: Pair(p, hl) = ReadWord(MemoryOperand()); return true;
+					case 0x0F: case 0x1F: case 0x2F: WriteWord(MemoryOperand(), Pair(p, hl)); return true;
+					case 0x37: index = ReadWord(MemoryOperand()); return true;
+					case 0x3F: WriteWord(MemoryOperand(), index); return true;
+					case 0x31: (&index == &ix ? iy : ix) = ReadWord(MemoryOperand()); return true;
+					case 0x3E: WriteWord(MemoryOperand(), &index == &ix ? iy : ix); return true;
+					case 0xDD: case 0xED: case 0xFD: return false;
+				}
+			}
+
+			switch (x)
+			{
+				case 0:
+				{
+					switch (z)
+					{
+						case 0:
+						{
+							if (y == 0) // nop
+								return true;
+							if (y == 1) // ex af, af'
+							{
+								std::swap(a, shadowA);
+								std::swap(f, shadowF);
+								return true;
+							}
+							int8_t displacement = FetchDisplacement();
+							bool branch;
+							if (y == 2) // djnz
+							{
+								cycles++;
+								uint8_t b = High(bc) - 1;
+								SetHigh(bc, b);
+								branch = b != 0;
+							}
+							else // jr, jr cc
+								branch = y == 3 || Condition(y - 4);
+							if (branch)
+							{
+								pc = Mask(pc + displacement);
+								cycles++;
+							}
+							return true;
+						}
+						case 1:
+						{
+							uint32_t& pair = Pair(p, index);
+							if (q == 0) // ld rr, nn
+								pair = FetchWord();
+							else // add hl, rr
+								index = AddWide(index, Pair(p, index));
+							return true;
+						}
+						case 2:
+						{
+							switch (y)
+							{
+								case 0: Write(bc, a); break;
+								case 1: a = Read(bc); break;
+								case 2: Write(de, a); break;
+								case 3: a = Read(de); break;
+								case 4: WriteWord(FetchWord(), index); break;
+								case 5: index = ReadWord(FetchWord()); break;
+								case 6: Write(FetchWord(), a); break;
+								case 7: a = Read(FetchWord()); break;
+							}
+							return true;
+						}
+						case 3:
+						{
+							uint32_t& pair = Pair(p, index);
+							pair = Mask(q == 0 ? pair + 1 : pair - 1);
+							return true;
+						}
+						case 4:
+						case 5:
+						{
+							if (y == 6)
+							{
+								uint32_t address = MemoryOperand();
+								uint8_t value = Read(address);
+								Write(address, z == 4 ? Increment(value) : Decrement(value));
+								cycles++;
+							}
+							else
+							{
+								uint8_t value = GetRegister(y, index);
+								SetRegister(y, z == 4 ? Increment(value) : Decrement(value), index);
+							}
+							return true;
+						}
+						case 6:
+						{
+							if (y == 6)
+							{
+								uint32_t address = MemoryOperand();
+								Write(address, Fetch());
+							}
+							else
+								SetRegister(y, Fetch(), index);
+							return true;
+						}
+						case 7:
+						{
+							uint8_t keep = f & (Flag_S | Flag_Z | Flag_PV);
+							switch (y)
+							{
+								case 0: f = keep | (a >> 7); a = (a << 1) | (a >> 7); break;
+								case 1: f = keep | (a & 1); a = (a >> 1) | (a << 7); break;
+								case 2: { uint8_t carry = a >> 7; a = (a << 1) | (f & Flag_C); f = keep | carry; break; }
+								case 3: { uint8_t carry = a & 1; a = (a >> 1) | ((f & Flag_C) << 7); f = keep | carry; break; }
+								case 4:
+								{
+									uint8_t correction = 0;
+									bool carry = f & Flag_C;
+									if ((f & Flag_H) || (a & 0x0F) > 9)
+										correction |= 0x06;
+									if (carry || a > 0x99)
+									{
+										correction |= 0x60;
+										carry = true;
+									}
+									uint8_t result = (f & Flag_N) ? a - correction : a + correction;
+									f = s_SZP[result] | (f & Flag_N) | ((a ^ result) & Flag_H) | (carry ? Flag_C : 0);
+									a = result;
+									break;
+								}
+								case 5: a = ~a; f |= Flag_H | Flag_N; break;
+								case 6: f = keep | Flag_C; break;
+								case 7: f = keep | ((f & Flag_C) ? Flag_H : Flag_C); break;
+							}
+							return true;
+						}
+					}
+					break;
+				}
+				case 1:
+				{
+					if (opcode == 0x76) // halt
+					{
+						cycles++;
+						halted = true;
+						return true;
+					}
+
+					// When one side is memory, the other side uses the real h and l.
+					if (y == 6)
+						Write(MemoryOperand(), GetRegister(z, hl));
+					else if (z == 6)
+						SetRegister(y, Read(MemoryOperand()), hl);
+					else
+						SetRegister(y, GetRegister(z, index), index);
+					return true;
+				}
+				case 2:
+				{
+					Alu(y, z == 6 ? Read(MemoryOperand()) : GetRegister(z, index));
+					return true;
+				}
+				case 3:
+				{
+					switch (z)
+					{
+						case 0: // ret cc
+						{
+							cycles++;
+							if (Condition(y))
+							{
+								pc = Pop();
+								cycles += 2;
+							}
+							return true;
+						}
+						case 1:
+						{
+							if (q == 0) // pop
+							{
+								uint32_t value = Pop();
+								if (p == 3)
+								{
+									f = Low(value);
+									a = High(value);
+								}
+								else
+									Pair(p, index) = value;
+								return true;
+							}
+							switch (p)
+							{
+								case 0: pc = Pop(); cycles += 2; return true; // ret
+								case 1: std::swap(bc, shadowBC); std::swap(de, shadowDE); std::swap(hl, shadowHL); return true; // exx
+								case 2: pc = index; cycles += 2; return true; // jp (hl)
+								case 3: sp = index; return true; // ld sp, hl
+							}
+							break;
+						}
+						case 2: // jp cc, nn
+						{
+							uint32_t target = FetchWord();
+							if (Condition(y))
+							{
+								pc = target;
+								cycles++;
+							}
+							return true;
+						}
+						case 3:
+						{
+							switch (y)
+							{
+								case 0: pc = FetchWord(); cycles++; return true; // jp nn
+								case 1: return StepBits(index, indexed);
+								case 2: Fetch(); cycles++; return true; // out (n), a, ports are stubbed.
+								case 3: Fetch(); cycles++; a = 0; return true; // in a, (n)
+								case 4: // ex (sp), hl
+								{
+									uint32_t value = ReadWord(sp);
+									WriteWord(sp, index);
+									index = value;
+									return true;
+								}
+								case 5: std::swap(de, hl); return true;
+								case 6: iff1 = iff2 = false; return true;
+								case 7: iff1 = iff2 = true; return true;
+							}
+							break;
+						}
+						case 4: // call cc, nn
+						{
+							uint32_t target = FetchWord();
+							if (Condition(y))
+							{
+								Push(pc);
+								pc = target;
+							}
+							return true;
+						}
+						case 5:
+						{
+							if (q == 0) // push
+							{
+								Push(p == 3 ? (a << 8) | f : Pair(p, index));
+								return true;
+							}
+							if (p == 0) // call nn
+							{
+								uint32_t target = FetchWord();
+								Push(pc);
+								pc = target;
+								return true;
+							}
+							return false; // Repeated prefixes.
+						}
+						case 6:
+						{
+							Alu(y, Fetch());
+							return true;
+						}
+						case 7: // rst
+						{
+							Push(pc);
+							pc = y * 8;
+							cycles += 2;
+							return true;
+						}
+					}
+					break;
+				}
+			}
+
+			return false;
+		}
+
+		bool Cpu::StepBits(uint32_t& index, bool indexed)
+		{
+			// Indexed bit instructions have their displacement before the opcode, and only operate on memory.
+			uint32_t address = indexed ? Mask(index + FetchDisplacement()) : hl;
+			uint8_t opcode = Fetch();
+			uint8_t x = opcode >> 6;
+			uint8_t y = (opcode >> 3) & 7;
+			uint8_t z = opcode & 7;
+
+			bool memory = z == 6;
+			if (indexed && !memory)
+				return false;
+
+			uint8_t value = memory ? Read(address) : GetRegister(z, hl);
+			uint8_t result = value;
+			switch (x)
+			{
+				case 0:
+				{
+					if (!Rotate(y, value, result))
+						return false;
+					break;
+				}
+				case 1: // bit
+				{
+					bool set = value & (1 << y);
+					f = (f & Flag_C) | Flag_H | (set ? 0 : Flag_Z | Flag_PV) | (y == 7 && set ? Flag_S : 0);
+					return true;
+				}
+				case 2: result = value & ~(1 << y); break;
+				case 3: result = value | (1 << y); break;
+			}
+
+			if (memory)
+			{
+				Write(address, result);
+				cycles++;
+			}
+			else
+				SetRegister(z, result, hl);
+			return true;
+		}
+
+		bool Cpu::StepExtended()
+		{
+			uint8_t opcode = Fetch();
+			uint8_t x = opcode >> 6;
+			uint8_t y = (opcode >> 3) & 7;
+			uint8_t z = opcode & 7;
+			uint8_t p = y >> 1;
+			uint8_t q = y & 1;
+
+			if (x == 2)
+				return StepBlock(opcode);
+
+			switch (opcode)
+			{
+				case 0x31: iy = ReadWord(hl); return true; // ld iy, (hl)
+				case 0x3E: WriteWord(hl, iy); return true; // ld (hl), iy
+				case 0x44: a = Sub8(0, a, 0); return true; // neg
+				case 0x45: pc = Pop(); iff1 = iff2; cycles += 2; return true; // retn
+				case 0x4D: pc = Pop(); cycles += 2; return true; // reti
+				case 0x46: case 0x56: case 0x5E: return true; // im
+				case 0x47: i = (i & 0xFF00) | a; return true; // ld i, a
+				case 0x4F: r = a; return true; // ld r, a
+				case 0x57: a = Low(i); f = (f & Flag_C) | (s_SZP[a] & (Flag_S | Flag_Z)) | (iff2 ? Flag_PV : 0); return true; // ld a, i
+				case 0x5F: a = r; f = (f & Flag_C) | (s_SZP[a] & (Flag_S | Flag_Z)) | (iff2 ? Flag_PV : 0); return true; // ld a, r
+				case 0x54: ix = Mask(iy + FetchDisplacement()); return true; // lea ix, iy + d
+				case 0x55: iy = Mask(ix + FetchDisplacement()); return true; // lea iy, ix + d
+				case 0x64: f = s_SZP[a & Fetch()] | Flag_H; return true; // tst a, n
+				case 0x65: Push(Mask(ix + FetchDisplacement())); return true; // pea ix + d
+				case 0x66: Push(Mask(iy + FetchDisplacement())); return true; // pea iy + d
+				case 0x67: // rrd
+				case 0x6F: // rld
+				{
+					uint8_t value = Read(hl);
+					if (opcode == 0x67)
+					{
+						Write(hl, static_cast<uint8_t>((a << 4) | (value >> 4)));
+						a = (a & 0xF0) | (value & 0x0F);
+					}
+					else
+					{
+						Write(hl, static_cast<uint8_t>((value << 4) | (a & 0x0F)));
+						a = (a & 0xF0) | (value >> 4);
+					}
+					f = (f & Flag_C) | s_SZP[a];
+					cycles++;
+					return true;
+				}
+				case 0x6D: mbase = a; return true; // ld mb, a
+				case 0x6E: a = mbase; return true; // ld a, mb
+				case 0x76: cycles++; halted = true; return true; // slp
+				case 0x7D: case 0x7E: return true; // stmix, rsmix
+				case 0xC7: i = static_cast<uint16_t>(hl); return true; // ld i, hl
+				case 0xD7: hl = i; return true; // ld hl, i
+			}
+
+			if (x == 0)
+			{
+				switch (z)
+				{
+					case 0: // in0 r, (n), ports are stubbed.
+					case 1: // out0 (n), r
+					{
+						if (y == 6)
+							return false;
+						Fetch();
+						cycles++;
+						if (z == 0)
+						{
+							SetRegister(y, 0, hl);
+							f = (f & Flag_C) | s_SZP[0];
+						}
+						return true;
+					}
+					case 2: // lea rr, ix + d
+					case 3: // lea rr, iy + d
+					{
+						if (q != 0)
+							return false;
+						uint32_t base = z == 2 ? ix : iy;
+						uint32_t value = Mask(base + FetchDisplacement());
+						if (p == 3)
+							(z == 2 ? ix : iy) = value;
+						else
+							Pair(p, hl) = value;
+						return true;
+					}
+					case 4: // tst a, r
+					{
+						f = s_SZP[a & (y == 6 ? Read(hl) : GetRegister(y, hl))] | Flag_H;
+						return true;
+					}
+					case 7:
+					{
+						uint32_t& pair = p == 3 ? ix : Pair(p, hl);
+						if (q == 0) // ld rr, (hl)
+							pair = ReadWord(hl);
+						else // ld (hl), rr
+							WriteWord(hl, pair);
+						return true;
+					}
+				}
+				return false;
+			}
+
+			if (x == 1)
+			{
+				switch (z)
+				{
+					case 0: // in r, (c)
+					case 1: // out (c), r
+					{
+						if (y == 6)
+							return false;
+						cycles++;
+						if (z == 0)
+						{
+							SetRegister(y, 0, hl);
+							f = (f & Flag_C) | s_SZP[0];
+						}
+						return true;
+					}
+					case 2:
+					{
+						hl = q == 0 ? SbcWide(hl, Pair(p, hl)) : AdcWide(hl, Pair(p, hl));
+						return true;
+					}
+					case 3:
+					{
+						uint32_t address = FetchWord();
+						if (q == 0)
+							WriteWord(address, Pair(p, hl));
+						else
+							Pair(p, hl) = ReadWord(address);
+						return true;
+					}
+					case 4: // mlt rr
+					{
+						if (q != 1)
+							return false;
+						uint32_t& pair = Pair(p, hl);
+						pair = (pair & ~0xFFFFu) | (High(pair) * Low(pair));
+						cycles += 4;
+						return true;
+					}
+				}
+			}
+
+			return false;
+		}
+
+		bool Cpu::StepBlock(uint8_t opcode)
+		{
+			bool decrement = opcode & 0x08;
+			bool repeat = opcode & 0x10;
+
+			switch (opcode & ~0x18)
+			{
+				case 0xA0: // ldi, ldd, ldir, lddr
+				{
+					do
+					{
+						Write(de, Read(hl));
+						cycles++;
+						hl = Mask(decrement ? hl - 1 : hl + 1);
+						de = Mask(decrement ? de - 1 : de + 1);
+						bc = Mask(bc - 1);
+					}
+					while (repeat && bc != 0);
+					f = (f & (Flag_S | Flag_Z | Flag_C)) | (bc ? Flag_PV : 0);
+					return true;
+				}
+				case 0xA1: // cpi, cpd, cpir, cpdr
+				{
+					uint8_t carry = f & Flag_C;
+					bool equal;
+					do
+					{
+						Sub8(a, Read(hl), 0);
+						equal = f & Flag_Z;
+						hl = Mask(decrement ? hl - 1 : hl + 1);
+						bc = Mask(bc - 1);
+					}
+					while (repeat && bc != 0 && !equal);
+					f = (f & ~(Flag_PV | Flag_C)) | (bc ? Flag_PV : 0) | carry;
+					return true;
+				}
+			}
+
+			return false;
+		}
+	}
+
+	void Simulate(const std::vector<uint8_t>& image, const SimulatorInfo& info, SimulatorProfile& profile)
+	{
+		PROFILE_FUNCTION();
+
+		Cpu cpu(info);
+		uint32_t origin = cpu.Address(info.origin);
+		size_t loadSize = std::min<size_t>(image.size(), s_AddressSpaceSize - origin);
+		std::copy_n(image.begin(), loadSize, cpu.memory.begin() + origin);
+
+		profile = {};
+		profile.addressCycles.resize(image.size());
+		profile.addressHits.resize(image.size());
+
+		while (true)
+		{
+			uint32_t address = cpu.Address(cpu.pc);
+
+			if (address < s_RAMStart)
+			{
+				if (address == s_ExitAddress)
+				{
+					profile.stop = SimulatorStop_Returned;
+					break;
+				}
+
+				// Anything outside of RAM is the OS, so return straight to the caller.
+				profile.osCalls[address]++;
+				cpu.cycles += info.osCallCycles;
+				cpu.pc = cpu.Pop();
+				continue;
+			}
+
+			if (cpu.cycles >= info.maxCycles)
+			{
+				profile.stop = SimulatorStop_CycleLimit;
+				break;
+			}
+
+			uint64_t startCycles = cpu.cycles;
+			if (!cpu.Step())
+			{
+				cpu.pc = address;
+				profile.stop = SimulatorStop_UnsupportedInstruction;
+				break;
+			}
+			profile.instructions++;
+
+			uint64_t instructionCycles = cpu.cycles - startCycles;
+			if (size_t offset = address - origin; address >= origin && offset < image.size())
+			{
+				profile.addressCycles[offset] += instructionCycles;
+				profile.addressHits[offset]++;
+			}
+			else
+				profile.outsideImageCycles += instructionCycles;
+
+			if (cpu.halted)
+			{
+				profile.stop = SimulatorStop_Halted;
+				break;
+			}
+		}
+
+		profile.stopAddress = cpu.Address(cpu.pc);
+		profile.cycles = cpu.cycles;
+	}
+
+	bool ReadProgramImage(const std::filesystem::path& filepath, std::vector<uint8_t>& image)
+	{
+		PROFILE_FUNCTION();
+
+		// See WriteFile for the layout, the program's size immediately precedes its data.
+		constexpr size_t sizeOffset = (8 + 3 + 42 + 2) + (2 + 2 + 1 + 8 + 1 + 1 + 2);
+
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (contents.size() < sizeOffset + 2 || std::string_view(contents.data(), 8) != "**TI83F*")
+			return false;
+
+		size_t size = static_cast<uint8_t>(contents[sizeOffset]) | (static_cast<uint8_t>(contents[sizeOffset + 1]) << 8);
+		if (contents.size() < sizeOffset + 2 + size)
+			return false;
+
+		image.assign(contents.begin() + sizeOffset + 2, contents.begin() + sizeOffset + 2 + size);
+		return true;
+	}
+
+	bool WriteSimulatorProfile(const std::filesystem::path& filepath, const SimulatorProfile& profile, const SimulatorInfo& info, const Layout& layout)
+	{
+		PROFILE_FUNCTION();
+
+		std::ofstream file(filepath);
+		if (!file.is_open())
+			return false;
+
+		static constexpr const char* stopNames[] = { "returned", "halted", "cycleLimit", "unsupportedInstruction" };
+
+		file << "{\n";
+		file << "\t\"stop\": \"" << stopNames[profile.stop] << "\",\n";
+		file << "\t\"stopAddress\": " << profile.stopAddress << ",\n";
+		file << "\t\"cycles\": " << profile.cycles << ",\n";
+		file << "\t\"instructionCount\": " << profile.instructions << ",\n";
+		file << "\t\"outsideImageCycles\": " << profile.outsideImageCycles << ",\n";
+
+		// Per instruction, mapped back to the line that emitted it.
+		file << "\t\"instructions\": [";
+		bool first = true;
+		size_t lineIndex = 0;
+		for (size_t offset = 0; offset < profile.addressHits.size(); offset++)
+		{
+			if (!profile.addressHits[offset])
+				continue;
+
+			while (lineIndex + 1 < layout.lines.size() && layout.lines[lineIndex + 1].offset <= offset)
+				lineIndex++;
+			bool mapped = lineIndex < layout.lines.size() && layout.lines[lineIndex].offset <= offset &&
+				offset < layout.lines[lineIndex].offset + layout.lines[lineIndex].size;
+
+			file << (first ? "\n" : ",\n");
+			first = false;
+			file << "\t\t{ \"address\": " << info.origin + offset << ", \"line\": " << (mapped ? layout.lines[lineIndex].lineNumber + 1 : 0)
+				<< ", \"hits\": " << profile.addressHits[offset] << ", \"cycles\": " << profile.addressCycles[offset] << " }";
+		}
+		file << (first ? "],\n" : "\n\t],\n");
+
+		// Per label, everything from the label up to the next one.
+		file << "\t\"labels\": [";
+		for (size_t i = 0; i < layout.labels.size(); i++)
+		{
+			const auto& label = layout.labels[i];
+			size_t end = i + 1 < layout.labels.size() ? layout.labels[i + 1].offset : profile.addressCycles.size();
+			end = std::min(end, profile.addressCycles.size());
+
+			uint64_t cycles = 0;
+			uint64_t hits = 0;
+			for (size_t offset = label.offset; offset < end; offset++)
+			{
+				cycles += profile.addressCycles[offset];
+				hits += profile.addressHits[offset];
+			}
+
+			file << (i ? ",\n" : "\n");
+			file << "\t\t{ \"name\": \"" << label.name << "\", \"line\": " << label.lineNumber + 1
+				<< ", \"instructions\": " << hits << ", \"cycles\": " << cycles << " }";
+		}
+		file << (layout.labels.empty() ? "],\n" : "\n\t],\n");
+
+		file << "\t\"osCalls\": [";
+		first = true;
+		for (const auto& [address, calls] : profile.osCalls)
+		{
+			file << (first ? "\n" : ",\n");
+			first = false;
+			file << "\t\t{ \"address\": " << address << ", \"calls\": " << calls << " }";
+		}
+		file << (first ? "]\n" : "\n\t]\n");
+		file << "}\n";
+
+		return file.good();
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Layout.h"
+#include <filesystem>
+#include <unordered_map>
+
+namespace ez80
+{
+	enum SimulatorStop_ : uint8_t
+	{
+		SimulatorStop_Returned = 0, // The program returned to the OS.
+		SimulatorStop_Halted,
+		SimulatorStop_CycleLimit,
+		SimulatorStop_UnsupportedInstruction,
+	};
+	using SimulatorStop = std::underlying_type_t<SimulatorStop_>;
+
+	struct SimulatorInfo
+	{
+		uint32_t origin = ProgramOrigin; // Where the image is loaded.
+		uint32_t entryPoint = UserMem;
+		bool adl = true;
+		uint64_t maxCycles = 1'000'000'000;
+
+		// Calls and jumps below RAM are treated as OS entry points that return immediately, costing this many cycles.
+		uint32_t osCallCycles = 0;
+	};
+
+	struct SimulatorProfile
+	{
+		SimulatorStop stop = SimulatorStop_Returned;
+		uint32_t stopAddress = 0;
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+
+		// Indexed by address - origin, one for every byte of the image. Only instruction starts are non-zero.
+		std::vector<uint64_t> addressCycles;
+		std::vector<uint64_t> addressHits;
+
+		uint64_t outsideImageCycles = 0; // Spent running code that isn't part of the image, i.e. copied or generated code.
+		std::unordered_map<uint32_t, uint64_t> osCalls; // Calls made to each stubbed OS entry point.
+	};
+
+	// Runs the image in an eZ80 core with a flat 24-bit memory map, counting cycles per instruction.
+	// Cycles are counted the same way as InstructionCost, one per byte fetched, read or written, plus fixed overheads.
+	void Simulate(const std::vector<uint8_t>& image, const SimulatorInfo& info, SimulatorProfile& profile);
+
+	// Reads the program data out of an existing .8xp file.
+	bool ReadProgramImage(const std::filesystem::path& filepath, std::vector<uint8_t>& image);
+
+	// Writes the per-instruction profile, mapped back to source lines, and the per-label totals as json.
+	bool WriteSimulatorProfile(const std::filesystem::path& filepath, const SimulatorProfile& profile, const SimulatorInfo& info, const Layout& layout);
+}
@@ -0,0 +1,80 @@
+#include "SourceScope.h"
+#include <algorithm>
+
+namespace ez80
+{
+	SourceScopeEvent SourceScope::Visit(const TokenizedLine& tokenizedLine)
+	{
+		std::string_view token0 = tokenizedLine[0];
+
+		if (token0.starts_with('#'))
+		{
+			std::string_view directive = token0.substr(1);
+			if (directive == "macro")
+			{
+				macroDepth++;
+				return SourceScopeEvent_Preprocessor;
+			}
+			if (directive == "endmacro" && macroDepth > 0)
+			{
+				macroDepth--;
+				return SourceScopeEvent_Preprocessor;
+			}
+			if (macroDepth > 0)
+				return SourceScopeEvent_MacroBody;
+			if (directive == "namespace" && tokenizedLine.tokenCount > 1)
+			{
+				namespacePrefix += tokenizedLine[1];
+				namespacePrefix += '.';
+				return SourceScopeEvent_NamespaceBegin;
+			}
+			if (directive == "endnamespace" && !namespacePrefix.empty())
+			{
+				size_t previousDot = namespacePrefix.find_last_of('.', namespacePrefix.size() - 2);
+				namespacePrefix.resize(previousDot == std::string::npos ? 0 : previousDot + 1);
+				return SourceScopeEvent_NamespaceEnd;
+			}
+			return SourceScopeEvent_Preprocessor;
+		}
+
+		if (macroDepth > 0)
+			return SourceScopeEvent_MacroBody;
+		if (!GetLabelName(tokenizedLine).empty())
+			return SourceScopeEvent_Label;
+		return SourceScopeEvent_None;
+	}
+
+	std::string SourceScope::Qualify(std::string_view identifier) const
+	{
+		std::string qualified = namespacePrefix;
+		qualified += identifier;
+		return qualified;
+	}
+
+	std::string_view SourceScope::Qualify(std::string_view identifier, std::string& buffer) const
+	{
+		if (namespacePrefix.empty())
+			return identifier;
+		buffer.assign(namespacePrefix);
+		buffer += identifier;
+		return buffer;
+	}
+
+	std::string_view SourceScope::Qualify(std::string_view identifier, std::pmr::memory_resource* resource) const
+	{
+		if (namespacePrefix.empty())
+			return identifier;
+		char* qualified = static_cast<char*>(resource->allocate(namespacePrefix.size() + identifier.size(), alignof(char)));
+		std::copy(namespacePrefix.begin(), namespacePrefix.end(), qualified);
+		std::copy(identifier.begin(), identifier.end(), qualified + namespacePrefix.size());
+		return { qualified, namespacePrefix.size() + identifier.size() };
+	}
+
+	std::string_view SourceScope::CurrentNamespace() const noexcept
+	{
+		std::string_view current = namespacePrefix;
+		if (!current.empty())
+			current.remove_suffix(1);
+		return current;
+	}
+}
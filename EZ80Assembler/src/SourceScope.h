@@ -0,0 +1,47 @@
+#pragma once
+
+#include "AssemblerTypes.h"
+#include <memory_resource>
+#include <string>
+
+namespace ez80
+{
+	enum SourceScopeEvent_ : uint8_t
+	{
+		SourceScopeEvent_None = 0,       // An instruction, directive or macro invocation.
+		SourceScopeEvent_Preprocessor,   // Any # line not listed below.
+		SourceScopeEvent_NamespaceBegin,
+		SourceScopeEvent_NamespaceEnd,
+		SourceScopeEvent_Label,
+		SourceScopeEvent_MacroBody,      // Any line between #macro and #endmacro.
+	};
+	using SourceScopeEvent = std::underlying_type_t<SourceScopeEvent_>;
+
+	// Tracks the enclosing namespaces and macro definitions while walking tokenized lines in order.
+	class SourceScope
+	{
+	public:
+		SourceScopeEvent Visit(const TokenizedLine& tokenizedLine);
+
+		// Prepends the enclosing namespaces, e.g. String -> name_space.String
+		std::string Qualify(std::string_view identifier) const;
+		// These don't copy at all outside of any namespace. The first may point into buffer, reusing its capacity for lookups,
+		// while the second allocates from resource so the name lives as long as the resource does.
+		std::string_view Qualify(std::string_view identifier, std::string& buffer) const;
+		std::string_view Qualify(std::string_view identifier, std::pmr::memory_resource* resource) const;
+		std::string_view CurrentNamespace() const noexcept;
+		constexpr bool InMacro() const noexcept { return macroDepth > 0; }
+	private:
+		std::string namespacePrefix; // Every enclosing namespace, each followed by a dot.
+		size_t macroDepth = 0;
+	};
+
+	// Returns the label's name without the colon, or an empty string_view if the line isn't a label.
+	constexpr std::string_view GetLabelName(const TokenizedLine& tokenizedLine) noexcept
+	{
+		std::string_view token0 = tokenizedLine[0];
+		if (tokenizedLine.tokenCount == 1 && token0.size() > 1 && token0.back() == ':')
+			return token0.substr(0, token0.size() - 1);
+		return {};
+	}
+}
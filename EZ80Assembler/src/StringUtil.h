@@ -70,6 +70,14 @@ namespace util::string
 	constexpr Elem ToLower(Elem elem) noexcept;
 	template<typename Elem = char>
 	constexpr Elem ToUpper(Elem elem) noexcept;
+
+	// Compares two strings, ignoring the case of ascii letters.
+	template<typename Elem = char, typename Traits = std::char_traits<Elem>>
+	constexpr bool EqualsIgnoreCase(std::basic_string_view<Elem, Traits> left, std::basic_string_view<Elem, Traits> right) noexcept;
+
+	// Removes blanks, see IsBlank, from both ends.
+	template<typename Elem = char, typename Traits = std::char_traits<Elem>>
+	constexpr std::basic_string_view<Elem, Traits> TrimBlanks(std::basic_string_view<Elem, Traits> stringView) noexcept;
 }
 
 #include "StringUtil.inl"
@@ -168,7 +168,8 @@ namespace util::string
 		requires(std::is_convertible_v<Predicate, bool(*)(Elem)>)
 	void FindFirstOf(std::basic_string_view<Elem, Traits> stringView, typename std::basic_string_view<Elem, Traits>::size_type& index, Elem& elem, Predicate predicate) noexcept(noexcept(predicate(static_cast<Elem>(elem))))
 	{
-		static Predicate s_Predicate;
+		// Thread local, so that files can be tokenized on several threads at once.
+		thread_local Predicate s_Predicate;
 		s_Predicate = predicate;
 		FindFirstNotOf(stringView, index, elem, [](Elem elem2) noexcept(noexcept(predicate(static_cast<Elem>(elem)))) { return !s_Predicate(elem2); });
 	}
@@ -177,7 +178,7 @@ namespace util::string
 		requires(std::is_convertible_v<Predicate, bool(*)(Elem)>)
 	bool FindFirstNotOfPastQuote(std::basic_string_view<Elem, Traits> stringView, typename std::basic_string_view<Elem, Traits>::size_type& index, Elem& elem, Predicate predicate) noexcept(noexcept(predicate(static_cast<Elem>(elem))))
 	{
-		static Predicate s_Predicate;
+		thread_local Predicate s_Predicate;
 		s_Predicate = predicate;
 		return FindFirstOfPastQuote(stringView, index, elem, [](Elem elem2) noexcept(noexcept(predicate(static_cast<Elem>(elem)))) { return !s_Predicate(elem2); });
 	}
@@ -186,41 +187,29 @@ namespace util::string
 		requires(std::is_convertible_v<Predicate, bool(*)(Elem)>)
 	bool FindFirstOfPastQuote(std::basic_string_view<Elem, Traits> stringView, typename std::basic_string_view<Elem, Traits>::size_type& index, Elem& elem, Predicate predicate) noexcept(noexcept(predicate(static_cast<Elem>(elem))))
 	{
-		if (!stringView.empty())
+		// Only what's scanned past is looked at, so that walking a line one operand at a time stays linear in its length.
+		bool quoted = false;
+		bool escaped = false;
+		for (; index < stringView.size(); index++)
 		{
-			if (size_t i = stringView.find('"'); i == std::basic_string_view<Elem, Traits>::npos)
+			Elem c = stringView[index];
+			if (quoted)
 			{
-				FindFirstOf(stringView, index, elem, predicate);
-				return true;
+				if (c == static_cast<Elem>('"') && !escaped)
+					quoted = false;
+				else
+					escaped = c == static_cast<Elem>('\\') && !escaped;
 			}
-			else
+			else if (c == static_cast<Elem>('"'))
+				quoted = true;
+			else if (predicate(c))
 			{
-				char c;
-				bool quoted = false;
-				bool escaped = false;
-				while (index < stringView.size())
-				{
-					c = stringView[index];
-					if (quoted)
-					{
-						if (c == '"' && !escaped)
-							quoted = false;
-						else
-							escaped = c == '\\' && !escaped;
-					}
-					else if (c == '"')
-						quoted = true;
-					else if (predicate(c))
-						return true;
-					index++;
-				}
-				if (quoted || escaped)
-					return false;
+				elem = c;
+				return true;
 			}
 		}
 
-		index = stringView.size();
-		return true;
+		return !quoted;
 	}
 
 	template<typename Elem>
@@ -303,4 +292,25 @@ namespace util::string
 	{
 		return IsLower(elem) ? elem - static_cast<Elem>('a' - 'A') : elem;
 	}
+
+	template<typename Elem, typename Traits>
+	constexpr bool EqualsIgnoreCase(std::basic_string_view<Elem, Traits> left, std::basic_string_view<Elem, Traits> right) noexcept
+	{
+		if (left.size() != right.size())
+			return false;
+		for (size_t i = 0; i < left.size(); i++)
+			if (ToLower(left[i]) != ToLower(right[i]))
+				return false;
+		return true;
+	}
+
+	template<typename Elem, typename Traits>
+	constexpr std::basic_string_view<Elem, Traits> TrimBlanks(std::basic_string_view<Elem, Traits> stringView) noexcept
+	{
+		while (!stringView.empty() && IsBlank(stringView.front()))
+			stringView.remove_prefix(1);
+		while (!stringView.empty() && IsBlank(stringView.back()))
+			stringView.remove_suffix(1);
+		return stringView;
+	}
 }
@@ -0,0 +1,64 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace ez80
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+		threads.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+			threads.emplace_back(&ThreadPool::Work, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::scoped_lock lock(mutex);
+			stopping = true;
+		}
+		taskAvailable.notify_all();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	void ThreadPool::Submit(std::function<void()> task)
+	{
+		{
+			std::scoped_lock lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		taskAvailable.notify_one();
+	}
+
+	void ThreadPool::Wait()
+	{
+		std::unique_lock lock(mutex);
+		idle.wait(lock, [this] { return tasks.empty() && runningCount == 0; });
+	}
+
+	void ThreadPool::Work()
+	{
+		std::unique_lock lock(mutex);
+		while (true)
+		{
+			// Whatever is queued still runs when stopping, so that nothing submitted is silently dropped.
+			taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+				return;
+
+			std::function<void()> task = std::move(tasks.front());
+			tasks.pop_front();
+			runningCount++;
+
+			lock.unlock();
+			task();
+			lock.lock();
+
+			if (--runningCount == 0 && tasks.empty())
+				idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ez80
+{
+	// A fixed set of worker threads running submitted tasks in the order they were submitted.
+	// Tasks may submit more tasks, and Wait returns once every task, including those, has finished.
+	class ThreadPool
+	{
+	public:
+		// 0 means one per hardware thread.
+		ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void Submit(std::function<void()> task);
+		void Wait();
+
+		uint32_t ThreadCount() const noexcept { return static_cast<uint32_t>(threads.size()); }
+	private:
+		void Work();
+
+		std::mutex mutex; // Guards everything below but threads.
+		std::condition_variable taskAvailable;
+		std::condition_variable idle;
+		std::deque<std::function<void()>> tasks;
+		size_t runningCount = 0;
+		bool stopping = false;
+		std::vector<std::thread> threads;
+	};
+}
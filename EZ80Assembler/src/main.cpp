@@ -1,15 +1,20 @@
 #include "EZ80Assembler.h"
 #include "Debug.h"
+#include "Profile.h"
 
 int main(int argc, char** argv)
 {
 	ez80::AssemblerInfo info;
 	info.inputFilepath = L"C:\\Workspace\\Programming\\Dev\\C++\\EZ80Assembler\\EZ80Assembler\\test\\test.asm";
 	info.outputFilepath = L"C:\\Workspace\\Programming\\Dev\\C++\\EZ80Assembler\\EZ80Assembler\\test\\TEST.8xp";
-	if (auto result = ez80::Assemble(info))
+	PROFILE_BEGIN_SESSION("EZ80Assembler-Trace.json");
+	auto result = ez80::Assemble(info);
+	PROFILE_END_SESSION();
+
+	if (result)
 	{
 		stdcout(result.error << '\n');
-		__debugbreak();
+		DEBUG_BREAK();
 	}
 
 	return 0;
@@ -0,0 +1,67 @@
+project "EZ80AssemblerBench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++20"
+	cdialect "C17"
+	staticruntime "On"
+
+	targetdir ("%{wks.location}/bin/" .. OutputDir .. "/%{prj.name}")
+	objdir ("%{wks.location}/bin-int/" .. OutputDir .. "/%{prj.name}")
+
+	files {
+		"src/**.h",
+		"src/**.cpp",
+		"src/**.inl",
+
+		-- Everything the assembler is made of, except its entry point.
+		"%{wks.location}/EZ80Assembler/src/**.h",
+		"%{wks.location}/EZ80Assembler/src/**.cpp",
+		"%{wks.location}/EZ80Assembler/src/**.inl"
+	}
+
+	removefiles {
+		"%{wks.location}/EZ80Assembler/src/main.cpp"
+	}
+
+	includedirs {
+		"src",
+		"%{wks.location}/EZ80Assembler/src"
+	}
+
+	-- Replaces the global operator new and delete, so that every phase's allocations are reported.
+	defines "EZ80_COUNT_ALLOCATIONS"
+
+	filter "system:windows"
+		systemversion "latest"
+		usestdpreproc "On"
+		buildoptions "/wd5105"
+		defines "SYSTEM_WINDOWS"
+
+	-- BuildProject assembles on a thread pool.
+	filter "system:linux"
+		links "pthread"
+
+	-- Unlike the assembler's, Profile is optimized, since timings of unoptimized code mean little.
+	filter "configurations:Profile"
+		runtime "Release"
+		optimize "On"
+		symbols "On"
+		defines "CONFIG_PROFILE"
+
+	filter "configurations:Debug"
+		runtime "Debug"
+		optimize "Debug"
+		symbols "Full"
+		defines "CONFIG_DEBUG"
+
+	filter "configurations:Release"
+		runtime "Release"
+		optimize "On"
+		symbols "On"
+		defines "CONFIG_RELEASE"
+
+	filter "configurations:Dist"
+		runtime "Release"
+		optimize "Full"
+		symbols "Off"
+		defines "CONFIG_DIST"
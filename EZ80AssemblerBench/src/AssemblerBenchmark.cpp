@@ -0,0 +1,244 @@
+#include "AssemblerBenchmark.h"
+#include "AssemblerArena.h"
+#include "CorpusGenerator.h"
+#include "EZ80Assembler.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace ez80::bench
+{
+	// Phases faster than this in the baseline are too noisy to call regressions on.
+	static constexpr double s_MinComparableSeconds = 0.001;
+
+	// Throughput isn't meaningful for phases that barely ran.
+	static constexpr double s_MinThroughputSeconds = 0.000001;
+
+	struct PhaseSamples
+	{
+		std::string name;
+		std::vector<double> seconds; // One per repetition.
+		PhaseStats last; // Allocations don't change between runs, so the last run's are reported.
+
+		double Mean() const
+		{
+			double sum = 0.0;
+			for (double sample : seconds)
+				sum += sample;
+			return sum / static_cast<double>(seconds.size());
+		}
+
+		double StandardDeviation() const
+		{
+			if (seconds.size() < 2)
+				return 0.0;
+			double mean = Mean();
+			double sum = 0.0;
+			for (double sample : seconds)
+				sum += (sample - mean) * (sample - mean);
+			return std::sqrt(sum / static_cast<double>(seconds.size() - 1));
+		}
+
+		double Min() const { return *std::min_element(seconds.begin(), seconds.end()); }
+	};
+
+	struct CorpusResult
+	{
+		size_t lineCount = 0;
+		std::vector<PhaseSamples> phases; // The whole of Assemble last.
+	};
+
+	// Baseline results are keyed by corpus line count and phase name, and only the fastest run is compared.
+	using Baseline = std::map<std::pair<size_t, std::string>, double>;
+
+	// Only reads files written by WriteResults, so it looks for keys rather than parsing json in general.
+	static bool ReadBaseline(const std::filesystem::path& filepath, Baseline& baseline)
+	{
+		std::ifstream file(filepath);
+		if (!file.is_open())
+			return false;
+		std::stringstream stream;
+		stream << file.rdbuf();
+		std::string contents = stream.str();
+
+		auto NumberAfter = [&contents](size_t position) { return std::strtod(contents.c_str() + position, nullptr); };
+
+		size_t lineCount = 0;
+		std::string name;
+		for (size_t position = 0; (position = contents.find('"', position)) != std::string::npos; )
+		{
+			size_t keyEnd = contents.find('"', position + 1);
+			if (keyEnd == std::string::npos)
+				break;
+			std::string_view key = std::string_view(contents).substr(position + 1, keyEnd - position - 1);
+			size_t valueStart = contents.find_first_not_of(": \t", keyEnd + 1);
+			if (valueStart == std::string::npos)
+				break;
+
+			if (key == "lines")
+				lineCount = static_cast<size_t>(NumberAfter(valueStart));
+			else if (key == "name" && contents[valueStart] == '"')
+			{
+				size_t nameEnd = contents.find('"', valueStart + 1);
+				name = contents.substr(valueStart + 1, nameEnd - valueStart - 1);
+				keyEnd = nameEnd;
+			}
+			else if (key == "minSeconds")
+				baseline[{ lineCount, name }] = NumberAfter(valueStart);
+			position = keyEnd + 1;
+		}
+		return true;
+	}
+
+	static bool WriteResults(const std::filesystem::path& filepath, const std::vector<CorpusResult>& results, uint32_t repetitions)
+	{
+		std::ofstream file(filepath);
+		if (!file.is_open())
+			return false;
+
+		file << std::setprecision(9);
+		file << "{\n\t\"repetitions\": " << repetitions << ",\n\t\"benchmarks\": [";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const CorpusResult& result = results[i];
+			file << (i ? ",\n" : "\n");
+			file << "\t\t{\n\t\t\t\"lines\": " << result.lineCount << ",\n\t\t\t\"phases\": [";
+			for (size_t j = 0; j < result.phases.size(); j++)
+			{
+				const PhaseSamples& phase = result.phases[j];
+				file << (j ? ",\n" : "\n");
+				file << "\t\t\t\t{ \"name\": \"" << phase.name
+					<< "\", \"meanSeconds\": " << phase.Mean()
+					<< ", \"stddevSeconds\": " << phase.StandardDeviation()
+					<< ", \"minSeconds\": " << phase.Min()
+					<< ", \"linesPerSecond\": " << (phase.Mean() >= s_MinThroughputSeconds ? static_cast<double>(result.lineCount) / phase.Mean() : 0.0)
+					<< ", \"allocationCount\": " << phase.last.allocationCount
+					<< ", \"allocatedBytes\": " << phase.last.allocatedBytes
+					<< ", \"peakBytes\": " << phase.last.peakBytes << " }";
+			}
+			file << "\n\t\t\t]\n\t\t}";
+		}
+		file << "\n\t]\n}\n";
+		return file.good();
+	}
+
+	int RunAssemblerBenchmark(const AssemblerBenchmarkInfo& info)
+	{
+		Baseline baseline;
+		if (!info.baselineFilepath.empty() && !ReadBaseline(info.baselineFilepath, baseline))
+		{
+			std::cerr << "Couldn't read the baseline " << info.baselineFilepath << '\n';
+			return -1;
+		}
+
+		int regressionCount = 0;
+		std::vector<CorpusResult> results;
+		for (size_t lineCount : info.lineCounts)
+		{
+			CorpusInfo corpusInfo;
+			corpusInfo.lineCount = lineCount;
+			std::filesystem::path corpusDirectory = info.corpusDirectory / std::to_string(lineCount);
+			AssemblerInfo assemblerInfo;
+			assemblerInfo.inputFilepath = GenerateCorpus(corpusDirectory, corpusInfo);
+			if (assemblerInfo.inputFilepath.empty())
+			{
+				std::cerr << "Couldn't generate a corpus in " << corpusDirectory << '\n';
+				return -1;
+			}
+			assemblerInfo.outputFilepath = corpusDirectory / "BENCH.8xp";
+			assemblerInfo.eliminateDeadCode = true;
+			assemblerInfo.optimizePeephole = true;
+			assemblerInfo.listingFilepath = corpusDirectory / "BENCH.lst";
+			assemblerInfo.collectStats = true;
+
+			// Reused like a long running host would, so the warm up run grows it to fit and the timed runs allocate from it.
+			AssemblerArena arena;
+			assemblerInfo.memoryResource = arena.Resource();
+
+			CorpusResult& result = results.emplace_back();
+			result.lineCount = lineCount;
+			for (uint32_t repetition = 0; repetition <= info.repetitions; repetition++)
+			{
+				AssemblerResult assemblerResult = Assemble(assemblerInfo);
+				arena.Reset();
+
+				// Until encoding is implemented nothing is assembled, but everything before it has run by then.
+				if (assemblerResult && assemblerResult.error != AssemblerError_AssemblyEmpty)
+				{
+					std::cerr << "Assembling " << assemblerInfo.inputFilepath << " failed with error " << assemblerResult.error.id
+						<< " on line " << assemblerResult.error.lineNumber << '\n';
+					return -1;
+				}
+
+				// The first run warms up the file cache and the allocator, and isn't counted.
+				if (repetition == 0)
+					continue;
+
+				const AssemblerStats& stats = assemblerResult.stats;
+				for (size_t i = 0; i <= stats.phases.size(); i++)
+				{
+					const PhaseStats& phaseStats = i < stats.phases.size() ? stats.phases[i] : stats.total;
+					auto phase = std::find_if(result.phases.begin(), result.phases.end(), [&phaseStats](const PhaseSamples& phase) { return phase.name == phaseStats.name; });
+					if (phase == result.phases.end())
+					{
+						phase = result.phases.emplace(result.phases.end());
+						phase->name = phaseStats.name;
+					}
+					phase->seconds.push_back(static_cast<double>(phaseStats.nanoseconds) * 1e-9);
+					phase->last = phaseStats;
+				}
+			}
+
+			std::cout << lineCount << " lines, " << info.repetitions << " repetitions\n";
+			std::cout << std::left << std::setw(22) << "phase" << std::right
+				<< std::setw(12) << "mean ms" << std::setw(10) << "stddev" << std::setw(12) << "min ms"
+				<< std::setw(14) << "klines/s" << std::setw(12) << "allocs" << std::setw(12) << "peak KiB" << "  baseline\n";
+			std::cout << std::fixed;
+			for (const PhaseSamples& phase : result.phases)
+			{
+				double mean = phase.Mean();
+				std::cout << std::left << std::setw(22) << phase.name << std::right
+					<< std::setw(12) << std::setprecision(3) << mean * 1000.0
+					<< std::setw(9) << std::setprecision(1) << (mean > 0.0 ? phase.StandardDeviation() / mean * 100.0 : 0.0) << '%'
+					<< std::setw(12) << std::setprecision(3) << phase.Min() * 1000.0
+					<< std::setw(14);
+				if (mean >= s_MinThroughputSeconds)
+					std::cout << std::setprecision(1) << static_cast<double>(lineCount) / mean / 1000.0;
+				else
+					std::cout << '-';
+				std::cout
+					<< std::setw(12) << phase.last.allocationCount
+					<< std::setw(12) << phase.last.peakBytes / 1024;
+
+				auto baselineSeconds = baseline.find({ lineCount, phase.name });
+				if (baselineSeconds != baseline.end() && baselineSeconds->second >= s_MinComparableSeconds)
+				{
+					double change = phase.Min() / baselineSeconds->second - 1.0;
+					std::cout << "  " << std::showpos << std::setprecision(1) << change * 100.0 << '%' << std::noshowpos;
+					if (change > info.regressionThreshold)
+					{
+						std::cout << " REGRESSED";
+						regressionCount++;
+					}
+				}
+				std::cout << '\n';
+			}
+			std::cout << '\n';
+		}
+
+		if (!info.resultsFilepath.empty() && !WriteResults(info.resultsFilepath, results, info.repetitions))
+		{
+			std::cerr << "Couldn't write the results to " << info.resultsFilepath << '\n';
+			return -1;
+		}
+
+		if (!baseline.empty())
+			std::cout << regressionCount << " phases regressed by more than " << info.regressionThreshold * 100.0 << "%\n";
+		return regressionCount;
+	}
+}
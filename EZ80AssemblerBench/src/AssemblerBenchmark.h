@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+namespace ez80::bench
+{
+	struct AssemblerBenchmarkInfo
+	{
+		std::vector<size_t> lineCounts = { 1'000, 10'000, 100'000, 1'000'000 }; // One generated corpus for each.
+		uint32_t repetitions = 5; // Timed runs per corpus, after one untimed warm up run.
+		std::filesystem::path corpusDirectory = "BenchmarkCorpus";
+
+		// Optional, if not empty, the results are written here as json, in the format baselineFilepath is read in.
+		std::filesystem::path resultsFilepath;
+
+		// Optional, if not empty, every phase is compared with its result in this file.
+		// A phase regresses when its fastest run is slower than the baseline's fastest by more than regressionThreshold, as a fraction.
+		std::filesystem::path baselineFilepath;
+		double regressionThreshold = 0.10;
+	};
+
+	// Assembles generated corpora with every optional phase enabled and prints the time, throughput and memory use
+	// of each phase. Returns the number of phases that regressed, or -1 if the benchmark couldn't run.
+	int RunAssemblerBenchmark(const AssemblerBenchmarkInfo& info);
+}
@@ -0,0 +1,198 @@
+#include "CompressionBenchmark.h"
+#include "Compression.h"
+#include "Simulator.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace ez80::bench
+{
+	struct Sample
+	{
+		std::string name;
+		std::vector<uint8_t> data;
+	};
+
+	// Instruction encodings weighted roughly by how often they show up in CE programs,
+	// with call and jp targets drawn mostly from a few hot routines.
+	static std::vector<uint8_t> GenerateCode(size_t size, std::mt19937& rng)
+	{
+		std::vector<uint8_t> code;
+		std::vector<uint32_t> routines;
+		for (uint32_t i = 0; i < 64; i++)
+			routines.push_back(UserMem + static_cast<uint32_t>(rng() % size));
+		std::vector<uint32_t> osCalls = { 0x020148, 0x0207C0, 0x021AE8, 0x020814, 0x02050C, 0x020320 };
+
+		std::geometric_distribution<uint32_t> hot(0.15);
+		auto Word = [&code](uint32_t value) { code.insert(code.end(), { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value >> 16) }); };
+		auto Small = [&rng]() { return static_cast<uint8_t>(rng() % 4 ? rng() % 16 : rng()); };
+
+		while (code.size() < size)
+		{
+			switch (rng() % 16)
+			{
+				case 0: case 1: code.push_back(0xCD); Word(routines[std::min<uint32_t>(hot(rng), 63)]); break; // call routine
+				case 2: code.push_back(0xCD); Word(osCalls[rng() % osCalls.size()]); break;                    // call _OSRoutine
+				case 3: code.insert(code.end(), { 0x20, static_cast<uint8_t>(rng() % 32 - 16) }); break;       // jr nz, d
+				case 4: code.insert(code.end(), { 0x3E, Small() }); break;                                       // ld a, n
+				case 5: code.push_back(0x21); Word(0xD40000 + (rng() % 4) * 0x100); break;                       // ld hl, buffer
+				case 6: code.insert(code.end(), { 0xDD, 0x7E, static_cast<uint8_t>(rng() % 4 * 3) }); break;      // ld a, (ix + d)
+				case 7: code.insert(code.end(), { 0xDD, 0x27, static_cast<uint8_t>(rng() % 4 * 3) }); break;      // ld hl, (ix + d)
+				case 8: code.push_back(static_cast<uint8_t>(0x40 + rng() % 64)); break;                          // ld r, r'
+				case 9: code.push_back(static_cast<uint8_t>(0xC5 + (rng() % 3) * 0x10)); break;                  // push rr
+				case 10: code.push_back(static_cast<uint8_t>(0xC1 + (rng() % 3) * 0x10)); break;                 // pop rr
+				case 11: code.push_back(0xC9); break;                                                            // ret
+				case 12: code.insert(code.end(), { 0xFE, Small() }); break;                                      // cp a, n
+				case 13: code.push_back(static_cast<uint8_t>(0x80 + rng() % 64)); break;                         // alu a, r
+				case 14: code.push_back(0x01); Word(rng() % 320); break;                                         // ld bc, n
+				case 15: code.insert(code.end(), { 0xED, 0xB0 }); break;                                         // ldir
+			}
+		}
+		code.resize(size);
+		return code;
+	}
+
+	// 16x16 8bpp sprites with a handful of colors around a transparent background.
+	static std::vector<uint8_t> GenerateSprites(size_t count, std::mt19937& rng)
+	{
+		std::vector<uint8_t> sprites;
+		for (size_t i = 0; i < count; i++)
+		{
+			sprites.insert(sprites.end(), { 16, 16 });
+			uint8_t colors[4] = { static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()) };
+			for (int y = 0; y < 16; y++)
+			{
+				for (int x = 0; x < 16; x++)
+				{
+					int dx = x - 8;
+					int dy = y - 8;
+					bool inside = dx * dx + dy * dy < 40 + static_cast<int>(rng() % 12);
+					sprites.push_back(inside ? colors[(dx * dx + dy * dy) / 12 % 4] : 0);
+				}
+			}
+		}
+		return sprites;
+	}
+
+	// A 320x240 8bpp background with a gradient and light noise, like a converted photo with a reduced palette.
+	static std::vector<uint8_t> GenerateBackground(std::mt19937& rng)
+	{
+		std::vector<uint8_t> background;
+		background.reserve(320 * 240);
+		for (int y = 0; y < 240; y++)
+			for (int x = 0; x < 320; x++)
+				background.push_back(static_cast<uint8_t>(y / 8 * 8 + (rng() % 8 == 0 ? rng() % 3 : 0)));
+		return background;
+	}
+
+	// Uncompressed tiles as a tilemap of indices, with a few repeating patterns.
+	static std::vector<uint8_t> GenerateTilemap(std::mt19937& rng)
+	{
+		std::vector<uint8_t> tilemap;
+		for (int y = 0; y < 60; y++)
+			for (int x = 0; x < 80; x++)
+				tilemap.push_back(static_cast<uint8_t>(y > 50 ? 1 : (x + y) % 7 == 0 ? rng() % 4 + 2 : 0));
+		return tilemap;
+	}
+
+	static double Seconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+
+	// Runs function repeatedly for at least a quarter of a second and returns the fastest time.
+	template<typename Function>
+	static double Time(Function function)
+	{
+		double best = 1e30;
+		auto start = std::chrono::steady_clock::now();
+		do
+		{
+			auto runStart = std::chrono::steady_clock::now();
+			function();
+			best = std::min(best, Seconds(std::chrono::steady_clock::now() - runStart));
+		}
+		while (Seconds(std::chrono::steady_clock::now() - start) < 0.25);
+		return best;
+	}
+
+	void RunCompressionBenchmark(const std::vector<std::filesystem::path>& programFilepaths)
+	{
+		std::mt19937 rng(0xE780);
+		std::vector<Sample> samples;
+		samples.emplace_back("code", GenerateCode(48 * 1024, rng));
+		samples.emplace_back("sprites", GenerateSprites(96, rng));
+		samples.emplace_back("background", GenerateBackground(rng));
+		samples.emplace_back("tilemap", GenerateTilemap(rng));
+
+		// Code interleaved with its data, like most programs.
+		{
+			Sample& mixed = samples.emplace_back("mixed");
+			for (size_t i = 0; i < 4; i++)
+				mixed.data.insert(mixed.data.end(), samples[i].data.begin(), samples[i].data.end());
+		}
+
+		for (const auto& programFilepath : programFilepaths)
+		{
+			Sample sample;
+			sample.name = programFilepath.filename().string();
+			if (ReadProgramImage(programFilepath, sample.data) && sample.data.size() > 2)
+			{
+				sample.data.erase(sample.data.begin(), sample.data.begin() + 2);
+				samples.push_back(std::move(sample));
+			}
+			else
+				std::cerr << "Couldn't read " << programFilepath << '\n';
+		}
+
+		std::cout << std::left << std::setw(16) << "sample" << std::right
+			<< std::setw(10) << "size" << std::setw(12) << "compressed" << std::setw(8) << "ratio"
+			<< std::setw(14) << "pack MB/s" << std::setw(14) << "unpack MB/s"
+			<< std::setw(16) << "eZ80 cycles/B" << std::setw(14) << "eZ80 ms" << '\n';
+		std::cout << std::fixed;
+
+		for (const auto& sample : samples)
+		{
+			std::vector<uint8_t> compressed;
+			double packSeconds = Time([&]() { compressed.clear(); CompressLZ(sample.data, compressed); });
+
+			std::vector<uint8_t> unpacked;
+			double unpackSeconds = Time([&]() { unpacked.clear(); DecompressLZ(compressed, unpacked); });
+			if (unpacked != sample.data)
+			{
+				std::cerr << sample.name << " didn't survive a round trip\n";
+				continue;
+			}
+
+			// Time the stub on the eZ80, as a program that returns as soon as it's unpacked.
+			// The simulator stubs out OS calls, so it starts past the free RAM check.
+			std::vector<uint8_t> image;
+			image.reserve(3 + sample.data.size());
+			image.push_back(0xEF);
+			image.push_back(0x7B);
+			image.push_back(0xC9);
+			image.insert(image.end(), sample.data.begin(), sample.data.end());
+			uint64_t cycles = 0;
+			if (CompressProgramImage(image))
+			{
+				SimulatorInfo info;
+				info.entryPoint = UserMem + 12;
+				SimulatorProfile profile;
+				Simulate(image, info, profile);
+				cycles = profile.cycles;
+			}
+
+			constexpr double megabyte = 1024.0 * 1024.0;
+			constexpr double clockHz = 48'000'000.0;
+			std::cout << std::left << std::setw(16) << sample.name << std::right
+				<< std::setw(10) << sample.data.size() << std::setw(12) << compressed.size()
+				<< std::setw(8) << std::setprecision(3) << static_cast<double>(compressed.size()) / sample.data.size()
+				<< std::setw(14) << std::setprecision(1) << sample.data.size() / megabyte / packSeconds
+				<< std::setw(14) << std::setprecision(1) << sample.data.size() / megabyte / unpackSeconds
+				<< std::setw(16) << std::setprecision(2) << static_cast<double>(cycles) / sample.data.size()
+				<< std::setw(14) << std::setprecision(2) << cycles / clockHz * 1000.0 << '\n';
+		}
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+namespace ez80::bench
+{
+	// Prints the compression ratio, compression and decompression speed, and the cycles the eZ80 stub takes to unpack,
+	// for generated code and graphics data and for every given .8xp file.
+	void RunCompressionBenchmark(const std::vector<std::filesystem::path>& programFilepaths);
+}
@@ -0,0 +1,318 @@
+#include "CorpusGenerator.h"
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ez80::bench
+{
+	// Buffers lines and writes them out in large blocks, since corpora go up to millions of lines.
+	class CorpusFile
+	{
+	public:
+		explicit CorpusFile(const std::filesystem::path& filepath)
+			: file(filepath, std::ios::binary) {}
+
+		~CorpusFile() { Flush(); }
+
+		bool IsOpen() const { return file.is_open(); }
+		bool Good() { Flush(); return file.good(); }
+		size_t LineCount() const { return lineCount; }
+
+		void Line(std::string_view line)
+		{
+			buffer += line;
+			buffer += '\n';
+			lineCount++;
+			if (buffer.size() >= 1 << 20)
+				Flush();
+		}
+
+		template<typename... Parts>
+		void Line(const Parts&... parts)
+		{
+			(Append(parts), ...);
+			buffer += '\n';
+			lineCount++;
+			if (buffer.size() >= 1 << 20)
+				Flush();
+		}
+	private:
+		void Append(std::string_view part) { buffer += part; }
+		void Append(char part) { buffer += part; }
+		void Append(uint32_t part) { buffer += std::to_string(part); }
+		void Append(size_t part) { buffer += std::to_string(part); }
+
+		void Flush()
+		{
+			file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			buffer.clear();
+		}
+
+		std::ofstream file;
+		std::string buffer;
+		size_t lineCount = 0;
+	};
+
+	static constexpr const char* s_Registers8[] = { "a", "b", "c", "d", "e", "h", "l" };
+	static constexpr const char* s_Registers16[] = { "bc", "de", "hl" };
+	static constexpr const char* s_Conditions[] = { "z", "nz", "c", "nc" };
+	static constexpr const char* s_OSRoutines[] = { "_ClrLCDFull", "_HomeUp", "_PutS", "_GetCSC", "_DrawStatusBar", "_RunIndicOff" };
+	static constexpr const char* s_Words[] = { "score", "level", "press", "enter", "to", "start", "game", "over", "high", "lives", "paused", "menu" };
+
+	static std::string Hex(uint32_t value)
+	{
+		static constexpr char digits[] = "0123456789ABCDEF";
+		std::string hex = "$";
+		int shift = value > 0xFFFF ? 20 : value > 0xFF ? 12 : 4;
+		for (; shift >= 0; shift -= 4)
+			hex += digits[(value >> shift) & 0xF];
+		return hex;
+	}
+
+	// Equates and further includes, so that the tree is followed the same way a real one would be.
+	static bool GenerateInclude(const std::filesystem::path& directory, const std::string& name, uint32_t depth, size_t equateCount, const CorpusInfo& info, std::mt19937& rng)
+	{
+		CorpusFile file(directory / (name + ".inc"));
+		if (!file.IsOpen())
+			return false;
+
+		file.Line("; Generated, ", name, ".inc");
+		if (depth < info.includeDepth)
+		{
+			for (uint32_t i = 0; i < info.includeFanOut; i++)
+			{
+				std::string child = name + '_' + std::to_string(i);
+				file.Line("#include \"", child, ".inc\"");
+				if (!GenerateInclude(directory, child, depth + 1, equateCount, info, rng))
+					return false;
+			}
+		}
+		file.Line();
+
+		for (size_t i = 0; i < equateCount; i++)
+		{
+			std::string equate = name + "_Const" + std::to_string(i);
+			if (i && rng() % 3 == 0)
+			{
+				size_t other = rng() % i;
+				uint32_t factor = rng() % 8 + 1;
+				file.Line(".equ ", equate, ' ', name, "_Const", other, " * ", factor);
+			}
+			else
+				file.Line(".equ ", equate, ' ', Hex(rng() % 0x10000));
+		}
+		return file.Good();
+	}
+
+	std::filesystem::path GenerateCorpus(const std::filesystem::path& directory, const CorpusInfo& info)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error)
+			return {};
+
+		std::mt19937 rng(info.seed);
+
+		// A twentieth of the lines are equates in the include tree, spread evenly over its files.
+		size_t includeFileCount = 0;
+		for (uint32_t depth = 1, width = info.includeFanOut; depth <= info.includeDepth; depth++, width *= info.includeFanOut)
+			includeFileCount += width;
+		size_t equatesPerInclude = includeFileCount ? std::max<size_t>(info.lineCount / 20 / includeFileCount, 2) : 0;
+
+		std::filesystem::path mainFilepath = directory / "main.asm";
+		CorpusFile file(mainFilepath);
+		if (!file.IsOpen())
+			return {};
+
+		file.Line("#include \"ti84pce.inc\"");
+		for (uint32_t i = 0; info.includeDepth && i < info.includeFanOut; i++)
+		{
+			std::string include = "include_" + std::to_string(i);
+			file.Line("#include \"", include, ".inc\"");
+			if (!GenerateInclude(directory, include, 1, equatesPerInclude, info, rng))
+				return {};
+		}
+		file.Line();
+
+		constexpr uint32_t featureCount = 8;
+		for (uint32_t i = 0; i < featureCount; i++)
+			file.Line("#define FEATURE_", i, ' ', static_cast<uint32_t>(rng() % 2));
+		for (uint32_t i = 0; i < 32; i++)
+			file.Line(".equ Screen_Const", i, "        ", Hex(rng() % 320), "                ;; generated");
+		file.Line();
+
+		file.Line("#if FEATURE_0");
+		file.Line("\t#macro add_de_hl $count");
+		file.Line("\t\tex de, hl");
+		file.Line("\t\tadd hl, de");
+		file.Line("\t\tex de, hl");
+		file.Line("\t#endmacro");
+		file.Line("#else");
+		file.Line("\t#macro add_de_hl $count");
+		file.Line("\t\tpush hl");
+		file.Line("\t\tadd hl, de");
+		file.Line("\t\tex de, hl");
+		file.Line("\t\tpop hl");
+		file.Line("\t#endmacro");
+		file.Line("#endif");
+		file.Line();
+
+		file.Line(".org UserMem - 2");
+		file.Line(".db tExtTok, tAsm84CeCmp");
+		file.Line("\tjp Routine0");
+		file.Line();
+
+		// Calls mostly go to a few hot routines near the start, like they do to a program's utility functions:
+		// each routine is picked with a twentieth of the chance of the one before it wasn't.
+		size_t routineCount = std::max<size_t>(info.lineCount / 24, 1);
+		auto Routine = [&]()
+		{
+			size_t routine = 0;
+			while (routine + 1 < routineCount && rng() % 20 != 0)
+				routine++;
+			return routine;
+		};
+		auto Register8 = [&]() { return std::string_view(s_Registers8[rng() % std::size(s_Registers8)]); };
+		auto Register16 = [&]() { return std::string_view(s_Registers16[rng() % std::size(s_Registers16)]); };
+		auto Condition = [&]() { return std::string_view(s_Conditions[rng() % std::size(s_Conditions)]); };
+		auto Offset = [&]() { return static_cast<uint32_t>(rng() % 32); };
+
+		size_t mainLineCount = info.lineCount - std::min(info.lineCount, equatesPerInclude * includeFileCount);
+		for (size_t routine = 0; file.LineCount() < mainLineCount; routine++)
+		{
+			std::string name = "Routine" + std::to_string(routine);
+
+			// Strings, tables and sprites, a tenth or so of all lines, in a namespace per module like libraries have them.
+			std::string module = "module" + std::to_string(routine / 64);
+			if (routine % 64 == 0)
+			{
+				file.Line("#namespace ", module);
+				for (uint32_t item = 0; item < 16; item++)
+				{
+					file.Line("\tItem", item, ':');
+					for (uint32_t i = rng() % 4 + 1; i; i--)
+					{
+						switch (rng() % 4)
+						{
+							case 0:
+							{
+								std::string text;
+								for (uint32_t word = rng() % 4 + 1; word; word--)
+									text += std::string(s_Words[rng() % std::size(s_Words)]) + (word > 1 ? " " : "");
+								file.Line("\t\t.db \"", text, "\", 0");
+								break;
+							}
+							case 1:
+							{
+								std::string bytes;
+								for (uint32_t byte = 0; byte < 16; byte++)
+									bytes += (byte ? ", " : "") + Hex(rng() % 4 ? 0 : rng() % 0x100);
+								file.Line("\t\t.db ", bytes);
+								break;
+							}
+							case 2:
+							{
+								uint32_t x = rng() % 320;
+								uint32_t y = rng() % 240;
+								file.Line("\t\t.dw ", x, ", ", y);
+								break;
+							}
+							case 3:
+							{
+								size_t first = Routine();
+								size_t second = Routine();
+								file.Line("\t\t.dl Routine", first, ", Routine", second);
+								break;
+							}
+						}
+					}
+				}
+				file.Line("#endnamespace");
+				file.Line();
+			}
+
+			if (rng() % 4 == 0)
+				file.Line("; ", name, " does things with ", s_Words[rng() % std::size(s_Words)]);
+
+			file.Line(name, ':');
+			uint32_t instructionCount = rng() % 24 + 4;
+			bool hasLoop = rng() % 3 == 0;
+			if (hasLoop)
+			{
+				file.Line("\tld b, ", static_cast<uint32_t>(rng() % 64 + 1));
+				file.Line(name, "_Loop:");
+			}
+
+			for (uint32_t i = 0; i < instructionCount; i++)
+			{
+				switch (rng() % 24)
+				{
+					case 0: case 1: file.Line("\tcall Routine", Routine()); break;
+					case 2: file.Line("\tcall ", s_OSRoutines[rng() % std::size(s_OSRoutines)]); break;
+					case 3: file.Line("\tld a, ", static_cast<uint32_t>(rng() % 4 ? rng() % 16 : rng() % 256)); break;
+					case 4: file.Line("\tld hl, ", rng() % 2 ? "gfx_pBuffer1" : "Screen_Const" + std::to_string(rng() % 32)); break;
+					case 5: file.Line("\tld a, (ix + ", Offset(), ')'); break;
+					case 6: file.Line("\tld (iy + ", Offset(), "), a"); break;
+					case 7:
+					{
+						std::string_view destination = Register8();
+						std::string_view source = Register8();
+						file.Line("\tld ", destination, ", ", source);
+						break;
+					}
+					case 8: file.Line("\tpush ", Register16()); break;
+					case 9: file.Line("\tpop ", Register16()); break;
+					case 10: file.Line("\tcp a, ", static_cast<uint32_t>(rng() % 32)); break;
+					case 11: file.Line("\tadd a, ", Register8()); break;
+					case 12: file.Line("\tor a, a"); break;
+					case 13: file.Line("\tsbc hl, de"); break;
+					case 14: file.Line("\tadd hl, ", Register16()); break;
+					case 15: file.Line("\tinc ", Register16()); break;
+					case 16: file.Line("\tld bc, ", static_cast<uint32_t>(rng() % 320)); break;
+					case 17: file.Line("\tldir"); break;
+					case 18: file.Line("\tret ", Condition()); break;
+					case 19:
+					{
+						uint32_t offset = Offset();
+						std::string_view word = s_Words[rng() % std::size(s_Words)];
+						file.Line("\tld de, (ix + ", offset, ")   ; ", word);
+						break;
+					}
+					case 20: file.Line("\tadd_de_hl 1"); break;
+					case 21:
+					{
+						std::string_view condition = Condition();
+						size_t target = Routine();
+						file.Line("\tjp ", condition, ", Routine", target);
+						break;
+					}
+					case 22:
+					{
+						uint32_t feature = rng() % featureCount;
+						file.Line("#if FEATURE_", feature);
+						file.Line("\tld a, ", static_cast<uint32_t>(rng() % 8));
+						file.Line("\tcall Routine", Routine());
+						file.Line("#else");
+						file.Line("\txor a, a");
+						file.Line("#endif");
+						break;
+					}
+					case 23: file.Line("\tld hl, ", module, ".Item", static_cast<uint32_t>(rng() % 16)); break;
+				}
+			}
+
+			if (hasLoop)
+				file.Line("\tdjnz ", name, "_Loop");
+			if (rng() % 8 == 0)
+				file.Line("\tjp Routine", Routine());
+			else
+				file.Line("\tret");
+			file.Line();
+		}
+
+		if (!file.Good())
+			return {};
+		return mainFilepath;
+	}
+}
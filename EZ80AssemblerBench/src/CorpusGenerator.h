@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+namespace ez80::bench
+{
+	struct CorpusInfo
+	{
+		size_t lineCount = 10'000; // Roughly, main.asm and its includes together.
+		uint32_t seed = 0xE780;
+
+		// The includes form a tree below main.asm, with every file including fanOut more until depth is reached.
+		uint32_t includeDepth = 3;
+		uint32_t includeFanOut = 3;
+	};
+
+	// Writes main.asm and its include tree into directory, a mix of equates, macros, conditionals, namespaces,
+	// routines and .db data in roughly the proportions CE programs have them.
+	// The same info always generates the same files, with any compiler and standard library.
+	// Returns the path of main.asm, or an empty path if writing failed.
+	std::filesystem::path GenerateCorpus(const std::filesystem::path& directory, const CorpusInfo& info);
+}
@@ -0,0 +1,105 @@
+#include "DocumentBenchmark.h"
+#include "CorpusGenerator.h"
+#include "Document.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace ez80::bench
+{
+	// Edits per kind of edit.
+	static constexpr size_t s_EditCount = 2'000;
+
+	// Each edit is timed along with the GetDiagnostics after it, since that's what an editor waits on.
+	static void TimeEdits(Document& document, std::string_view name, std::mt19937& rng, const std::function<void(size_t lineIndex)>& edit)
+	{
+		std::vector<double> milliseconds;
+		std::vector<AssemblerError> errors;
+		std::vector<AssemblerWarning> warnings;
+		for (size_t i = 0; i < s_EditCount; i++)
+		{
+			size_t lineIndex = rng() % document.LineCount();
+			auto start = std::chrono::steady_clock::now();
+			edit(lineIndex);
+			errors.clear();
+			warnings.clear();
+			document.GetDiagnostics(errors, warnings);
+			milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		std::sort(milliseconds.begin(), milliseconds.end());
+		std::cout << std::left << std::setw(22) << name << std::right << std::setprecision(3)
+			<< std::setw(10) << milliseconds[milliseconds.size() / 2]
+			<< std::setw(10) << milliseconds[milliseconds.size() * 99 / 100]
+			<< std::setw(10) << milliseconds.back() << '\n';
+	}
+
+	void RunDocumentBenchmark(size_t lineCount, const std::filesystem::path& corpusDirectory)
+	{
+		CorpusInfo corpusInfo;
+		corpusInfo.lineCount = lineCount;
+		std::filesystem::path filepath = GenerateCorpus(corpusDirectory / std::to_string(lineCount), corpusInfo);
+		std::ifstream file(filepath);
+		if (!file.is_open())
+		{
+			std::cerr << "Couldn't generate a corpus in " << corpusDirectory << '\n';
+			return;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+
+		Document document;
+		auto start = std::chrono::steady_clock::now();
+		document.SetText(stream.str());
+		double openMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << std::fixed << filepath.filename().string() << ", " << document.LineCount() << " lines, opened in "
+			<< std::setprecision(1) << openMilliseconds << " ms\n";
+		std::cout << std::left << std::setw(22) << "edit" << std::right << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << '\n';
+
+		std::mt19937 rng(corpusInfo.seed);
+
+		// Typing an instruction into a new line, one keystroke at a time.
+		static constexpr std::string_view instruction = "\tld hl, Screen_Const1 + 1";
+		size_t typed = 0;
+		size_t typingLineIndex = 0;
+		TimeEdits(document, "type instruction", rng, [&](size_t lineIndex)
+		{
+			typed = typed % instruction.size() + 1;
+			if (typed == 1)
+			{
+				typingLineIndex = lineIndex;
+				document.Edit(typingLineIndex, 0, instruction.substr(0, typed));
+			}
+			else
+				document.Edit(typingLineIndex, 1, instruction.substr(0, typed));
+		});
+
+		// Changing an equate that others and #if conditions depend on.
+		DocumentSymbol equate;
+		if (document.FindSymbol("Screen_Const1", 0, equate))
+		{
+			size_t equateLineIndex = equate.lineIndex;
+			TimeEdits(document, "change equate", rng, [&](size_t)
+			{
+				document.Edit(equateLineIndex, 1, ".equ Screen_Const1 " + std::to_string(rng() % 256));
+			});
+		}
+
+		TimeEdits(document, "insert line", rng, [&](size_t lineIndex) { document.Edit(lineIndex, 0, "\tnop"); });
+		TimeEdits(document, "delete line", rng, [&](size_t lineIndex) { document.Edit(lineIndex, 1, ""); });
+
+		// Commenting out a conditional and back, which changes which branches are taken.
+		TimeEdits(document, "toggle #if", rng, [&](size_t lineIndex)
+		{
+			document.Edit(lineIndex, 0, "#if FEATURE_1");
+			document.Edit(lineIndex, 1, "");
+		});
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <filesystem>
+
+namespace ez80::bench
+{
+	// Opens the main.asm of a generated corpus as a Document, types into it a keystroke at a time, and prints
+	// how long each kind of edit takes, including getting the diagnostics after it, the way an editor would.
+	void RunDocumentBenchmark(size_t lineCount, const std::filesystem::path& corpusDirectory);
+}
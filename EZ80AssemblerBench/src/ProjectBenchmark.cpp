@@ -0,0 +1,103 @@
+#include "ProjectBenchmark.h"
+#include "CorpusGenerator.h"
+#include "Project.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace ez80::bench
+{
+	static double MillisecondsSince(std::chrono::steady_clock::time_point start) noexcept
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	int RunProjectBenchmark(size_t programCount, size_t lineCount, const std::filesystem::path& corpusDirectory)
+	{
+		CorpusInfo corpusInfo;
+		corpusInfo.lineCount = lineCount;
+		std::filesystem::path directory = corpusDirectory / ("project_" + std::to_string(lineCount));
+		std::filesystem::path mainFilepath = GenerateCorpus(directory, corpusInfo);
+		std::filesystem::path manifestFilepath = directory / "project.txt";
+		{
+			std::ofstream manifest(manifestFilepath);
+			manifest << "; Every program is main.asm, built with different features.\ninclude .\n";
+			for (size_t i = 0; i < programCount; i++)
+			{
+				manifest << "\nprogram PROG" << i << '\n'
+					<< "\tinput " << mainFilepath.filename().string() << '\n'
+					<< "\toutput out/PROG" << i << ".8xp\n"
+					<< "\tdefine FEATURE_" << i % 4 << " 1\n";
+			}
+			if (mainFilepath.empty() || !manifest)
+			{
+				std::cerr << "Couldn't generate a project in " << directory << '\n';
+				return 1;
+			}
+		}
+
+		ProjectInfo info;
+		if (ProjectError error = ReadProjectManifest(manifestFilepath, info.programs))
+		{
+			std::cerr << "Couldn't read " << manifestFilepath << ", error " << error.id << " on line " << error.lineNumber << '\n';
+			return 1;
+		}
+
+		// Every program parsed and assembled on its own, the way a build script calling the assembler would.
+		auto start = std::chrono::steady_clock::now();
+		std::vector<AssemblerResult> sequentialResults;
+		for (const ProjectProgram& program : info.programs)
+		{
+			AssemblerInfo assemblerInfo = info.settings;
+			assemblerInfo.inputFilepath = program.inputFilepath;
+			assemblerInfo.outputFilepath = program.outputFilepath;
+			assemblerInfo.includeDirectories = program.includeDirectories;
+			assemblerInfo.defines = program.defines;
+			sequentialResults.push_back(Assemble(assemblerInfo));
+		}
+		double sequentialMilliseconds = MillisecondsSince(start);
+
+		ProjectResult result = BuildProject(info);
+
+		// The programs only differ by their defines, so they're also variants of one program.
+		std::vector<AssemblerVariant> variants;
+		for (const ProjectProgram& program : info.programs)
+			variants.push_back({ program.name, program.outputFilepath, program.defines });
+		AssemblerInfo variantInfo = info.settings;
+		variantInfo.inputFilepath = info.programs.front().inputFilepath;
+		variantInfo.includeDirectories = info.programs.front().includeDirectories;
+		AssemblerVariantsResult variantsResult = AssembleVariants(variantInfo, variants);
+
+		int mismatchCount = 0;
+		uint64_t longestProgramNanoseconds = 0;
+		for (size_t i = 0; i < info.programs.size(); i++)
+		{
+			const AssemblerResult& programResult = result.programs[i].result;
+			if (programResult.error.id != sequentialResults[i].error.id || programResult.error.lineNumber != sequentialResults[i].error.lineNumber)
+			{
+				std::cerr << info.programs[i].name << " failed with error " << programResult.error.id << " instead of " << sequentialResults[i].error.id << '\n';
+				mismatchCount++;
+			}
+			const AssemblerResult& variantResult = variantsResult.variants[i];
+			if (variantResult.error.id != sequentialResults[i].error.id || variantResult.error.lineNumber != sequentialResults[i].error.lineNumber)
+			{
+				std::cerr << info.programs[i].name << " as a variant failed with error " << variantResult.error.id << " instead of " << sequentialResults[i].error.id << '\n';
+				mismatchCount++;
+			}
+			longestProgramNanoseconds = std::max(longestProgramNanoseconds, result.programs[i].nanoseconds);
+		}
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< programCount << " programs of " << lineCount << " lines, " << result.parsedFileCount << " files, "
+			<< std::max(std::thread::hardware_concurrency(), 1u) << " threads\n"
+			<< "  one at a time     " << std::setw(10) << sequentialMilliseconds << " ms\n"
+			<< "  BuildProject      " << std::setw(10) << result.nanoseconds / 1e6 << " ms\n"
+			<< "  critical path     " << std::setw(10) << result.criticalPathNanoseconds / 1e6 << " ms\n"
+			<< "  longest program   " << std::setw(10) << longestProgramNanoseconds / 1e6 << " ms\n"
+			<< "  AssembleVariants  " << std::setw(10) << variantsResult.nanoseconds / 1e6 << " ms\n"
+			<< "  shared parse      " << std::setw(10) << variantsResult.parseNanoseconds / 1e6 << " ms\n";
+		return mismatchCount;
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <filesystem>
+
+namespace ez80::bench
+{
+	// Writes a manifest of programCount programs sharing one generated corpus, each with its own defines,
+	// and prints how long building them takes one Assemble at a time against BuildProject and AssembleVariants.
+	// Returns how many programs either assembled differently from Assemble.
+	int RunProjectBenchmark(size_t programCount, size_t lineCount, const std::filesystem::path& corpusDirectory);
+}
@@ -0,0 +1,229 @@
+#include "ScalingBenchmark.h"
+#include "EZ80Assembler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace ez80::bench
+{
+	// Each case is assembled at its base size and then doubled this many times.
+	static constexpr uint32_t s_Doublings = 3;
+
+	// Of the fastest run, so that one slow run doesn't fail a case.
+	static constexpr uint32_t s_Repetitions = 5;
+
+	// How fast the time taken may grow with the size, as the exponent k of size^k. Quadratic growth comes out near 2.
+	// Sizes are kept small enough to stay in cache, since falling out of it looks superlinear too.
+	static constexpr double s_MaxExponent = 1.5;
+
+	struct ScalingCase
+	{
+		std::string_view name;
+		size_t baseSize = 0;
+		AssemblerError::ID expectedError = AssemblerError_AssemblyEmpty; // Until encoding is implemented, assembling succeeds with this.
+		AssemblerLimits limits;
+		bool listing = false; // Also writes the listing and symbol map, which evaluate every equate.
+		std::function<void(std::string& source, size_t size)> generate;
+		bool mergeConstantData = false;
+	};
+
+	static void AppendOperands(std::string& source, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			source += i ? ", " : "";
+			source += std::to_string(i & 0xFF);
+		}
+	}
+
+	static std::vector<ScalingCase> MakeCases()
+	{
+		AssemblerLimits unlimitedLines;
+		unlimitedLines.maxLineLength = static_cast<size_t>(-1);
+
+		std::vector<ScalingCase> cases;
+		cases.push_back({ "db operands", 5'000, AssemblerError_AssemblyEmpty, unlimitedLines, false, [](std::string& source, size_t size)
+		{
+			source += "\t.db ";
+			AppendOperands(source, size);
+			source += '\n';
+		} });
+		cases.push_back({ "db operands, string", 5'000, AssemblerError_AssemblyEmpty, unlimitedLines, false, [](std::string& source, size_t size)
+		{
+			source += "\t.db ";
+			AppendOperands(source, size);
+			source += ", \"end\"\n";
+		} });
+		cases.push_back({ "unterminated string", 5'000, AssemblerError_InvalidStringLiteral, unlimitedLines, false, [](std::string& source, size_t size)
+		{
+			source += "\t.db ";
+			AppendOperands(source, size);
+			source += ", \"end\n";
+		} });
+		cases.push_back({ "labels on one line", 2'500, AssemblerError_AssemblyEmpty, unlimitedLines, true, [](std::string& source, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+				source += "L" + std::to_string(i) + ": ";
+			source += "ret\n";
+		} });
+		cases.push_back({ "line too long", 1'000'000, AssemblerError_LineTooLong, {}, false, [](std::string& source, size_t size)
+		{
+			source += "\t.db ";
+			source.append(size, '1');
+			source += '\n';
+		} });
+		cases.push_back({ "equate chains", 2'500, AssemblerError_AssemblyEmpty, {}, true, [](std::string& source, size_t size)
+		{
+			// As deep as the limit allows, with every equate in a chain looked up from the symbol map.
+			for (size_t i = 0; i < size; i++)
+			{
+				source += ".equ E" + std::to_string(i) + ' ';
+				source += i % 1000 ? "E" + std::to_string(i - 1) + " + 1\n" : "1\n";
+			}
+		} });
+		cases.push_back({ "equate chain too deep", 2'500, AssemblerError_EquateTooDeep, {}, false, [](std::string& source, size_t size)
+		{
+			// Defined last first, so the chain is only found to be too deep at the very end.
+			for (size_t i = size; i-- > 0;)
+				source += ".equ E" + std::to_string(i) + (i ? " E" + std::to_string(i - 1) + " + 1\n" : " 1\n");
+		} });
+		cases.push_back({ "nested parentheses", 500, AssemblerError_AssemblyEmpty, unlimitedLines, true, [](std::string& source, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+				source += ".equ P" + std::to_string(i) + ' ' + std::string(i % 300, '(') + '1' + std::string(i % 300, ')') + '\n';
+		} });
+		cases.push_back({ "merged data blocks", 2'500, AssemblerError_AssemblyEmpty, {}, false, [](std::string& source, size_t size)
+		{
+			// Duplicates, and strings that are tails of others, with every one of them sharing the same long tail.
+			source += "\tret\n";
+			for (size_t i = 0; i < size; i++)
+				source += "D" + std::to_string(i) + ": .db \"" + std::string(i % 64, 'x') + std::to_string(i % 500) + " and the rest of a long shared tail\", 0\n";
+		}, true });
+		return cases;
+	}
+
+	// Returns the fastest time in seconds, or a negative time if assembling didn't fail with the expected error.
+	static double TimeCase(const ScalingCase& scalingCase, const std::filesystem::path& directory, size_t size, AssemblerError& outError)
+	{
+		std::string source;
+		scalingCase.generate(source, size);
+
+		std::string name(scalingCase.name);
+		std::replace(name.begin(), name.end(), ' ', '_');
+		std::erase(name, ',');
+		AssemblerInfo info;
+		info.inputFilepath = directory / (name + ".asm");
+		info.outputFilepath = directory / "SCALING.8xp";
+		info.limits = scalingCase.limits;
+		info.mergeConstantData = scalingCase.mergeConstantData;
+		if (scalingCase.listing)
+			info.listingFilepath = directory / (name + ".lst");
+		{
+			std::ofstream file(info.inputFilepath, std::ios::binary);
+			file << source;
+		}
+
+		double fastest = -1.0;
+		for (uint32_t repetition = 0; repetition < s_Repetitions; repetition++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			AssemblerResult result = Assemble(info);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			outError = result.error;
+			if (result.error != scalingCase.expectedError)
+				return -1.0;
+			fastest = fastest < 0.0 ? seconds : std::min(fastest, seconds);
+		}
+		return fastest;
+	}
+
+	// The repo's own test program, run from the repo's root. jp Main there spans an #include and a .org,
+	// so it can't be known to be in range of jr.
+	static constexpr std::string_view s_TestProgramFilepath = "EZ80Assembler/test/test.asm";
+	static constexpr size_t s_TestProgramFarJumpLine = 16;
+
+	// Returns 1 if the test program was assembled wrong.
+	static int CheckTestProgram(const std::filesystem::path& directory)
+	{
+		std::cout << std::left << std::setw(24) << "test.asm" << std::right;
+		if (std::error_code error; !std::filesystem::exists(s_TestProgramFilepath, error))
+		{
+			std::cout << "  skipped, not run from the repo's root\n";
+			return 0;
+		}
+
+		AssemblerInfo info;
+		info.inputFilepath = s_TestProgramFilepath;
+		info.outputFilepath = directory / "TEST.8xp";
+		AssemblerResult result = Assemble(info);
+		for (const AssemblerRewrite& rewrite : result.rewrites)
+		{
+			if (rewrite == AssemblerRewrite_ShortBranch && rewrite.lineNumber == s_TestProgramFarJumpLine)
+			{
+				std::cout << "  jp on line " << s_TestProgramFarJumpLine << " was shortened across an #include\n";
+				return 1;
+			}
+		}
+		std::cout << "  ok\n";
+		return 0;
+	}
+
+	int RunScalingBenchmark(const std::filesystem::path& directory)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+
+		std::cout << std::left << std::setw(24) << "case" << std::right;
+		for (uint32_t doubling = 0; doubling <= s_Doublings; doubling++)
+			std::cout << std::setw(10) << ("x" + std::to_string(1u << doubling) + " ms");
+		std::cout << std::setw(10) << "exponent" << '\n' << std::fixed;
+
+		int failureCount = 0;
+		for (const ScalingCase& scalingCase : MakeCases())
+		{
+			std::cout << std::left << std::setw(24) << scalingCase.name << std::right << std::flush;
+
+			double firstSeconds = 0.0;
+			double lastSeconds = 0.0;
+			bool failed = false;
+			for (uint32_t doubling = 0; doubling <= s_Doublings && !failed; doubling++)
+			{
+				AssemblerError assemblerError;
+				double seconds = TimeCase(scalingCase, directory, scalingCase.baseSize << doubling, assemblerError);
+				if (seconds < 0.0)
+				{
+					std::cout << "  failed with error " << assemblerError.id << " on line " << assemblerError.lineNumber
+						<< " instead of " << scalingCase.expectedError << '\n';
+					failed = true;
+					break;
+				}
+
+				std::cout << std::setw(10) << std::setprecision(2) << seconds * 1000.0 << std::flush;
+				(doubling == 0 ? firstSeconds : lastSeconds) = seconds;
+			}
+			if (failed)
+			{
+				failureCount++;
+				continue;
+			}
+
+			double exponent = std::log2(lastSeconds / firstSeconds) / s_Doublings;
+			std::cout << std::setw(10) << std::setprecision(2) << exponent;
+			if (exponent > s_MaxExponent)
+			{
+				std::cout << "  superlinear";
+				failureCount++;
+			}
+			std::cout << '\n';
+		}
+
+		failureCount += CheckTestProgram(directory);
+		return failureCount;
+	}
+}
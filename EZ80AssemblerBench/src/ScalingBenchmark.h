@@ -0,0 +1,12 @@
+#pragma once
+
+#include <filesystem>
+
+namespace ez80::bench
+{
+	// Assembles hostile inputs, like .db lines with tens of thousands of operands or equate chains, at doubling sizes,
+	// and checks that the time taken grows close to linearly and that each fails with the error it should.
+	// Also checks that the repo's test program assembles the way it should. The inputs are written into directory.
+	// Returns how many cases failed.
+	int RunScalingBenchmark(const std::filesystem::path& directory);
+}
@@ -0,0 +1,89 @@
+#include "AssemblerBenchmark.h"
+#include "CompressionBenchmark.h"
+#include "DocumentBenchmark.h"
+#include "ProjectBenchmark.h"
+#include "ScalingBenchmark.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+static constexpr const char* s_Usage =
+	"EZ80AssemblerBench [options]\n"
+	"  --lines 1000,10000   Line counts of the generated corpora to assemble.\n"
+	"  --repetitions 5      Timed runs per corpus.\n"
+	"  --corpus dir         Where the corpora are generated.\n"
+	"  --output file.json   Writes the results, to use as a baseline later.\n"
+	"  --baseline file.json Compares with earlier results, exiting with 1 if any phase regressed.\n"
+	"  --threshold 0.1      How much slower than the baseline a phase may get, as a fraction.\n"
+	"EZ80AssemblerBench compression [programs.8xp...]\n"
+	"EZ80AssemblerBench document [lines]\n"
+	"EZ80AssemblerBench scaling [dir]\n"
+	"EZ80AssemblerBench project [programs] [lines]\n";
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::string_view(argv[1]) == "compression")
+	{
+		// Any further arguments are .8xp files to benchmark along with the generated data.
+		std::vector<std::filesystem::path> programFilepaths(argv + 2, argv + argc);
+		ez80::bench::RunCompressionBenchmark(programFilepaths);
+		return 0;
+	}
+
+	if (argc > 1 && std::string_view(argv[1]) == "document")
+	{
+		size_t lineCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 50'000;
+		ez80::bench::RunDocumentBenchmark(std::max<size_t>(lineCount, 1), "BenchmarkCorpus");
+		return 0;
+	}
+
+	if (argc > 1 && std::string_view(argv[1]) == "scaling")
+		return ez80::bench::RunScalingBenchmark(argc > 2 ? argv[2] : "BenchmarkScaling") > 0 ? 1 : 0;
+
+	if (argc > 1 && std::string_view(argv[1]) == "project")
+	{
+		size_t programCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+		size_t lineCount = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20'000;
+		return ez80::bench::RunProjectBenchmark(std::max<size_t>(programCount, 1), std::max<size_t>(lineCount, 1), "BenchmarkCorpus") > 0 ? 1 : 0;
+	}
+
+	ez80::bench::AssemblerBenchmarkInfo info;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view option = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value || option == "--help")
+		{
+			std::cout << s_Usage;
+			return 2;
+		}
+		i++;
+
+		if (option == "--lines")
+		{
+			info.lineCounts.clear();
+			for (char* end = nullptr; *value; value = *end ? end + 1 : end)
+				if (size_t lineCount = std::strtoull(value, &end, 10))
+					info.lineCounts.push_back(lineCount);
+		}
+		else if (option == "--repetitions")
+			info.repetitions = static_cast<uint32_t>(std::max(std::strtoul(value, nullptr, 10), 1ul));
+		else if (option == "--corpus")
+			info.corpusDirectory = value;
+		else if (option == "--output")
+			info.resultsFilepath = value;
+		else if (option == "--baseline")
+			info.baselineFilepath = value;
+		else if (option == "--threshold")
+			info.regressionThreshold = std::strtod(value, nullptr);
+		else
+		{
+			std::cout << s_Usage;
+			return 2;
+		}
+	}
+
+	int regressionCount = ez80::bench::RunAssemblerBenchmark(info);
+	return regressionCount < 0 ? 2 : regressionCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Regenerates the assembler's built-in copy of ti84pce.inc's equates from the file itself.
+# Every equate whose value is a single numeric literal is kept, in any of the forms the usual copies use:
+#	.equ name value, name .equ value, name equ value, name = value and ?name := value.
+# Equates defined in terms of others are skipped, the first definition of a name wins.
+# Usage: Scripts/GeneratePlatformSymbols.sh path/to/ti84pce.inc
+set -e
+cd "$(dirname "$0")/.."
+if [ ! -f "$1" ]; then
+	echo "Usage: $0 path/to/ti84pce.inc" >&2
+	exit 1
+fi
+
+OUTPUT=EZ80Assembler/src/PlatformSymbols.inl
+{
+	echo "// Equates from ti84pce.inc, written by Scripts/GeneratePlatformSymbols.sh. Running it on a full copy of the file"
+	echo "// replaces these with every equate the file defines as a literal."
+	tr -d '\r' < "$1" | awk '
+		function literal(value)
+		{
+			if (value ~ /^\$[0-9A-Fa-f]+$/) return "0x" substr(value, 2)
+			if (value ~ /^0[xX][0-9A-Fa-f]+$/) return "0x" substr(value, 3)
+			if (value ~ /^[0-9][0-9A-Fa-f]*[hH]$/) return "0x" substr(value, 1, length(value) - 1)
+			if (value ~ /^[0-9]+$/) { sub(/^0+/, "", value); return value == "" ? "0" : value }
+			return ""
+		}
+		{
+			sub(/;.*/, "")
+			if ($1 == ".equ" || $1 == "#define") { name = $2; value = $3; extra = $4 }
+			else if ($2 == ".equ" || $2 == "equ" || $2 == "EQU" || $2 == "=" || $2 == ":=") { name = $1; value = $3; extra = $4 }
+			else next
+			sub(/^\?/, "", name)
+			sub(/,$/, "", name)
+			if (extra != "" || name !~ /^[A-Za-z_.][A-Za-z0-9_.]*$/ || seen[name]++) next
+			value = literal(value)
+			if (value != "") printf "{ \"%s\", %s },\n", name, value
+		}'
+} > "$OUTPUT"
+echo "Wrote $(($(wc -l < "$OUTPUT") - 2)) symbols to $OUTPUT"
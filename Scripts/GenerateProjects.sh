@@ -0,0 +1,4 @@
+#!/bin/sh
+# premake5 isn't bundled for Linux, so it has to be on the PATH.
+cd "$(dirname "$0")/.."
+premake5 gmake2
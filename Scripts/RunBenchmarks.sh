@@ -0,0 +1,18 @@
+#!/bin/sh
+# Builds and runs the benchmark, failing if any hostile input scales superlinearly
+# or if any phase got slower than the baseline by more than the threshold.
+# Without a baseline the results become it, so run this once on the machine that compares before anything else.
+# Usage: Scripts/RunBenchmarks.sh [threshold, 0.1 by default]
+set -e
+cd "$(dirname "$0")/.."
+premake5 gmake2
+make -j"$(nproc)" config=release EZ80AssemblerBench
+
+BENCH=bin/Release-linux-x86_64/EZ80AssemblerBench/EZ80AssemblerBench
+BASELINE=EZ80AssemblerBench/baseline.json
+"$BENCH" scaling bin-int/BenchmarkScaling
+if [ -f "$BASELINE" ]; then
+	"$BENCH" --corpus bin-int/BenchmarkCorpus --baseline "$BASELINE" --threshold "${1:-0.1}" --output bin/BenchmarkResults.json
+else
+	"$BENCH" --corpus bin-int/BenchmarkCorpus --output "$BASELINE"
+fi
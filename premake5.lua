@@ -16,6 +16,8 @@ workspace "EZ80Assembler"
 
 		-- Scripts
 		"Scripts/GenerateProjects.bat",
+		"Scripts/GenerateProjects.sh",
+		"Scripts/RunBenchmarks.sh",
 
 		-- Lua Scripts
 		"premake5.lua",
@@ -38,3 +40,4 @@ include "Dependencies/Dependencies.lua"
 
 -- Add any projects here with 'include "__PROJECT_NAME__"'
 include "EZ80Assembler"
+include "EZ80AssemblerBench"